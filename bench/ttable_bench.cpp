@@ -0,0 +1,124 @@
+// Transposition table microbenchmark.
+//
+// For several table sizes it measures:
+//  - a probe-shaped bucket read indexed with `key % buckets` (the previous
+//    TT index) and with a multiply-high (the current one), over the same
+//    32-byte buckets, so only the index computation differs
+//  - TT::store and TT::probe throughput on the real table
+//
+// Usage: Akerbeltz-<version>-bench [sizeMB ...]
+
+#include "memory.h"
+#include "ttable.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Akerbeltz;
+
+namespace {
+
+constexpr std::size_t KEY_COUNT = 1 << 22;
+constexpr int         ROUNDS    = 4;
+
+struct alignas(32) RawBucket {
+    uint16_t checks[16];
+};
+
+// Keeps the compiler from dropping the measured loops
+volatile uint64_t sink;
+
+std::vector<Key> make_keys(std::size_t count) {
+    std::vector<Key> keys(count);
+    Key key = 0x9E3779B97F4A7C15ULL;
+    for (Key &k : keys) {
+        key = key * 6364136223846793005ULL + 1442695040888963407ULL;
+        k = key ^ (key >> 29);
+    }
+    return keys;
+}
+
+template<typename Fn>
+double ns_per_op(std::size_t ops, Fn fn) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / double(ops);
+}
+
+uint64_t mul_hi(uint64_t a, uint64_t b) {
+    __extension__ typedef unsigned __int128 uint128;
+    return uint64_t((uint128(a) * b) >> 64);
+}
+
+template<typename IndexFn>
+double bucket_reads(const RawBucket* buckets, const std::vector<Key> &keys, IndexFn index) {
+    return ns_per_op(keys.size() * ROUNDS, [&] {
+        uint64_t hits = 0;
+        for (int r = 0; r < ROUNDS; ++r)
+            for (Key key : keys) {
+                const RawBucket &b = buckets[index(key)];
+                hits += (b.checks[0] == uint16_t(key)) | (b.checks[5] == uint16_t(key)) | (b.checks[10] == uint16_t(key));
+            }
+        sink = hits;
+    });
+}
+
+void bench_size(std::size_t sizeMB, const std::vector<Key> &keys) {
+
+    TT::resize(sizeMB);
+    const std::size_t buckets = TT::bucket_count();
+
+    Memory::LargeAllocation raw = Memory::alloc_large(buckets * sizeof(RawBucket));
+    if (!raw.ptr) {
+        std::printf("%6zu MB: allocation failed\n", sizeMB);
+        return;
+    }
+    std::memset(raw.ptr, 0, buckets * sizeof(RawBucket));
+    const RawBucket* rawBuckets = static_cast<const RawBucket*>(raw.ptr);
+
+    const double modulo    = bucket_reads(rawBuckets, keys, [buckets](Key k) { return k % buckets; });
+    const double fastrange = bucket_reads(rawBuckets, keys, [buckets](Key k) { return mul_hi(k, buckets); });
+    Memory::free_large(raw);
+
+    const double store = ns_per_op(keys.size(), [&] {
+        for (Key key : keys)
+            TT::store(key, DepthSize(key & 31), Evaluate::Score(key >> 48), TT::FLAG_EXACT, NOMOVE);
+    });
+
+    const double probe = ns_per_op(keys.size() * ROUNDS, [&] {
+        uint64_t hits = 0;
+        TT::Entry entry;
+        for (int r = 0; r < ROUNDS; ++r)
+            for (Key key : keys)
+                hits += TT::probe(key, entry);
+        sink = hits;
+    });
+
+    std::printf("%6zu MB %10zu buckets | read %%: %6.2f ns  read mulhi: %6.2f ns | TT store: %6.2f ns  TT probe: %6.2f ns  (%s)\n",
+                sizeMB, buckets, modulo, fastrange, store, probe,
+                std::string(Memory::page_mode_name(TT::page_mode())).c_str());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+
+    std::vector<std::size_t> sizes;
+    for (int i = 1; i < argc; ++i)
+        sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+    if (sizes.empty())
+        sizes = {4, 16, 64, 100, 256, 1000};
+
+    const std::vector<Key> keys = make_keys(KEY_COUNT);
+
+    for (std::size_t sizeMB : sizes)
+        bench_size(sizeMB, keys);
+
+    return 0;
+}
@@ -8,6 +8,8 @@ namespace Attacks {
 Bitboard pawnAttacks[COLOR_SIZE][SQ64_SIZE];
 Bitboard knightAttacks[SQ64_SIZE];
 Bitboard kingAttacks[SQ64_SIZE];
+Bitboard betweenSquares[SQ64_SIZE][SQ64_SIZE];
+Bitboard lineSquares[SQ64_SIZE][SQ64_SIZE];
 Bitboard rookAttacks[SQ64_SIZE][1 << 12];
 Bitboard bishopAttacks[SQ64_SIZE][1 << 9];
 
@@ -181,6 +183,7 @@ void init_rook_rays();
 void init_bishop_rays();
 void init_rook_attacks();
 void init_bishop_attacks();
+void init_between_lines();
 Bitboard calc_side_attacks(Square64 sq64, Bitboard occupied);
 Bitboard calc_diagonal_attacks(Square64 sq64, Bitboard occupied);
 
@@ -195,6 +198,7 @@ void init(){
     init_bishop_rays();
     init_rook_attacks();
     init_bishop_attacks();
+    init_between_lines();
     
 }
 
@@ -420,6 +424,26 @@ Bitboard calc_diagonal_attacks(Square64 sq64, Bitboard occupied){
 
     return neAttacks | seAttacks | nwAttacks | swAttacks;
 
+}
+// Needs the sliding attacks
+void init_between_lines(){
+
+    for(Square64 from = SQ64_A1; from < SQ64_SIZE; ++from){
+        for(Square64 to = SQ64_A1; to < SQ64_SIZE; ++to){
+            betweenSquares[from][to] = ZERO;
+            lineSquares[from][to] = ZERO;
+            if(from == to) continue;
+
+            const Bitboard ends = set_pieces(from, to);
+            for(auto attacks : {sliding_side_attacks, sliding_diagonal_attacks}){
+                if(attacks(from, ZERO) & set_pieces(to)){
+                    betweenSquares[from][to] = attacks(from, set_pieces(to)) & attacks(to, set_pieces(from));
+                    lineSquares[from][to] = (attacks(from, ZERO) & attacks(to, ZERO)) | ends;
+                }
+            }
+        }
+    }
+}
+
 }
 }
-}
\ No newline at end of file
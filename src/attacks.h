@@ -27,6 +27,10 @@ namespace Attacks {
     extern Bitboard pawnAttacks[COLOR_SIZE][SQ64_SIZE];
     extern Bitboard knightAttacks[SQ64_SIZE];
     extern Bitboard kingAttacks[SQ64_SIZE];
+    // Squares strictly between two aligned squares, and the whole line
+    // through them; empty when not on a rank, file or diagonal
+    extern Bitboard betweenSquares[SQ64_SIZE][SQ64_SIZE];
+    extern Bitboard lineSquares[SQ64_SIZE][SQ64_SIZE];
     
     void init();
     Bitboard sliding_side_attacks(Square64 sq64, Bitboard occupied);
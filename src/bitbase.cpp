@@ -0,0 +1,172 @@
+#include "bitbase.h"
+#include "attacks.h"
+#include "parallel.h"
+#include "position.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace Akerbeltz {
+
+namespace Bitbase {
+
+    // Results combine as bits while classifying; INVALID adds nothing
+    enum Result : uint8_t {
+        INVALID = 0,
+        UNKNOWN = 1,
+        DRAW    = 2,
+        WIN     = 4
+    };
+
+    uint64_t kpkBits[KPK_SIZE / 64];
+
+    // stm (1 bit) | black king (6) | white king (6) | pawn a2-d7 (24 values)
+    inline std::size_t index(Color stm, Square64 blackKing, Square64 whiteKing, Square64 pawn) {
+        const std::size_t pawnIndex = (square_rank(pawn) - RANK_2) * 4 + square_file(pawn);
+        return std::size_t(stm) | (std::size_t(blackKing) << 1) | (std::size_t(whiteKing) << 7) | (pawnIndex << 13);
+    }
+
+    struct KPKPosition {
+        Color    stm;
+        Square64 whiteKing;
+        Square64 blackKing;
+        Square64 pawn;
+    };
+
+    inline KPKPosition decode(std::size_t idx) {
+        const int pawnIndex = int(idx >> 13);
+        return {Color(idx & 1), Square64((idx >> 7) & 63), Square64((idx >> 1) & 63),
+                make_square64(Rank(RANK_2 + pawnIndex / 4), File(pawnIndex % 4))};
+    }
+
+    // Results decided by the position alone
+    static Result initial(std::size_t idx) {
+
+        const KPKPosition p = decode(idx);
+        const Square64 promotion = Square64(int(p.pawn) + NORTH);
+
+        if (square_distance(p.whiteKing, p.blackKing) <= 1
+         || p.whiteKing == p.pawn || p.blackKing == p.pawn
+         || (p.stm == WHITE && (Attacks::pawnAttacks[WHITE][p.pawn] & (ONE << p.blackKing))))
+            return INVALID;
+
+        // Safe promotion
+        if (p.stm == WHITE && square_rank(p.pawn) == RANK_7
+         && p.whiteKing != promotion && p.blackKing != promotion
+         && (square_distance(p.blackKing, promotion) > 1 || square_distance(p.whiteKing, promotion) == 1))
+            return WIN;
+
+        if (p.stm == BLACK) {
+            const Bitboard blackMoves = Attacks::kingAttacks[p.blackKing];
+            const Bitboard guarded = Attacks::kingAttacks[p.whiteKing] | Attacks::pawnAttacks[WHITE][p.pawn];
+
+            // Stalemate, or the pawn falls
+            if (!(blackMoves & ~guarded)
+             || (blackMoves & ~Attacks::kingAttacks[p.whiteKing] & (ONE << p.pawn)))
+                return DRAW;
+        }
+
+        return UNKNOWN;
+    }
+
+    // Combines the results of every move; white wants one WIN, black one DRAW
+    static Result classify(std::size_t idx, const std::vector<uint8_t> &db) {
+
+        const KPKPosition p = decode(idx);
+        uint8_t r = INVALID;
+
+        if (p.stm == WHITE) {
+            for (Bitboard b = Attacks::kingAttacks[p.whiteKing]; b; b &= b - 1)
+                r |= db[index(BLACK, p.blackKing, Square64(Bitboards::ctz(b)), p.pawn)];
+
+            if (square_rank(p.pawn) < RANK_7) {
+                const Square64 push = Square64(int(p.pawn) + NORTH);
+                r |= db[index(BLACK, p.blackKing, p.whiteKing, push)];
+
+                if (square_rank(p.pawn) == RANK_2 && push != p.whiteKing && push != p.blackKing)
+                    r |= db[index(BLACK, p.blackKing, p.whiteKing, Square64(int(push) + NORTH))];
+            }
+
+            return (r & WIN) ? WIN : (r & UNKNOWN) ? UNKNOWN : DRAW;
+        }
+
+        for (Bitboard b = Attacks::kingAttacks[p.blackKing]; b; b &= b - 1)
+            r |= db[index(WHITE, Square64(Bitboards::ctz(b)), p.whiteKing, p.pawn)];
+
+        return (r & DRAW) ? DRAW : (r & UNKNOWN) ? UNKNOWN : WIN;
+    }
+
+    void init(std::size_t threads) {
+
+        threads = Parallel::resolve_threads(threads);
+
+        std::vector<uint8_t> current(KPK_SIZE), next(KPK_SIZE);
+
+        Parallel::for_each_slice(KPK_SIZE, threads, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t idx = begin; idx < end; ++idx)
+                current[idx] = initial(idx);
+            return std::size_t(0);
+        });
+
+        // Each pass reads only the previous one, so slices need no locking
+        // and the result does not depend on the thread count
+        std::size_t changed;
+        do {
+            changed = Parallel::for_each_slice(KPK_SIZE, threads, [&](std::size_t begin, std::size_t end) {
+                std::size_t sliceChanged = 0;
+                for (std::size_t idx = begin; idx < end; ++idx) {
+                    next[idx] = current[idx] == UNKNOWN ? uint8_t(classify(idx, current)) : current[idx];
+                    sliceChanged += next[idx] != current[idx];
+                }
+                return sliceChanged;
+            });
+            current.swap(next);
+        } while (changed);
+
+        std::fill(std::begin(kpkBits), std::end(kpkBits), 0);
+        for (std::size_t idx = 0; idx < KPK_SIZE; ++idx)
+            if (current[idx] == WIN)
+                kpkBits[idx / 64] |= ONE << (idx % 64);
+    }
+
+    bool probe_kpk(Square64 whiteKing, Square64 pawn, Square64 blackKing, Color sideToMove) {
+        const std::size_t idx = index(sideToMove, blackKing, whiteKing, pawn);
+        return (kpkBits[idx / 64] >> (idx % 64)) & 1;
+    }
+
+    bool probe_kpk(const Position &position) {
+
+        const Color strongSide = position.get_pieceTypes_bitboard(WHITE, PAWN) ? WHITE : BLACK;
+        Square64 strongKing = Square64(Bitboards::ctz(position.get_pieceTypes_bitboard(strongSide, KING)));
+        Square64 weakKing   = Square64(Bitboards::ctz(position.get_pieceTypes_bitboard(~strongSide, KING)));
+        Square64 pawn       = Square64(Bitboards::ctz(position.get_pieceTypes_bitboard(strongSide, PAWN)));
+        Color stm = position.get_side_to_move();
+
+        // Pawn's side as white
+        if (strongSide == BLACK) {
+            strongKing = Square64(strongKing ^ 56);
+            weakKing   = Square64(weakKing ^ 56);
+            pawn       = Square64(pawn ^ 56);
+            stm        = ~stm;
+        }
+
+        // Pawn on files a-d
+        if (square_file(pawn) > FILE_D) {
+            strongKing = Square64(strongKing ^ 7);
+            weakKing   = Square64(weakKing ^ 7);
+            pawn       = Square64(pawn ^ 7);
+        }
+
+        return probe_kpk(strongKing, pawn, weakKing, stm);
+    }
+
+    std::size_t kpk_wins() {
+        std::size_t wins = 0;
+        for (uint64_t word : kpkBits)
+            wins += Bitboards::cpop(word);
+        return wins;
+    }
+
+} // namespace Bitbase
+
+} // namespace Akerbeltz
@@ -0,0 +1,38 @@
+#ifndef INCLUDE_BITBASE_H
+#define INCLUDE_BITBASE_H
+
+#include "types.h"
+
+#include <cstddef>
+
+namespace Akerbeltz{
+
+class Position;
+
+namespace Bitbase{
+
+    /*KPK bitbase: one bit per position of king + pawn vs king, set when the
+    pawn's side wins. The pawn's side is normalised to white with the pawn
+    on files a-d, which leaves 2 (side to move) x 24 (pawn) x 64 x 64
+    (kings) positions, 24 KB of bits.
+    */
+    constexpr std::size_t KPK_SIZE = 2 * 24 * SQ64_SIZE * SQ64_SIZE;
+
+    // Retrograde analysis over the whole index space, split across threads
+    // (needs Attacks::init)
+    void init(std::size_t threads = 0);
+
+    // Normalised probe: white king, white pawn, black king
+    bool probe_kpk(Square64 whiteKing, Square64 pawn, Square64 blackKing, Color sideToMove);
+
+    // Probe of a KPK position with the pawn on either side
+    bool probe_kpk(const Position &position);
+
+    // Number of winning positions (for tests)
+    std::size_t kpk_wins();
+
+} // namespace Bitbase
+
+} // namespace Akerbeltz
+
+#endif // #ifndef INCLUDE_BITBASE_H
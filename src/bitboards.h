@@ -24,6 +24,7 @@ namespace Bitboards {
     constexpr Bitboard RANK_6_MASK = 0x0000FF0000000000ULL;
     constexpr Bitboard RANK_7_MASK = 0x00FF000000000000ULL;
     constexpr Bitboard RANK_8_MASK = 0xFF00000000000000ULL;
+    constexpr Bitboard DARK_SQUARES = 0xAA55AA55AA55AA55ULL;
 
     //GCC/Clang
     #if defined(__clang__) || defined(__GNUC__)
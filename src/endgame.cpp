@@ -0,0 +1,184 @@
+#include "endgame.h"
+#include "bitbase.h"
+#include "bitboards.h"
+#include "position.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <unordered_map>
+
+namespace Akerbeltz {
+
+namespace Endgame {
+
+    // ---------- Helpers ----------
+    inline int corner_distance(Square64 a, Square64 corner) {
+        return std::abs(square_file(a) - square_file(corner)) + std::abs(square_rank(a) - square_rank(corner));
+    }
+
+    // Larger near the edges and corners
+    inline Score push_to_edge(Square64 square) {
+        const int fileDistance = std::min<int>(square_file(square), FILE_H - square_file(square));
+        const int rankDistance = std::min<int>(square_rank(square), RANK_8 - square_rank(square));
+        return 100 - 15 * (fileDistance + rankDistance);
+    }
+
+    inline Score push_close(Square64 a, Square64 b) { return 140 - 20 * square_distance(a, b); }
+
+    inline Square64 king_square(const Position &position, Color color) {
+        return Square64(Bitboards::ctz(position.get_pieceTypes_bitboard(color, KING)));
+    }
+
+    inline int count(const Position &position, Color color, PieceType pieceType) {
+        return Bitboards::cpop(position.get_pieceTypes_bitboard(color, pieceType));
+    }
+
+    // Endgame material + PST, so scores join up with the normal evaluation
+    inline Score material(const Position &position, Color strongSide) {
+        const Score white = Evaluate::eg_value(position.psqt());
+        return strongSide == WHITE ? white : -white;
+    }
+
+    // ---------- Evaluators ----------
+    // Insufficient material
+    static Score eval_draw(const Position&, Color) { return Evaluate::DRAW_SOCORE; }
+
+    // Mating material against a bare king: drive it to the edge
+    static Score eval_kxk(const Position &position, Color strongSide) {
+        const Square64 strongKing = king_square(position, strongSide);
+        const Square64 weakKing   = king_square(position, ~strongSide);
+        return material(position, strongSide) + push_to_edge(weakKing) + push_close(strongKing, weakKing);
+    }
+
+    // Mate only happens in a corner of the bishop's colour
+    static Score eval_kbnk(const Position &position, Color strongSide) {
+        const Square64 strongKing = king_square(position, strongSide);
+        const Square64 weakKing   = king_square(position, ~strongSide);
+        const bool darkBishop = position.get_pieceTypes_bitboard(strongSide, BISHOP) & Bitboards::DARK_SQUARES;
+
+        const int toCorner = darkBishop
+            ? std::min(corner_distance(weakKing, SQ64_A1), corner_distance(weakKing, SQ64_H8))
+            : std::min(corner_distance(weakKing, SQ64_A8), corner_distance(weakKing, SQ64_H1));
+
+        return material(position, strongSide) + 15 * (14 - toCorner) + push_close(strongKing, weakKing);
+    }
+
+    // Drawish: only a small edge bonus, no material
+    static Score eval_krkb(const Position &position, Color strongSide) {
+        return push_to_edge(king_square(position, ~strongSide));
+    }
+
+    // Drawish, better when the knight is cut off from its king
+    static Score eval_krkn(const Position &position, Color strongSide) {
+        const Square64 weakKing = king_square(position, ~strongSide);
+        const Square64 knight   = Square64(Bitboards::ctz(position.get_pieceTypes_bitboard(~strongSide, KNIGHT)));
+        return push_to_edge(weakKing) + 15 * square_distance(weakKing, knight);
+    }
+
+    // Exact result from the bitbase; a won pawn counts more the further it is
+    static Score eval_kpk(const Position &position, Color strongSide) {
+        if (!Bitbase::probe_kpk(position))
+            return Evaluate::DRAW_SOCORE;
+
+        const Square64 pawn = Square64(Bitboards::ctz(position.get_pieceTypes_bitboard(strongSide, PAWN)));
+        const int relativeRank = strongSide == WHITE ? square_rank(pawn) : RANK_8 - square_rank(pawn);
+        return material(position, strongSide) + 400 + 20 * relativeRank;
+    }
+
+    // Won, but the rook holds out next to its king: a rook cut off from its
+    // king falls to queen forks
+    static Score eval_kqkr(const Position &position, Color strongSide) {
+        const Square64 strongKing = king_square(position, strongSide);
+        const Square64 weakKing   = king_square(position, ~strongSide);
+        const Square64 rook       = Square64(Bitboards::ctz(position.get_pieceTypes_bitboard(~strongSide, ROOK)));
+        return material(position, strongSide) + push_to_edge(weakKing) + push_close(strongKing, weakKing)
+             + 20 * square_distance(weakKing, rook);
+    }
+
+    // ---------- Scalers ----------
+    // One bishop each and pawns: opposite colours are very drawish
+    static int scale_bishops(const Position &position, Color) {
+        const bool whiteDark = position.get_pieceTypes_bitboard(WHITE, BISHOP) & Bitboards::DARK_SQUARES;
+        const bool blackDark = position.get_pieceTypes_bitboard(BLACK, BISHOP) & Bitboards::DARK_SQUARES;
+        if (whiteDark == blackDark)
+            return SCALE_NORMAL;
+
+        const bool pawns = position.get_pieceTypes_bitboard(WHITE, PAWN) | position.get_pieceTypes_bitboard(BLACK, PAWN);
+        return pawns ? SCALE_NORMAL / 4 : SCALE_DRAW;
+    }
+
+    // ---------- Registry ----------
+    std::unordered_map<Key, Entry> registry;
+
+    const Entry KXK[COLOR_SIZE] = {{eval_kxk, nullptr, WHITE}, {eval_kxk, nullptr, BLACK}, {}};
+    const Entry BISHOPS_ONLY    = {nullptr, scale_bishops, WHITE};
+
+    static void add(const std::string &code, EvalFn eval, ScaleFn scale) {
+        for (Color strongSide : {WHITE, BLACK})
+            registry[material_key(code, strongSide)] = Entry{eval, scale, strongSide};
+    }
+
+    void init() {
+        registry.clear();
+
+        add("KK",   eval_draw, nullptr);
+        add("KNK",  eval_draw, nullptr);
+        add("KBK",  eval_draw, nullptr);
+        add("KNNK", eval_draw, nullptr);
+        add("KPK",  eval_kpk,  nullptr);
+        add("KBNK", eval_kbnk, nullptr);
+        add("KRKB", eval_krkb, nullptr);
+        add("KRKN", eval_krkn, nullptr);
+        add("KQKR", eval_kqkr, nullptr);
+    }
+
+    const Entry* find(const Position &position) {
+
+        const auto it = registry.find(position.get_material_key());
+        if (it != registry.end())
+            return &it->second;
+
+        // Signatures too many to register: any mating force against a bare
+        // king, and bishops (one each) with pawns
+        for (Color strongSide : {WHITE, BLACK}) {
+            const Color weakSide = ~strongSide;
+            if (position.get_occupied_bitboard(weakSide) != position.get_pieceTypes_bitboard(weakSide, KING))
+                continue;
+
+            const int minors = count(position, strongSide, KNIGHT) + count(position, strongSide, BISHOP);
+            if (count(position, strongSide, QUEEN) || count(position, strongSide, ROOK)
+             || (count(position, strongSide, BISHOP) && minors >= 2))
+                return &KXK[strongSide];
+        }
+
+        bool bishopsOnly = true;
+        for (Color color : {WHITE, BLACK})
+            bishopsOnly = bishopsOnly && count(position, color, BISHOP) == 1 && !count(position, color, KNIGHT)
+                       && !count(position, color, ROOK) && !count(position, color, QUEEN);
+
+        return bishopsOnly ? &BISHOPS_ONLY : nullptr;
+    }
+
+    Key material_key(const std::string &code, Color strongSide) {
+
+        const std::size_t weakStart = code.find('K', 1);
+        std::string pieces[COLOR_SIZE];
+        pieces[strongSide] = code.substr(0, weakStart);
+        pieces[~strongSide] = code.substr(weakStart);
+
+        // Only the piece counts matter: each side on its back rank
+        auto rank = [](std::string side, bool black) {
+            if (black)
+                std::transform(side.begin(), side.end(), side.begin(), [](char c) { return char(std::tolower(c)); });
+            return side.size() < 8 ? side + char('0' + 8 - side.size()) : side;
+        };
+
+        Position position;
+        position.set_FEN(rank(pieces[BLACK], true) + "/8/8/8/8/8/8/" + rank(pieces[WHITE], false) + " w - - 0 1");
+        return position.get_material_key();
+    }
+
+} // namespace Endgame
+
+} // namespace Akerbeltz
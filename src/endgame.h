@@ -0,0 +1,48 @@
+#ifndef INCLUDE_ENDGAME_H
+#define INCLUDE_ENDGAME_H
+
+#include "types.h"
+#include "evaluate.h"
+
+#include <string>
+
+namespace Akerbeltz{
+
+class Position;
+
+namespace Endgame{
+
+    using Evaluate::Score;
+
+    // Scale factors applied to the normal evaluation, out of SCALE_NORMAL
+    constexpr int SCALE_NORMAL = 64;
+    constexpr int SCALE_DRAW   = 0;
+
+    // Replaces the evaluation; from the strong side's point of view
+    using EvalFn  = Score (*)(const Position &position, Color strongSide);
+    // Scales the normal evaluation
+    using ScaleFn = int (*)(const Position &position, Color strongSide);
+
+    // Knowledge for one material signature: an evaluator or a scaler
+    struct Entry{
+        EvalFn  eval;
+        ScaleFn scale;
+        Color   strongSide;
+    };
+
+    // Registers the evaluators by material key (needs Position::init)
+    void init();
+
+    // Specialised evaluator or scaler for the position's material, nullptr
+    // if there is none. Looked up once per material key by the material hash.
+    const Entry* find(const Position &position);
+
+    // Material key of a signature like "KBNK": the strong side's pieces,
+    // then the weak side's, each starting with its king
+    Key material_key(const std::string &code, Color strongSide);
+
+} // namespace Endgame
+
+} // namespace Akerbeltz
+
+#endif // #ifndef INCLUDE_ENDGAME_H
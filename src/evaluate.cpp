@@ -1,7 +1,10 @@
 //#include "evaluate.h"
+#include "bitbase.h"
+#include "endgame.h"
+#include "nnue.h"
 #include "position.h"
 #include <algorithm>
-#include <cmath>
+#include <cassert>
 
 namespace Akerbeltz {
 
@@ -9,9 +12,7 @@ using namespace Bitboards;
 namespace Evaluate {
 
 // ---------- Declaration----------
-void init();
-static inline int flip(int sq) { return sq ^ 56; }
-static inline Score mg_eg_blend(double mg, double eg, int mgWeight, int egWeight);
+static constexpr int flip(int sq) { return sq ^ 56; }
 
 // ---------- MG/EG Piece Values----------
 constexpr Score MG_PIECE_SCORES[PieceType::PIECETYPE_SIZE] = {0, 82, 337, 365, 477, 1025, 20000};
@@ -151,281 +152,414 @@ static constexpr Score EG_KING_TABLE[SQ64_SIZE] = {
     -74, -35, -18, -18, -11,  15,   4, -17,
 };
 
-constexpr Score MG_TEMPO_BONUS = 8;
-constexpr Score EG_TEMPO_BONUS = 4;
+constexpr PackedScore TEMPO_BONUS = make_score(8, 4);
 
-// ---------- Internal State ----------
-static Score PST_MG[PIECE_SIZE][SQ64_SIZE];
-static Score PST_EG[PIECE_SIZE][SQ64_SIZE];
+// ---------- Pawn Structure ----------
+constexpr PackedScore DOUBLED_PAWN  = make_score(-10, -20);
+constexpr PackedScore ISOLATED_PAWN = make_score(-12, -16);
 
-// ---------- INIT ----------
-void init() {
-    // Clean PST
-    for (int p = 0; p < PIECE_SIZE; ++p) {
-        for (int s = 0; s < SQ64_SIZE; ++s) {
-            PST_MG[p][s] = PST_EG[p][s] = 0;
-        }
-    }
+// By rank, relative to the pawn's side
+constexpr PackedScore PASSED_PAWN[RANK_SIZE] = {
+    make_score( 0,  0), make_score( 2,  8), make_score( 5, 12), make_score(10, 25),
+    make_score(20, 45), make_score(35, 70), make_score(50, 100), make_score( 0,  0)
+};
 
-    // White
-    for (int s = 0; s < SQ64_SIZE; ++s) {
-        PST_MG[Piece::NO_PIECE][s] = 0;
-        PST_EG[Piece::NO_PIECE][s] = 0;
-        PST_MG[Piece::W_PAWN][s]   = MG_PAWN_TABLE[s];
-        PST_EG[Piece::W_PAWN][s]   = EG_PAWN_TABLE[s];
-        PST_MG[Piece::W_KNIGHT][s] = MG_KNIGHT_TABLE[s];
-        PST_EG[Piece::W_KNIGHT][s] = EG_KNIGHT_TABLE[s];
-        PST_MG[Piece::W_BISHOP][s] = MG_BISHOP_TABLE[s];
-        PST_EG[Piece::W_BISHOP][s] = EG_BISHOP_TABLE[s];
-        PST_MG[Piece::W_ROOK][s]   = MG_ROOK_TABLE[s];
-        PST_EG[Piece::W_ROOK][s]   = EG_ROOK_TABLE[s];
-        PST_MG[Piece::W_QUEEN][s]  = MG_QUEEN_TABLE[s];
-        PST_EG[Piece::W_QUEEN][s]  = EG_QUEEN_TABLE[s];
-        PST_MG[Piece::W_KING][s]   = MG_KING_TABLE[s];
-        PST_EG[Piece::W_KING][s]   = EG_KING_TABLE[s];
+static constexpr PackedScore max_passed_pawn() {
+    Score mg = 0, eg = 0;
+    for (const PackedScore bonus : PASSED_PAWN) {
+        mg = std::max(mg, mg_value(bonus));
+        eg = std::max(eg, eg_value(bonus));
     }
+    return make_score(mg, eg);
+}
 
-    // Black
-    for (int s = 0; s < SQ64_SIZE; ++s) {
-        const int fs = flip(s);
-        PST_MG[Piece::B_PAWN][s]   = MG_PAWN_TABLE[fs];
-        PST_EG[Piece::B_PAWN][s]   = EG_PAWN_TABLE[fs];
-        PST_MG[Piece::B_KNIGHT][s] = MG_KNIGHT_TABLE[fs];
-        PST_EG[Piece::B_KNIGHT][s] = EG_KNIGHT_TABLE[fs];
-        PST_MG[Piece::B_BISHOP][s] = MG_BISHOP_TABLE[fs];
-        PST_EG[Piece::B_BISHOP][s] = EG_BISHOP_TABLE[fs];
-        PST_MG[Piece::B_ROOK][s]   = MG_ROOK_TABLE[fs];
-        PST_EG[Piece::B_ROOK][s]   = EG_ROOK_TABLE[fs];
-        PST_MG[Piece::B_QUEEN][s]  = MG_QUEEN_TABLE[fs];
-        PST_EG[Piece::B_QUEEN][s]  = EG_QUEEN_TABLE[fs];
-        PST_MG[Piece::B_KING][s]   = MG_KING_TABLE[fs];
-        PST_EG[Piece::B_KING][s]   = EG_KING_TABLE[fs];
+// What the pawn hash adds per pawn: a passed pawn is never doubled, and the
+// penalties only take away
+constexpr PackedScore PAWN_TERMS_MIN = DOUBLED_PAWN + ISOLATED_PAWN;
+constexpr PackedScore PAWN_TERMS_MAX = max_passed_pawn();
+
+static_assert(mg_value(DOUBLED_PAWN) <= 0 && eg_value(DOUBLED_PAWN) <= 0
+           && mg_value(ISOLATED_PAWN) <= 0 && eg_value(ISOLATED_PAWN) <= 0);
+
+// Pawn hash: per thread, indexed by the low bits of the pawn key
+constexpr std::size_t PAWN_HASH_ENTRIES = 1 << 14;
+
+// Eval cache: per thread, indexed by the low bits of the position key
+constexpr std::size_t EVAL_HASH_ENTRIES = 1 << 15;
+
+// Material hash: per thread, indexed by the low bits of the material key
+constexpr std::size_t MATERIAL_HASH_ENTRIES = 1 << 12;
+
+enum MaterialDraw : uint8_t {
+    NOT_DRAWN,
+    DRAWN,                     // No mate possible whatever the squares
+    DRAWN_SAME_COLOR_BISHOPS,  // KB vs KB, drawn when both bishops share a colour
+    KPK_BITBASE                // K+P vs K, drawn where the bitbase says so
+};
+
+struct EvalEntry {
+    Key   key;
+    Score score;
+};
+
+struct PawnEntry {
+    Key         key;
+    Bitboard    passed[COLOR_SIZE];
+    PackedScore score;   // White minus black
+};
+
+// Pawn structure terms of one side, for the pawn hash and the tuner
+struct PawnCounts {
+    int      doubled{0};
+    int      isolated{0};
+    int      passed[RANK_SIZE]{};   // By relative rank
+    Bitboard passedPawns{ZERO};
+};
+
+struct MaterialEntry {
+    Key                   key;
+    const Endgame::Entry* endgame;   // Specialised evaluator or scaler
+    MaterialDraw          draw;
+};
+
+// ---------- Material + PST ----------
+static constexpr PsqtTable build_psqt() {
+
+    constexpr const Score* MG_TABLES[PIECETYPE_SIZE] = {nullptr, MG_PAWN_TABLE, MG_KNIGHT_TABLE, MG_BISHOP_TABLE,
+                                                        MG_ROOK_TABLE, MG_QUEEN_TABLE, MG_KING_TABLE};
+    constexpr const Score* EG_TABLES[PIECETYPE_SIZE] = {nullptr, EG_PAWN_TABLE, EG_KNIGHT_TABLE, EG_BISHOP_TABLE,
+                                                        EG_ROOK_TABLE, EG_QUEEN_TABLE, EG_KING_TABLE};
+
+    PsqtTable table{};
+
+    for (int pt = PAWN; pt <= KING; ++pt) {
+        const Piece white = make_piece(WHITE, PieceType(pt));
+        const Piece black = make_piece(BLACK, PieceType(pt));
+
+        // Both kings are always on the board, so their material cancels
+        // out; leaving it out keeps the sums well inside 16 bits
+        const Score mgMaterial = pt == KING ? 0 : MG_PIECE_SCORES[pt];
+        const Score egMaterial = pt == KING ? 0 : EG_PIECE_SCORES[pt];
+
+        for (int s = 0; s < SQ64_SIZE; ++s) {
+            // Black reads the tables flipped and counts negative
+            table[white][s] =  make_score(mgMaterial + MG_TABLES[pt][s], egMaterial + EG_TABLES[pt][s]);
+            table[black][s] = -make_score(mgMaterial + MG_TABLES[pt][flip(s)], egMaterial + EG_TABLES[pt][flip(s)]);
+        }
     }
 
+    return table;
 }
 
+// Built by the compiler: no start-up work, and it lands in read-only data
+constexpr PsqtTable PSQT = build_psqt();
+
+static_assert(PSQT[W_PAWN][SQ64_E4] == make_score(82 + 17, 94 - 7));
+static_assert(PSQT[B_PAWN][SQ64_E5] == -PSQT[W_PAWN][SQ64_E4]);
+static_assert(PSQT[NO_PIECE][SQ64_E4] == 0);
+
+static const PawnEntry& probe_pawns(const Position &position);
+static void evaluate_pawns(const Position &position, PawnEntry &entry);
+static PawnCounts count_pawn_terms(const Position &position, Color color);
+static const MaterialEntry& probe_material(const Position &position);
+static MaterialDraw material_draw_kind(const Position &position);
+static Score evaluate_uncached(const Position &position);
+
+// ---------- Internal State ----------
+
+// Zeroed entries already hold the (empty) evaluation of pawnless positions,
+// whose pawn key is 0
+thread_local PawnEntry pawnTable[PAWN_HASH_ENTRIES];
+thread_local EvalEntry evalTable[EVAL_HASH_ENTRIES];
+thread_local MaterialEntry materialTable[MATERIAL_HASH_ENTRIES];
+thread_local EvalStats evalStats;
+
+EvalStats& thread_stats() { return evalStats; }
+
 // ---------- Main Eval ----------
 Score calc_score(const Position &position) {
-    double mg[COLOR_SIZE] = {0.0, 0.0};
-    double eg[COLOR_SIZE] = {0.0, 0.0};
-    GamePhaseWeight phase = 0;
-
-    // Pawn
-    Bitboard wp = position.get_pieceTypes_bitboard(WHITE, PAWN);
-    while (wp) {
-        const Square64 s{ Bitboards::ctz(wp) };
-        mg[WHITE] += MG_PIECE_SCORES[PieceType::PAWN] + PST_MG[Piece::W_PAWN][s];
-        eg[WHITE] += EG_PIECE_SCORES[PieceType::PAWN] + PST_EG[Piece::W_PAWN][s];
-        phase += PHASE_PIECE_WEIGHT[Piece::W_PAWN];
-        wp &= wp - 1;
-    }
 
-    Bitboard bp = position.get_pieceTypes_bitboard(BLACK, PAWN);
-    while (bp) {
-        const Square64 s{ Bitboards::ctz(bp) };
-        mg[BLACK] += MG_PIECE_SCORES[PieceType::PAWN] + PST_MG[Piece::B_PAWN][s];
-        eg[BLACK] += EG_PIECE_SCORES[PieceType::PAWN] + PST_EG[Piece::B_PAWN][s];
-        phase += PHASE_PIECE_WEIGHT[Piece::B_PAWN];
-        bp &= bp - 1;
-    }
+    // Material + PST come from the accumulator kept by Position
+    PackedScore score = position.psqt();
+    assert(psqt_matches(position));
 
-    // Knight
-    Bitboard wn = position.get_pieceTypes_bitboard(WHITE, KNIGHT);
-    while (wn) {
-        const Square64 s{ Bitboards::ctz(wn) };
-        mg[WHITE] += MG_PIECE_SCORES[PieceType::KNIGHT] + PST_MG[Piece::W_KNIGHT][s];
-        eg[WHITE] += EG_PIECE_SCORES[PieceType::KNIGHT] + PST_EG[Piece::W_KNIGHT][s];
-        phase += PHASE_PIECE_WEIGHT[Piece::W_KNIGHT];
-        wn &= wn - 1;
-    }
+    // Pawn structure
+    score += probe_pawns(position).score;
 
-    Bitboard bn = position.get_pieceTypes_bitboard(BLACK, KNIGHT);
-    while (bn) {
-        const Square64 s{ Bitboards::ctz(bn) };
-        mg[BLACK] += MG_PIECE_SCORES[PieceType::KNIGHT] + PST_MG[Piece::B_KNIGHT][s];
-        eg[BLACK] += EG_PIECE_SCORES[PieceType::KNIGHT] + PST_EG[Piece::B_KNIGHT][s];
-        phase += PHASE_PIECE_WEIGHT[Piece::B_KNIGHT];
-        bn &= bn - 1;
-    }
+    // Tempo
+    const Color stm = position.get_side_to_move();
+    score += stm == WHITE ? TEMPO_BONUS : -TEMPO_BONUS;
+
+    const Score blended = taper(score, position.game_phase_weight());
+    return stm == WHITE ? blended : -blended;
+}
+
+bool psqt_matches(const Position &position) {
+    PackedScore score = 0;
+    for (int s = 0; s < SQ64_SIZE; ++s)
+        score += PSQT[position.get_mailbox_piece(Square64(s))][s];
+    return score == position.psqt();
+}
 
-    // Bishop
-    Bitboard wb = position.get_pieceTypes_bitboard(WHITE, BISHOP);
-    while (wb) {
-        const Square64 s{ Bitboards::ctz(wb) };
-        mg[WHITE] += MG_PIECE_SCORES[PieceType::BISHOP] + PST_MG[Piece::W_BISHOP][s];
-        eg[WHITE] += EG_PIECE_SCORES[PieceType::BISHOP] + PST_EG[Piece::W_BISHOP][s];
-        phase += PHASE_PIECE_WEIGHT[Piece::W_BISHOP];
-        wb &= wb - 1;
+Score evaluate(const Position &position) {
+
+    // The salt keeps classical and network scores apart
+    const Key key = position.get_key() ^ NNUE::cache_salt();
+    EvalEntry &entry = evalTable[key & (EVAL_HASH_ENTRIES - 1)];
+
+    ++evalStats.evalProbes;
+    if (entry.key == key) {
+        ++evalStats.evalHits;
+        return entry.score;
     }
 
-    Bitboard bb = position.get_pieceTypes_bitboard(BLACK, BISHOP);
-    while (bb) {
-        const Square64 s{ Bitboards::ctz(bb) };
-        mg[BLACK] += MG_PIECE_SCORES[PieceType::BISHOP] + PST_MG[Piece::B_BISHOP][s];
-        eg[BLACK] += EG_PIECE_SCORES[PieceType::BISHOP] + PST_EG[Piece::B_BISHOP][s];
-        phase += PHASE_PIECE_WEIGHT[Piece::B_BISHOP];
-        bb &= bb - 1;
+    entry.key   = key;
+    entry.score = evaluate_uncached(position);
+    return entry.score;
+}
+
+Score estimate(const Position &position) {
+    const Color stm = position.get_side_to_move();
+    const PackedScore score = position.psqt() + (stm == WHITE ? TEMPO_BONUS : -TEMPO_BONUS);
+    const Score blended = taper(score, position.game_phase_weight());
+    return stm == WHITE ? blended : -blended;
+}
+
+void estimate_bounds(const Position &position, Score &low, Score &high) {
+    const int white = Bitboards::cpop(position.get_pieceTypes_bitboard(WHITE, PAWN));
+    const int black = Bitboards::cpop(position.get_pieceTypes_bitboard(BLACK, PAWN));
+    const GamePhaseWeight phaseWeight = position.game_phase_weight();
+
+    // One more each way: calc_score() tapers the sum, not the parts
+    const Score whiteLow  = taper(white * PAWN_TERMS_MIN - black * PAWN_TERMS_MAX, phaseWeight) - 1;
+    const Score whiteHigh = taper(white * PAWN_TERMS_MAX - black * PAWN_TERMS_MIN, phaseWeight) + 1;
+
+    const bool whiteToMove = position.get_side_to_move() == WHITE;
+    low  = whiteToMove ? whiteLow  : -whiteHigh;
+    high = whiteToMove ? whiteHigh : -whiteLow;
+}
+
+Score lazy_evaluate(const Position &position, Score alpha, Score beta, bool &exact) {
+
+    if (!NNUE::enabled() && !probe_material(position).endgame) {
+        ++evalStats.lazyProbes;
+        const Score lazy = estimate(position);
+        Score low, high;
+        estimate_bounds(position, low, high);
+        if (lazy + low >= beta || lazy + high <= alpha) {
+            ++evalStats.lazyHits;
+            exact = false;
+            return lazy + low >= beta ? lazy + low : lazy + high;
+        }
     }
 
-    // Rook
-    Bitboard wr = position.get_pieceTypes_bitboard(WHITE, ROOK);
-    while (wr) {
-        const Square64 s{ Bitboards::ctz(wr) };
-        mg[WHITE] += MG_PIECE_SCORES[PieceType::ROOK] + PST_MG[Piece::W_ROOK][s];
-        eg[WHITE] += EG_PIECE_SCORES[PieceType::ROOK] + PST_EG[Piece::W_ROOK][s];
-        phase += PHASE_PIECE_WEIGHT[Piece::W_ROOK];
-        wr &= wr - 1;
+    exact = true;
+    return evaluate(position);
+}
+
+// Endgame knowledge for the material first, then the network or the
+// classical terms
+static Score evaluate_uncached(const Position &position) {
+
+    const Endgame::Entry* endgame = probe_material(position).endgame;
+
+    if (endgame && endgame->eval) {
+        const Score score = endgame->eval(position, endgame->strongSide);
+        return position.get_side_to_move() == endgame->strongSide ? score : -score;
     }
 
-    Bitboard br = position.get_pieceTypes_bitboard(BLACK, ROOK);
-    while (br) {
-        const Square64 s{ Bitboards::ctz(br) };
-        mg[BLACK] += MG_PIECE_SCORES[PieceType::ROOK] + PST_MG[Piece::B_ROOK][s];
-        eg[BLACK] += EG_PIECE_SCORES[PieceType::ROOK] + PST_EG[Piece::B_ROOK][s];
-        phase += PHASE_PIECE_WEIGHT[Piece::B_ROOK];
-        br &= br - 1;
+    Score score = NNUE::enabled() ? NNUE::evaluate(position) : calc_score(position);
+    if (endgame && endgame->scale)
+        score = score * endgame->scale(position, endgame->strongSide) / Endgame::SCALE_NORMAL;
+    return score;
+}
+
+static const MaterialEntry& probe_material(const Position &position) {
+
+    const Key key = position.get_material_key();
+    MaterialEntry &entry = materialTable[key & (MATERIAL_HASH_ENTRIES - 1)];
+
+    ++evalStats.materialProbes;
+    if (entry.key == key) {
+        ++evalStats.materialHits;
+        return entry;
     }
 
-    // Queen
-    Bitboard wq = position.get_pieceTypes_bitboard(WHITE, QUEEN);
-    while (wq) {
-        const Square64 s{ Bitboards::ctz(wq) };
-        mg[WHITE] += MG_PIECE_SCORES[PieceType::QUEEN] + PST_MG[Piece::W_QUEEN][s];
-        eg[WHITE] += EG_PIECE_SCORES[PieceType::QUEEN] + PST_EG[Piece::W_QUEEN][s];
-        phase += PHASE_PIECE_WEIGHT[Piece::W_QUEEN];
-        wq &= wq - 1;
+    entry.key     = key;
+    entry.endgame = Endgame::find(position);
+    entry.draw    = material_draw_kind(position);
+    return entry;
+}
+
+// Draws by insufficient material, from the piece counts alone
+static MaterialDraw material_draw_kind(const Position &position) {
+
+    int counts[COLOR_SIZE][PIECETYPE_SIZE];
+    for (Color c : {WHITE, BLACK})
+        for (int pt = PAWN; pt <= KING; ++pt)
+            counts[c][pt] = Bitboards::cpop(position.get_pieceTypes_bitboard(c, PieceType(pt)));
+
+    int pawns = 0, pieces = 0;
+    for (Color c : {WHITE, BLACK}) {
+        pawns  += counts[c][PAWN];
+        pieces += counts[c][KNIGHT] + counts[c][BISHOP] + counts[c][ROOK] + counts[c][QUEEN];
     }
+    if (pawns == 1 && pieces == 0)
+        return KPK_BITBASE;
+
+    for (Color c : {WHITE, BLACK})
+        if (counts[c][PAWN] || counts[c][ROOK] || counts[c][QUEEN])
+            return NOT_DRAWN;
+
+    const int wn = counts[WHITE][KNIGHT], bn = counts[BLACK][KNIGHT];
+    const int wb = counts[WHITE][BISHOP], bb = counts[BLACK][BISHOP];
+
+    // Knights only: K+N or K+NN vs K (K+NNN vs K can mate in theory)
+    if (!wb && !bb)
+        return (wn < 3 && bn == 0) || (bn < 3 && wn == 0) ? DRAWN : NOT_DRAWN;
 
-    Bitboard bq = position.get_pieceTypes_bitboard(BLACK, QUEEN);
-    while (bq) {
-        const Square64 s{ Bitboards::ctz(bq) };
-        mg[BLACK] += MG_PIECE_SCORES[PieceType::QUEEN] + PST_MG[Piece::B_QUEEN][s];
-        eg[BLACK] += EG_PIECE_SCORES[PieceType::QUEEN] + PST_EG[Piece::B_QUEEN][s];
-        phase += PHASE_PIECE_WEIGHT[Piece::B_QUEEN];
-        bq &= bq - 1;
+    // Bishops only: KB vs K, or KB vs KB on the same colour
+    if (!wn && !bn) {
+        if (wb + bb == 1) return DRAWN;
+        if (wb == 1 && bb == 1) return DRAWN_SAME_COLOR_BISHOPS;
     }
 
-    // Kings
-    Bitboard wk = position.get_pieceTypes_bitboard(WHITE, KING);
-    while (wk) {
-        const Square64 s{ Bitboards::ctz(wk) };
-        mg[WHITE] += MG_PIECE_SCORES[PieceType::KING] + PST_MG[Piece::W_KING][s];
-        eg[WHITE] += EG_PIECE_SCORES[PieceType::KING] + PST_EG[Piece::W_KING][s];
-        wk &= wk - 1;
+    return NOT_DRAWN;
+}
+
+static const PawnEntry& probe_pawns(const Position &position) {
+
+    const Key key = position.get_pawn_key();
+    PawnEntry &entry = pawnTable[key & (PAWN_HASH_ENTRIES - 1)];
+
+    ++evalStats.pawnProbes;
+    if (entry.key == key) {
+        ++evalStats.pawnHits;
+        return entry;
     }
 
-    Bitboard bk = position.get_pieceTypes_bitboard(BLACK, KING);
-    while (bk) {
-        const Square64 s{ Bitboards::ctz(bk) };
-        mg[BLACK] += MG_PIECE_SCORES[PieceType::KING] + PST_MG[Piece::B_KING][s];
-        eg[BLACK] += EG_PIECE_SCORES[PieceType::KING] + PST_EG[Piece::B_KING][s];
-        bk &= bk - 1;
+    entry.key = key;
+    evaluate_pawns(position, entry);
+    return entry;
+}
+
+// Doubled, isolated and passed pawns of one side
+static PawnCounts count_pawn_terms(const Position &position, Color color) {
+
+    const Bitboard own   = position.get_pieceTypes_bitboard(color, PAWN);
+    const Bitboard enemy = position.get_pieceTypes_bitboard(~color, PAWN);
+    PawnCounts counts;
+
+    Bitboard pawns = own;
+    while (pawns) {
+        const Square64 s{ Bitboards::ctz(pawns) };
+        pawns &= pawns - 1;
+
+        const File file = square_file(s);
+        const Rank rank = square_rank(s);
+        const Bitboard fileMask = FILE_A_MASK << file;
+        const Bitboard adjacent = (file > FILE_A ? FILE_A_MASK << (file - 1) : ZERO)
+                                | (file < FILE_H ? FILE_A_MASK << (file + 1) : ZERO);
+        // Squares on the ranks in front of the pawn
+        const Bitboard ahead = color == WHITE ? (rank < RANK_8 ? ~ZERO << (8 * (rank + 1)) : ZERO)
+                                              : (ONE << (8 * rank)) - 1;
+
+        // Only the rear pawn of a doubled pair is penalized
+        if (own & fileMask & ahead)
+            ++counts.doubled;
+
+        if (!(own & adjacent))
+            ++counts.isolated;
+
+        if (!(enemy & (fileMask | adjacent) & ahead) && !(own & fileMask & ahead)) {
+            counts.passedPawns |= ONE << s;
+            ++counts.passed[color == WHITE ? rank : RANK_8 - rank];
+        }
     }
 
-    // Tempo
-    const Color stm = position.get_side_to_move();
-    mg[stm] += MG_TEMPO_BONUS;
-    eg[stm] += EG_TEMPO_BONUS;
+    return counts;
+}
 
-    const GamePhaseWeight mgWeight = std::min<GamePhaseWeight>(phase, MAX_PHASE_PIECE_WEIGHT);
-    const GamePhaseWeight egWeight = MAX_PHASE_PIECE_WEIGHT - mgWeight;
+static void evaluate_pawns(const Position &position, PawnEntry &entry) {
 
-    const double mgScore = mg[stm] - mg[~stm];
-    const double egScore = eg[stm] - eg[~stm];
+    entry.score = 0;
 
-    return mg_eg_blend(mgScore, egScore, mgWeight, egWeight);
+    for (Color color : {WHITE, BLACK}) {
+        const PawnCounts counts = count_pawn_terms(position, color);
+        PackedScore score = counts.doubled * DOUBLED_PAWN + counts.isolated * ISOLATED_PAWN;
+        for (int rank = RANK_1; rank <= RANK_8; ++rank)
+            score += counts.passed[rank] * PASSED_PAWN[rank];
+
+        entry.passed[color] = counts.passedPawns;
+        entry.score += color == WHITE ? score : -score;
+    }
 }
 
 bool material_draw(const Position& pos) {
-    // Fast exit: if there are any pawns on the board, it's never a theoretical material draw.
-    const Bitboard wP = pos.get_pieceTypes_bitboard(WHITE, PAWN);
-    const Bitboard bP = pos.get_pieceTypes_bitboard(BLACK, PAWN);
-    if (wP || bP) return false;
-
-    const Bitboard wQ = pos.get_pieceTypes_bitboard(WHITE, QUEEN);
-    const Bitboard bQ = pos.get_pieceTypes_bitboard(BLACK, QUEEN);
-    const Bitboard wR = pos.get_pieceTypes_bitboard(WHITE, ROOK);
-    const Bitboard bR = pos.get_pieceTypes_bitboard(BLACK, ROOK);
-
-    // No rooks and no queens on the board
-    if (!wR && !bR && !wQ && !bQ) {
-        const Bitboard wB = pos.get_pieceTypes_bitboard(WHITE, BISHOP);
-        const Bitboard bB = pos.get_pieceTypes_bitboard(BLACK, BISHOP);
-        const Bitboard wN = pos.get_pieceTypes_bitboard(WHITE, KNIGHT);
-        const Bitboard bN = pos.get_pieceTypes_bitboard(BLACK, KNIGHT);
-
-        // Knights only (no bishops at all)
-        if (!wB && !bB) {
-            const int wn = Bitboards::cpop(wN);
-            const int bn = Bitboards::cpop(bN);
-            // K+N or K+NN vs K is a draw; K+NNN vs K can mate in theory (but is practically impossible),
-            // so treat draws when the stronger side has < 3 knights and the weaker side has none.
-            return (wn < 3 && bn == 0) || (bn < 3 && wn == 0);
-        }
-        // Bishops only (no knights at all)
-        else if (!wN && !bN) {
-            const int wb = Bitboards::cpop(wB);
-            const int bb = Bitboards::cpop(bB);
-            const int totalB = wb + bb;
-
-            // KB vs K is a draw
-            if (totalB == 1) return true;
-
-            if (totalB == 2) {
-                // Draw only when it's KB vs KB and both bishops are on the same color complex.
-                // IMPORTANT: require exactly one bishop per side; otherwise KBB vs K would be wrongly flagged as a draw.
-                if (wb == 1 && bb == 1) {
-                    constexpr Bitboard DARK_SQUARES = 0xAA55AA55AA55AA55ULL;
-                    const bool wDark = (wB & DARK_SQUARES) != 0;
-                    const bool bDark = (bB & DARK_SQUARES) != 0;
-                    return wDark == bDark; // same-color bishops → theoretical draw
-                }
-                // KBB vs K (or K vs KBB): NOT a theoretical draw.
-                return false;
-            }
-            // 3+ bishops in total (promotions, etc.) → not a theoretical draw.
-        }
-    }
-    // No queens; check "minor-only vs bare king" cases while also excluding rooks.
-    else if (!wQ && !bQ) {
-        const Bitboard wB = pos.get_pieceTypes_bitboard(WHITE, BISHOP);
-        const Bitboard bB = pos.get_pieceTypes_bitboard(BLACK, BISHOP);
-        const Bitboard wN = pos.get_pieceTypes_bitboard(WHITE, KNIGHT);
-        const Bitboard bN = pos.get_pieceTypes_bitboard(BLACK, KNIGHT);
-
-        // White has no rook/bishop/knight: black's remaining force < 2 minor pieces → draw.
-        if (!wR && !wB && !wN) {
-            const int bn = Bitboards::cpop(bN);
-            const int bb = Bitboards::cpop(bB);
-            return !bR && (bn + bb) < 2;
-        }
-        // Black has no rook/bishop/knight: white's remaining force < 2 minor pieces → draw.
-        else if (!bR && !bB && !bN) {
-            const int wn = Bitboards::cpop(wN);
-            const int wb = Bitboards::cpop(wB);
-            return !wR && (wn + wb) < 2;
-        }
+
+    // At most two minor pieces can be left: skip the probe otherwise
+    if (pos.game_phase_weight() > 2 * PHASE_PIECE_WEIGHT[W_KNIGHT])
+        return false;
+
+    const MaterialEntry &entry = probe_material(pos);
+
+    if (entry.draw == DRAWN_SAME_COLOR_BISHOPS) {
+        const bool whiteDark = pos.get_pieceTypes_bitboard(WHITE, BISHOP) & Bitboards::DARK_SQUARES;
+        const bool blackDark = pos.get_pieceTypes_bitboard(BLACK, BISHOP) & Bitboards::DARK_SQUARES;
+        return whiteDark == blackDark;
     }
 
-    // Default: not a theoretical material draw.
-    return false;
+    if (entry.draw == KPK_BITBASE)
+        return !Bitbase::probe_kpk(pos);
+
+    return entry.draw == DRAWN;
 }
 
 Score to_centipawns(Score score, GamePhaseWeight phaseWeight) {
+    // One pawn, tapered like the rest of the evaluation, is 100 centipawns
     const GamePhaseWeight mgWeight = std::min<GamePhaseWeight>(phaseWeight, MAX_PHASE_PIECE_WEIGHT);
-    const GamePhaseWeight egWeight = MAX_PHASE_PIECE_WEIGHT - mgWeight;
-    const double pawnValue = (MG_PIECE_SCORES[PieceType::PAWN] * mgWeight
-                             + EG_PIECE_SCORES[PieceType::PAWN] * egWeight)
-                             / static_cast<double>(MAX_PHASE_PIECE_WEIGHT);
-    if (pawnValue == 0.0) {
-        return 0;
-    }
-    return static_cast<Score>(std::lround(score * (100.0 / pawnValue)));
+    const int64_t pawnValue = int64_t(MG_PIECE_SCORES[PieceType::PAWN]) * mgWeight
+                            + int64_t(EG_PIECE_SCORES[PieceType::PAWN]) * (MAX_PHASE_PIECE_WEIGHT - mgWeight);
+    return div_round(int64_t(score) * 100 * MAX_PHASE_PIECE_WEIGHT, pawnValue);
 }
 
-static inline Score mg_eg_blend(double mg, double eg, int mgWeight, int egWeight) {
-    const double blended = (mg * mgWeight + eg * egWeight) / MAX_PHASE_PIECE_WEIGHT;
-    return static_cast<Score>(std::lround(blended));
+PackedScore tune_parameter(int param) {
+    if (param < TUNE_TEMPO)
+        return PSQT[make_piece(WHITE, PieceType(PAWN + param / SQ64_SIZE))][param % SQ64_SIZE];
+    if (param == TUNE_TEMPO)    return TEMPO_BONUS;
+    if (param == TUNE_DOUBLED)  return DOUBLED_PAWN;
+    if (param == TUNE_ISOLATED) return ISOLATED_PAWN;
+    return PASSED_PAWN[param - TUNE_PASSED];
+}
+
+void tune_trace(const Position &position, std::vector<TuneTerm> &terms) {
+
+    int counts[TUNE_SIZE] = {};
+
+    // Black pieces read the tables flipped, as in PSQT
+    for (int s = 0; s < SQ64_SIZE; ++s) {
+        const Piece piece = position.get_mailbox_piece(Square64(s));
+        if (piece == NO_PIECE)
+            continue;
+        const bool white = piece_color(piece) == WHITE;
+        counts[TUNE_PSQT + (piece_type(piece) - PAWN) * SQ64_SIZE + (white ? s : flip(s))] += white ? 1 : -1;
+    }
+
+    counts[TUNE_TEMPO] = position.get_side_to_move() == WHITE ? 1 : -1;
+
+    for (Color color : {WHITE, BLACK}) {
+        const int sign = color == WHITE ? 1 : -1;
+        const PawnCounts pawns = count_pawn_terms(position, color);
+        counts[TUNE_DOUBLED]  += sign * pawns.doubled;
+        counts[TUNE_ISOLATED] += sign * pawns.isolated;
+        for (int rank = RANK_1; rank <= RANK_8; ++rank)
+            counts[TUNE_PASSED + rank] += sign * pawns.passed[rank];
+    }
+
+    terms.clear();
+    for (int param = 0; param < TUNE_SIZE; ++param)
+        if (counts[param])
+            terms.push_back({uint16_t(param), int8_t(counts[param])});
 }
 
 } // namespace Evaluate
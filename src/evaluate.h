@@ -3,6 +3,9 @@
 
 #include "types.h"
 
+#include <array>
+#include <vector>
+
 
 namespace Akerbeltz{
 
@@ -12,7 +15,8 @@ namespace Evaluate{
 
     using Score = int32_t;
     
-    constexpr Score CHECKMATE_SCORE = 900000;
+    // Fits in the 16-bit score field of a TT entry
+    constexpr Score CHECKMATE_SCORE = 32000;
     constexpr Score DRAW_SOCORE = 0;
 
     using GamePhaseWeight = int;
@@ -27,13 +31,116 @@ namespace Evaluate{
         /*gap*/ 0
     };
 
-    void init();
+    /*Packed score: midgame and endgame values in one 32-bit integer, the
+    endgame value in the upper 16 bits and the midgame value in the lower
+    16. Packed scores add and subtract like plain integers as long as both
+    halves stay within int16, so one add updates both game phases.
+    */
+    using PackedScore = int32_t;
+
+    constexpr PackedScore make_score(int mg, int eg) {
+        return PackedScore(uint32_t(eg) << 16) + mg;
+    }
+
+    constexpr Score mg_value(PackedScore score) {
+        return int16_t(uint16_t(uint32_t(score)));
+    }
+
+    // Adding 0x8000 undoes the borrow a negative midgame half takes
+    constexpr Score eg_value(PackedScore score) {
+        return int16_t(uint16_t((uint32_t(score) + 0x8000) >> 16));
+    }
+
+    // Rounded integer division, halves away from zero (like std::lround)
+    constexpr Score div_round(int64_t num, int64_t den) {
+        return Score(num >= 0 ? (num + den / 2) / den : -((-num + den / 2) / den));
+    }
+
+    // Blends both halves by the game phase (MAX_PHASE_PIECE_WEIGHT = midgame)
+    constexpr Score taper(PackedScore score, GamePhaseWeight phaseWeight) {
+        const GamePhaseWeight mgWeight = phaseWeight < MAX_PHASE_PIECE_WEIGHT ? phaseWeight : MAX_PHASE_PIECE_WEIGHT;
+        return div_round(int64_t(mg_value(score)) * mgWeight
+                       + int64_t(eg_value(score)) * (MAX_PHASE_PIECE_WEIGHT - mgWeight), MAX_PHASE_PIECE_WEIGHT);
+    }
+
+    // Material + piece-square value of each piece on each square, from
+    // white's point of view (black pieces count negative). Built at compile
+    // time and summed incrementally by Position.
+    using PsqtTable = std::array<std::array<PackedScore, SQ64_SIZE>, Piece::PIECE_SIZE>;
+    extern const PsqtTable PSQT;
+
+    // Cache counters of one search thread
+    struct EvalStats{
+        uint64_t pawnProbes{0};
+        uint64_t pawnHits{0};
+        uint64_t evalProbes{0};
+        uint64_t evalHits{0};
+        uint64_t materialProbes{0};
+        uint64_t materialHits{0};
+        uint64_t ttEvalHits{0};   // Static evals taken from the TT by search
+        uint64_t lazyProbes{0};
+        uint64_t lazyHits{0};     // Window tests decided by the estimate alone
+    };
+
+    // Counters of the calling thread
+    EvalStats& thread_stats();
 
     Score calc_score(const Position &position);
 
+    // calc_score() behind a per-thread cache keyed on the position key
+    Score evaluate(const Position &position);
+
+    // Cheap tier: the material + PST + tempo part of calc_score(), read
+    // from the accumulators Position keeps
+    Score estimate(const Position &position);
+
+    // Pawn structure is all calc_score() adds to the estimate: from the
+    // pawn counts, calc_score() lies in [estimate + low, estimate + high]
+    void estimate_bounds(const Position &position, Score &low, Score &high);
+
+    // Piece values for exchanges (SEE) and qsearch delta pruning
+    inline constexpr Score SEE_VALUE[PIECETYPE_SIZE] = {0, 100, 320, 330, 500, 950, 0};
+
+    // Static eval for a test against [alpha, beta]. When the estimate moved
+    // by its bounds towards the window is still outside it, that bound is
+    // returned and 'exact' is false; otherwise evaluate() answers. The
+    // network and endgame evaluators are never estimated.
+    Score lazy_evaluate(const Position &position, Score alpha, Score beta, bool &exact);
+
+    // Recomputes the position's material + PST accumulators from scratch
+    // and compares; calc_score() asserts it in debug builds
+    bool psqt_matches(const Position &position);
+
+    // Insufficient material to mate (KK, KNK, KNNK, KBK, KB vs KB on one
+    // colour) or a drawn KPK, looked up in the per-thread material hash
     bool material_draw(const Position& pos);
 
     Score to_centipawns(Score score, GamePhaseWeight phaseWeight);
+
+    /*Tuning view of calc_score(): the tapered sum of feature counts, white
+    minus black, times packed parameters. The parameters are, in order,
+    material + PST of each piece type on each square from white's side,
+    tempo, doubled pawn, isolated pawn and passed pawn by relative rank.
+    */
+    enum TuneParam : int{
+        TUNE_PSQT     = 0,
+        TUNE_TEMPO    = TUNE_PSQT + (PIECETYPE_SIZE - 1) * SQ64_SIZE,
+        TUNE_DOUBLED,
+        TUNE_ISOLATED,
+        TUNE_PASSED,
+        TUNE_SIZE     = TUNE_PASSED + RANK_SIZE
+    };
+
+    struct TuneTerm{
+        uint16_t param;
+        int8_t   count;
+    };
+
+    // Value calc_score() uses for a parameter
+    PackedScore tune_parameter(int param);
+
+    // Non-zero features of the position
+    void tune_trace(const Position &position, std::vector<TuneTerm> &terms);
 }
 }
 
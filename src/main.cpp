@@ -1,15 +1,20 @@
 #include "position.h"
 #include "attacks.h"
+#include "bitbase.h"
+#include "endgame.h"
 #include "evaluate.h"
+#include "nnue.h"
+#include "tablebase.h"
 #include "uci.h"
 #include "engine_info.h"
 
 #include <iostream>
+#include <string>
 
 using namespace std;
 using namespace Akerbeltz;
 
-int main()
+int main(int argc, char* argv[])
 {   
     std::cout << ENGINE_NAME << " " << ENGINE_VERSION
               << " by " << ENGINE_AUTHOR
@@ -17,8 +22,15 @@ int main()
               << std::endl;
 
     Attacks::init();
+    Bitbase::init();
     Position::init();
-    Evaluate::init();
+    Endgame::init();
+    NNUE::init();
+
+    // Offline tablebase generation: Akerbeltz tbgen <material> [directory]
+    if (argc >= 3 && std::string(argv[1]) == "tbgen")
+        return Tablebase::generate(argv[2], argc >= 4 ? argv[3] : ".") ? 0 : 1;
+
     UCI::run();
 
     return 0;
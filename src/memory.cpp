@@ -0,0 +1,233 @@
+#include "memory.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+#elif defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <malloc.h>
+#include <windows.h>
+#endif
+
+namespace Akerbeltz{
+
+namespace Memory{
+
+std::size_t round_up(std::size_t bytes, std::size_t alignment);
+
+#if defined(__linux__)
+bool transparent_huge_pages_enabled();
+bool interleave_nodes(void* ptr, std::size_t size);
+#endif
+
+std::size_t round_up(std::size_t bytes, std::size_t alignment){
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+LargeAllocation alloc_large(std::size_t bytes, bool interleave){
+
+    LargeAllocation allocation;
+    const std::size_t size = round_up(std::max<std::size_t>(bytes, 1), LARGE_PAGE_SIZE);
+
+#if defined(__linux__)
+
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+    if(ptr != MAP_FAILED){
+        allocation.mode = PAGES_HUGETLB;
+    }
+    else{
+        ptr = std::aligned_alloc(LARGE_PAGE_SIZE, size);
+        if(!ptr) return allocation;
+
+        allocation.mode = madvise(ptr, size, MADV_HUGEPAGE) == 0 && transparent_huge_pages_enabled()
+                        ? PAGES_TRANSPARENT_HUGE
+                        : PAGES_NORMAL;
+    }
+
+    allocation.interleaved = interleave && interleave_nodes(ptr, size);
+
+#elif defined(_WIN32)
+
+    void* ptr = _aligned_malloc(size, LARGE_PAGE_SIZE);
+    if(!ptr) return allocation;
+    allocation.mode = PAGES_NORMAL;
+    (void)interleave;
+
+#else
+
+    void* ptr = std::aligned_alloc(LARGE_PAGE_SIZE, size);
+    if(!ptr) return allocation;
+    allocation.mode = PAGES_NORMAL;
+    (void)interleave;
+
+#endif
+
+    allocation.ptr  = ptr;
+    allocation.size = size;
+    return allocation;
+}
+
+void free_large(LargeAllocation &allocation){
+
+    if(!allocation.ptr) return;
+
+#if defined(__linux__)
+    if(allocation.mode == PAGES_HUGETLB)
+        munmap(allocation.ptr, allocation.size);
+    else
+        std::free(allocation.ptr);
+#elif defined(_WIN32)
+    _aligned_free(allocation.ptr);
+#else
+    std::free(allocation.ptr);
+#endif
+
+    allocation = LargeAllocation{};
+}
+
+std::string_view page_mode_name(PageMode mode){
+    switch (mode)
+    {
+        case PAGES_HUGETLB:          return "huge pages (MAP_HUGETLB)";
+        case PAGES_TRANSPARENT_HUGE: return "transparent huge pages";
+        case PAGES_NORMAL:           return "normal pages";
+        default:                     return "no memory";
+    }
+}
+
+MappedFile map_file(const std::string &path){
+
+    MappedFile file;
+
+#if defined(__unix__) || defined(__APPLE__)
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) return file;
+
+    struct stat info;
+    if(fstat(fd, &info) == 0 && info.st_size > 0){
+        void* ptr = mmap(nullptr, std::size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if(ptr != MAP_FAILED){
+            // Probes jump around the file
+            madvise(ptr, std::size_t(info.st_size), MADV_RANDOM);
+            file.ptr  = ptr;
+            file.size = std::size_t(info.st_size);
+        }
+    }
+    close(fd);
+
+#elif defined(_WIN32)
+
+    HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                    OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if(fileHandle == INVALID_HANDLE_VALUE) return file;
+
+    LARGE_INTEGER size;
+    if(GetFileSizeEx(fileHandle, &size) && size.QuadPart > 0){
+        HANDLE mapping = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mapping){
+            const void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if(ptr){
+                file.ptr    = ptr;
+                file.size   = std::size_t(size.QuadPart);
+                file.handle = mapping;
+            }
+            else
+                CloseHandle(mapping);
+        }
+    }
+    CloseHandle(fileHandle);
+
+#else
+
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    const std::streamoff size = in ? std::streamoff(in.tellg()) : 0;
+    if(size <= 0) return file;
+
+    char* buffer = new char[std::size_t(size)];
+    in.seekg(0);
+    if(!in.read(buffer, size)){
+        delete[] buffer;
+        return file;
+    }
+    file.ptr    = buffer;
+    file.size   = std::size_t(size);
+    file.handle = buffer;
+
+#endif
+
+    return file;
+}
+
+void unmap_file(MappedFile &file){
+
+    if(!file.ptr) return;
+
+#if defined(__unix__) || defined(__APPLE__)
+    munmap(const_cast<void*>(file.ptr), file.size);
+#elif defined(_WIN32)
+    UnmapViewOfFile(file.ptr);
+    CloseHandle(file.handle);
+#else
+    delete[] static_cast<char*>(file.handle);
+#endif
+
+    file = MappedFile{};
+}
+
+#if defined(__linux__)
+
+// madvise succeeds even when THP is switched off system-wide
+bool transparent_huge_pages_enabled(){
+    std::ifstream sysfs("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string setting;
+    std::getline(sysfs, setting);
+    return !setting.empty() && setting.find("[never]") == std::string::npos;
+}
+
+// Spreads the pages of the block over all online NUMA nodes. Must run
+// before the memory is first touched.
+bool interleave_nodes(void* ptr, std::size_t size){
+
+    std::ifstream sysfs("/sys/devices/system/node/online");
+    std::string ranges;
+    if(!(sysfs >> ranges)) return false;
+
+    unsigned long nodeMask = 0;
+    std::size_t begin = 0;
+
+    while(begin < ranges.size()){
+        const std::size_t end = std::min(ranges.find(',', begin), ranges.size());
+        const std::string range = ranges.substr(begin, end - begin);
+        const std::size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last  = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for(int node = first; node <= last && node < 64; ++node)
+            nodeMask |= 1UL << node;
+        begin = end + 1;
+    }
+
+    if(std::popcount(nodeMask) < 2) return false;
+
+    return syscall(SYS_mbind, ptr, size, MPOL_INTERLEAVE, &nodeMask, 8 * sizeof(nodeMask) + 1, 0) == 0;
+}
+
+#endif
+
+} // namespace Memory
+
+} // namespace Akerbeltz
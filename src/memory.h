@@ -0,0 +1,55 @@
+#ifndef INCLUDE_MEMORY_H
+#define INCLUDE_MEMORY_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace Akerbeltz{
+
+namespace Memory{
+
+    constexpr std::size_t LARGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    enum PageMode{
+        PAGES_NONE,
+        PAGES_NORMAL,
+        PAGES_TRANSPARENT_HUGE,
+        PAGES_HUGETLB
+    };
+
+    struct LargeAllocation{
+        void*       ptr{nullptr};
+        std::size_t size{0};
+        PageMode    mode{PAGES_NONE};
+        bool        interleaved{false};
+    };
+
+    // Allocates a large-page aligned block, trying explicit huge pages
+    // (MAP_HUGETLB), then transparent huge pages (MADV_HUGEPAGE) and
+    // finally normal pages. Memory is not touched, so the caller decides
+    // which threads fault it in.
+    LargeAllocation alloc_large(std::size_t bytes, bool interleave = false);
+
+    void free_large(LargeAllocation &allocation);
+
+    std::string_view page_mode_name(PageMode mode);
+
+    // Read-only view of a whole file
+    struct MappedFile{
+        const void* ptr{nullptr};
+        std::size_t size{0};
+        void*       handle{nullptr};   // Mapping object (Windows) or read buffer
+    };
+
+    // Maps the file where the OS allows it and reads it into memory
+    // otherwise; ptr stays null when the file cannot be opened or is empty
+    MappedFile map_file(const std::string &path);
+
+    void unmap_file(MappedFile &file);
+
+} // namespace Memory
+
+} // namespace Akerbeltz
+
+#endif // #ifndef INCLUDE_MEMORY_H
@@ -116,8 +116,30 @@ inline Move raw_move(Move move){
     return move & 0x1FFFFFFULL;
 }
 
+// From, to and special flag identify a move within a position, so the
+// attacker/captured fields (absent from packed moves) are not compared
 inline bool equal_move(Move move1, Move move2){
-    return raw_move(move1) == raw_move(move2);
+    return ((move1 ^ move2) & 0x1FFFFULL) == 0;
+}
+
+/*PackedMove:
+0000 0000 0011 1111 -> From
+0000 1111 1100 0000 -> To
+0111 0000 0000 0000 -> Special code: 0-3 as SpecialMove, 4-7 promotion to N/B/R/Q
+*/
+using PackedMove = uint16_t;
+
+inline PackedMove pack_move(Move move){
+    const SpecialMove special = move_special(move);
+    const int code = special > CASTLE ? 4 + ((special >> 2) - KNIGHT) : special;
+    return PackedMove((code << 12) | (move & 0xFFF));
+}
+
+// Restores from, to and special flag; attacker/captured pieces come from the position
+inline Move unpack_move(PackedMove packed){
+    const int code = packed >> 12;
+    const int special = code < 4 ? code : (code - 4 + KNIGHT) << 2;
+    return Move((special << 12) | (packed & 0xFFF));
 }
 
 inline std::string algebraic_move(Move move) {
@@ -48,6 +48,15 @@ void extract_capture_moves(const Position &pos, Square64 from, Bitboard toBitboa
 template<PieceType PT>
 constexpr const Bitboard* non_sliding_attack_table();
 
+//LEGAL
+struct LegalInfo;
+LegalInfo legal_info(const Position &pos);
+Bitboard attacked_squares(const Position &pos, Color side, Bitboard occupied);
+void add_move(const Position &pos, Square64 from, Square64 to, MoveList &moveList);
+void legal_pawn_moves(const Position &pos, const LegalInfo &info, MoveList &moveList);
+void legal_piece_moves(const Position &pos, const LegalInfo &info, MoveList &moveList);
+void legal_king_moves(const Position &pos, const LegalInfo &info, MoveList &moveList);
+
 //DEFINITIONS
 void generate_pseudo_moves(const Position &pos, MoveList &moveList){
     if(pos.get_side_to_move() == WHITE){
@@ -90,7 +99,28 @@ void black_pawn_moves(const Position &pos, MoveList &moveList){
     black_pawn_quiet_moves(pos, moveList);
 }
 
-void generate_pseudo_captures(Position &pos, MoveList &moveList){
+void generate_pseudo_quiets(const Position &pos, MoveList &moveList){
+    if(pos.get_side_to_move() == WHITE){
+        white_pawn_quiet_moves(pos, moveList);
+        no_special_moves<WHITE, KNIGHT, QUIET>(pos, moveList);
+        no_special_moves<WHITE, KING, QUIET>(pos, moveList);
+        castling_moves<WHITE>(pos, moveList);
+        bishop_moves<WHITE, QUIET>(pos, moveList);
+        rook_moves<WHITE, QUIET>(pos, moveList);
+        queen_moves<WHITE, QUIET>(pos, moveList);
+    }
+    else{
+        black_pawn_quiet_moves(pos, moveList);
+        no_special_moves<BLACK, KNIGHT, QUIET>(pos, moveList);
+        no_special_moves<BLACK, KING, QUIET>(pos, moveList);
+        castling_moves<BLACK>(pos, moveList);
+        bishop_moves<BLACK, QUIET>(pos, moveList);
+        rook_moves<BLACK, QUIET>(pos, moveList);
+        queen_moves<BLACK, QUIET>(pos, moveList);
+    }
+}
+
+void generate_pseudo_captures(const Position &pos, MoveList &moveList){
     if(pos.get_side_to_move() == WHITE){
         white_pawn_capture_moves(pos, moveList);
         no_special_moves<WHITE, KNIGHT, CAPTURE>(pos, moveList);
@@ -208,6 +238,192 @@ void black_pawn_quiet_moves(const Position &pos, MoveList &moveList){
 
 }
 
+//LEGAL GENERATION
+struct LegalInfo{
+    Color    us;
+    Square64 king;
+    Bitboard checkers;
+    Bitboard pinned;    // Own pieces that may only move along the line to the king
+    Bitboard target;    // Where non-king moves may land: anywhere, or capture/block a single checker
+    Bitboard danger;    // Enemy attacks, seen through our king
+};
+
+void generate_legal(const Position &pos, MoveList &moveList){
+
+    const LegalInfo info = legal_info(pos);
+
+    // Double check: only the king can move
+    if(Bitboards::cpop(info.checkers) < 2){
+        legal_pawn_moves(pos, info, moveList);
+        legal_piece_moves(pos, info, moveList);
+    }
+    legal_king_moves(pos, info, moveList);
+}
+
+LegalInfo legal_info(const Position &pos){
+
+    LegalInfo info;
+    info.us   = pos.get_side_to_move();
+    info.king = Square64(Bitboards::ctz(pos.get_pieceTypes_bitboard(info.us, KING)));
+
+    info.checkers = pos.checkers();
+    info.pinned   = pos.pinned();
+    info.danger   = attacked_squares(pos, ~info.us, pos.get_occupied_bitboard(COLOR_NC) & ~pos.get_pieceTypes_bitboard(info.us, KING));
+
+    info.target = ~pos.get_occupied_bitboard(info.us);
+    if(info.checkers){
+        const Square64 checker{Bitboards::ctz(info.checkers)};
+        info.target &= Attacks::betweenSquares[info.king][checker] | info.checkers;
+    }
+    return info;
+}
+
+Bitboard attacked_squares(const Position &pos, Color side, Bitboard occupied){
+
+    const Bitboard pawns = pos.get_pieceTypes_bitboard(side, PAWN);
+    Bitboard attacked = side == WHITE
+                      ? Bitboards::make_direction<NORTH_EAST>(pawns) | Bitboards::make_direction<NORTH_WEST>(pawns)
+                      : Bitboards::make_direction<SOUTH_EAST>(pawns) | Bitboards::make_direction<SOUTH_WEST>(pawns);
+
+    attacked |= Attacks::kingAttacks[Bitboards::ctz(pos.get_pieceTypes_bitboard(side, KING))];
+    for(Bitboard b = pos.get_pieceTypes_bitboard(side, KNIGHT); b; b &= b - 1){
+        attacked |= Attacks::knightAttacks[Bitboards::ctz(b)];
+    }
+    const Bitboard queens = pos.get_pieceTypes_bitboard(side, QUEEN);
+    for(Bitboard b = pos.get_pieceTypes_bitboard(side, BISHOP) | queens; b; b &= b - 1){
+        attacked |= Attacks::sliding_diagonal_attacks(Square64(Bitboards::ctz(b)), occupied);
+    }
+    for(Bitboard b = pos.get_pieceTypes_bitboard(side, ROOK) | queens; b; b &= b - 1){
+        attacked |= Attacks::sliding_side_attacks(Square64(Bitboards::ctz(b)), occupied);
+    }
+    return attacked;
+}
+
+// Encoded like the pseudo-legal generator does
+void add_move(const Position &pos, Square64 from, Square64 to, MoveList &moveList){
+    const Piece captured = pos.get_mailbox_piece(to);
+    if(captured == NO_PIECE){
+        moveList.set_move(make_quiet_move(from, to, NO_SPECIAL));
+    }
+    else{
+        moveList.set_move(make_capture_move(from, to, NO_SPECIAL, pos.get_mailbox_piece(from), captured));
+    }
+}
+
+void legal_pawn_moves(const Position &pos, const LegalInfo &info, MoveList &moveList){
+
+    const Color us = info.us;
+    const int up = us == WHITE ? NORTH : SOUTH;
+    const Bitboard occupied = pos.get_occupied_bitboard(COLOR_NC);
+    const Bitboard enemies  = pos.get_occupied_bitboard(~us);
+    const Bitboard startRank = us == WHITE ? Bitboards::RANK_2_MASK : Bitboards::RANK_7_MASK;
+    const Bitboard lastRank  = us == WHITE ? Bitboards::RANK_8_MASK : Bitboards::RANK_1_MASK;
+    const Square64 enpassant = pos.get_enpassant_square();
+
+    for(Bitboard pawns = pos.get_pieceTypes_bitboard(us, PAWN); pawns; pawns &= pawns - 1){
+        const Square64 from{Bitboards::ctz(pawns)};
+        const Bitboard allowed = info.target & ((info.pinned & (ONE << from)) ? Attacks::lineSquares[info.king][from] : ~ZERO);
+
+        Bitboard moves = ZERO;
+        const Square64 push = Square64(int(from) + up);
+        if(!(occupied & (ONE << push))){
+            moves |= ONE << push;
+            const Square64 doublePush = Square64(int(push) + up);
+            if((startRank & (ONE << from)) && !(occupied & (ONE << doublePush)) && (allowed & (ONE << doublePush))){
+                moveList.set_move(make_quiet_move(from, doublePush, PAWN_START));
+            }
+        }
+        moves |= Attacks::pawnAttacks[us][from] & enemies;
+        moves &= allowed;
+
+        for(; moves; moves &= moves - 1){
+            const Square64 to{Bitboards::ctz(moves)};
+            if(lastRank & (ONE << to)){
+                const Piece captured = pos.get_mailbox_piece(to);
+                for(SpecialMove promotion : {PROMOTION_QUEEN, PROMOTION_KNIGHT, PROMOTION_ROOK, PROMOTION_BISHOP}){
+                    moveList.set_move(captured == NO_PIECE ? make_quiet_move(from, to, promotion)
+                                                           : make_capture_move(from, to, promotion, pos.get_mailbox_piece(from), captured));
+                }
+            }
+            else{
+                add_move(pos, from, to, moveList);
+            }
+        }
+
+        // En passant removes two pieces from a line: replay it on the occupancy
+        if(enpassant != SQ64_NO_SQUARE && (Attacks::pawnAttacks[us][from] & (ONE << enpassant))){
+            const Bitboard capturedPawn = ONE << (int(enpassant) - up);
+            const Bitboard after = (occupied ^ (ONE << from) ^ capturedPawn) | (ONE << enpassant);
+            if(!(pos.attackers_to(info.king, after) & enemies & ~capturedPawn)){
+                moveList.set_move(make_enpassant_move(from, enpassant));
+            }
+        }
+    }
+}
+
+void legal_piece_moves(const Position &pos, const LegalInfo &info, MoveList &moveList){
+
+    const Bitboard occupied = pos.get_occupied_bitboard(COLOR_NC);
+
+    // A pinned knight can never move
+    for(Bitboard knights = pos.get_pieceTypes_bitboard(info.us, KNIGHT) & ~info.pinned; knights; knights &= knights - 1){
+        const Square64 from{Bitboards::ctz(knights)};
+        for(Bitboard moves = Attacks::knightAttacks[from] & info.target; moves; moves &= moves - 1){
+            add_move(pos, from, Square64(Bitboards::ctz(moves)), moveList);
+        }
+    }
+
+    const Bitboard queens = pos.get_pieceTypes_bitboard(info.us, QUEEN);
+    for(Bitboard sliders = pos.get_pieceTypes_bitboard(info.us, BISHOP) | pos.get_pieceTypes_bitboard(info.us, ROOK) | queens;
+        sliders; sliders &= sliders - 1){
+        const Square64 from{Bitboards::ctz(sliders)};
+        const PieceType type = piece_type(pos.get_mailbox_piece(from));
+
+        Bitboard moves = ZERO;
+        if(type != ROOK)   moves |= Attacks::sliding_diagonal_attacks(from, occupied);
+        if(type != BISHOP) moves |= Attacks::sliding_side_attacks(from, occupied);
+        moves &= info.target;
+        if(info.pinned & (ONE << from)){
+            moves &= Attacks::lineSquares[info.king][from];
+        }
+
+        for(; moves; moves &= moves - 1){
+            add_move(pos, from, Square64(Bitboards::ctz(moves)), moveList);
+        }
+    }
+}
+
+void legal_king_moves(const Position &pos, const LegalInfo &info, MoveList &moveList){
+
+    for(Bitboard moves = Attacks::kingAttacks[info.king] & ~pos.get_occupied_bitboard(info.us) & ~info.danger; moves; moves &= moves - 1){
+        add_move(pos, info.king, Square64(Bitboards::ctz(moves)), moveList);
+    }
+
+    if(info.checkers){
+        return;
+    }
+
+    // The king may not cross or land on an attacked square
+    const CastlingRight rights = pos.get_castling_right();
+    const Bitboard occupied = pos.get_occupied_bitboard(COLOR_NC);
+    if(info.us == WHITE){
+        if((rights & WKCA) && !(occupied & 0x0000000000000060) && !(info.danger & 0x0000000000000060)){
+            moveList.set_move(make_quiet_move(SQ64_E1, SQ64_G1, CASTLE));
+        }
+        if((rights & WQCA) && !(occupied & 0x000000000000000E) && !(info.danger & 0x000000000000000C)){
+            moveList.set_move(make_quiet_move(SQ64_E1, SQ64_C1, CASTLE));
+        }
+    }
+    else{
+        if((rights & BKCA) && !(occupied & 0x6000000000000000) && !(info.danger & 0x6000000000000000)){
+            moveList.set_move(make_quiet_move(SQ64_E8, SQ64_G8, CASTLE));
+        }
+        if((rights & BQCA) && !(occupied & 0x0E00000000000000) && !(info.danger & 0x0C00000000000000)){
+            moveList.set_move(make_quiet_move(SQ64_E8, SQ64_C8, CASTLE));
+        }
+    }
+}
+
 template<Color C, PieceType PT, MoveType MT>
 void no_special_moves(const Position &pos, MoveList &moveList){
 
@@ -235,14 +451,14 @@ void castling_moves(const Position &pos, MoveList &moveList){
     if constexpr(C == WHITE){
         if(castlingRights & CastlingRight::WKCA){
             if((pos.get_occupied_bitboard(COLOR_NC) & 0x0000000000000060) == 0){
-                if(!pos.square_is_attacked_bySide(SQ64_F1, BLACK) && !pos.square_is_attacked_bySide(SQ64_E1, BLACK)){
+                if(!pos.checkers() && !pos.square_is_attacked_bySide(SQ64_F1, BLACK)){
                     moveList.set_move(make_quiet_move(SQ64_E1, SQ64_G1, SpecialMove::CASTLE));
                 }
             }
         }
         if(castlingRights & CastlingRight::WQCA){
             if((pos.get_occupied_bitboard(COLOR_NC) & 0x000000000000000E) == 0){
-                if(!pos.square_is_attacked_bySide(SQ64_E1, BLACK) && !pos.square_is_attacked_bySide(SQ64_D1, BLACK)){
+                if(!pos.checkers() && !pos.square_is_attacked_bySide(SQ64_D1, BLACK)){
                     moveList.set_move(make_quiet_move(SQ64_E1, SQ64_C1, SpecialMove::CASTLE));
                 }
             }
@@ -251,14 +467,14 @@ void castling_moves(const Position &pos, MoveList &moveList){
     else if constexpr(C == BLACK){
         if(castlingRights & CastlingRight::BKCA){
             if((pos.get_occupied_bitboard(COLOR_NC) & 0x6000000000000000) == 0){
-                if(!pos.square_is_attacked_bySide(SQ64_E8, WHITE) && !pos.square_is_attacked_bySide(SQ64_F8, WHITE)){
+                if(!pos.checkers() && !pos.square_is_attacked_bySide(SQ64_F8, WHITE)){
                     moveList.set_move(make_quiet_move(SQ64_E8, SQ64_G8, SpecialMove::CASTLE));
                 }
             }
         }
         if(castlingRights & CastlingRight::BQCA){
             if((pos.get_occupied_bitboard(COLOR_NC) & 0x0E00000000000000) == 0){
-                if(!pos.square_is_attacked_bySide(SQ64_E8, WHITE) && !pos.square_is_attacked_bySide(SQ64_D8, WHITE)){
+                if(!pos.checkers() && !pos.square_is_attacked_bySide(SQ64_D8, WHITE)){
                     moveList.set_move(make_quiet_move(SQ64_E8, SQ64_C8, SpecialMove::CASTLE));
                 }
             }
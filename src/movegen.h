@@ -22,7 +22,13 @@ struct MoveList{
 
 
 void generate_pseudo_moves(const Position &pos, MoveList &moveList);
-void generate_pseudo_captures(Position &pos, MoveList &moveList);
+void generate_pseudo_captures(const Position &pos, MoveList &moveList);
+// Everything generate_pseudo_captures() leaves out, quiet promotions included
+void generate_pseudo_quiets(const Position &pos, MoveList &moveList);
+
+// Only legal moves: checkers, pinned pieces and the squares the enemy
+// attacks are worked out once, and in check only evasions are generated
+void generate_legal(const Position &pos, MoveList &moveList);
 
 
 } // namespace Akerbeltz
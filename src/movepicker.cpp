@@ -0,0 +1,152 @@
+#include "movepicker.h"
+#include "position.h"
+
+namespace Akerbeltz{
+
+MovePicker::MovePicker(const Position &position, Move ttMove, Move killer0, Move killer1,
+                       const MoveScore (&history)[PIECE_SIZE][SQ64_SIZE])
+    : position(position), history(history), ttMove(NOMOVE), killers{NOMOVE, NOMOVE}{
+
+    // TT and killer moves may come from other positions
+    if(position.is_pseudo_legal(ttMove)){
+        this->ttMove = full_move(ttMove);
+    }
+
+    int count = 0;
+    for(Move killer : {killer0, killer1}){
+        // Killers are quiet here too, or the capture stages try them
+        if(killer == NOMOVE || equal_move(killer, this->ttMove) || (count && equal_move(killer, killers[0]))
+           || move_special(killer) == ENPASSANT || position.get_mailbox_piece(move_to(killer)) != NO_PIECE
+           || !position.is_pseudo_legal(killer)){
+            continue;
+        }
+        killers[count++] = raw_move(killer);
+    }
+}
+
+Move MovePicker::next_move(){
+
+    switch(stage){
+
+    case STAGE_TT_MOVE:
+        ++stage;
+        if(ttMove != NOMOVE){
+            return ttMove;
+        }
+        [[fallthrough]];
+
+    case STAGE_GENERATE_CAPTURES:
+        MoveGen::generate_pseudo_captures(position, moveList);
+        for(int i = 0; i < moveList.size; ++i){
+            const Move move = moveList.moves[i];
+            const MoveScore score = move_special(move) == ENPASSANT
+                                  ? MVVLVAScores[PAWN][PAWN]
+                                  : MVVLVAScores[piece_type(attacker_piece(move))][piece_type(captured_piece(move))];
+            moveList.moves[i] = set_heuristic_score(move, score);
+        }
+        current = 0;
+        end = moveList.size;
+        ++stage;
+        [[fallthrough]];
+
+    case STAGE_GOOD_CAPTURES:
+        while(current < end){
+            const Move move = pick_best();
+            if(equal_move(move, ttMove)){
+                continue;
+            }
+            if(!position.see(move, 0)){
+                moveList.moves[badEnd++] = move;
+                continue;
+            }
+            return move;
+        }
+        ++stage;
+        [[fallthrough]];
+
+    case STAGE_KILLERS:
+        while(killerIndex < MAX_KILLERMOVES){
+            const Move killer = killers[killerIndex++];
+            if(killer != NOMOVE){
+                return killer;
+            }
+        }
+        ++stage;
+        [[fallthrough]];
+
+    case STAGE_GENERATE_QUIETS:
+        current = moveList.size;
+        MoveGen::generate_pseudo_quiets(position, moveList);
+        for(int i = current; i < moveList.size; ++i){
+            const Move move = moveList.moves[i];
+            moveList.moves[i] = set_heuristic_score(move, history[position.get_mailbox_piece(move_from(move))][move_to(move)]);
+        }
+        end = moveList.size;
+        ++stage;
+        [[fallthrough]];
+
+    case STAGE_QUIETS:
+        while(current < end){
+            const Move move = pick_best();
+            if(!equal_move(move, ttMove) && !is_killer(move)){
+                return move;
+            }
+        }
+        current = 0;
+        ++stage;
+        [[fallthrough]];
+
+    // Parked in MVV-LVA order already
+    case STAGE_BAD_CAPTURES:
+        if(current < badEnd){
+            return moveList.moves[current++];
+        }
+        ++stage;
+        [[fallthrough]];
+
+    default:
+        return NOMOVE;
+    }
+}
+
+// Attacker and captured fields from the board, as the generator sets them
+Move MovePicker::full_move(Move move) const{
+    const Square64 from = move_from(move);
+    const Square64 to   = move_to(move);
+    const SpecialMove special = move_special(move);
+
+    if(special == ENPASSANT){
+        return make_enpassant_move(from, to);
+    }
+    if(position.get_mailbox_piece(to) != NO_PIECE){
+        return make_capture_move(from, to, special, position.get_mailbox_piece(from), position.get_mailbox_piece(to));
+    }
+    return make_quiet_move(from, to, special);
+}
+
+bool MovePicker::is_killer(Move move) const{
+    return (killers[0] != NOMOVE && equal_move(move, killers[0]))
+        || (killers[1] != NOMOVE && equal_move(move, killers[1]));
+}
+
+// Selection step over [current, end): the best move is swapped to current
+Move MovePicker::pick_best(){
+
+    int bestIndx = current;
+    MoveScore bestScr = move_score(moveList.moves[current]);
+    for(int i = current + 1; i < end; ++i){
+        const MoveScore moveScr = move_score(moveList.moves[i]);
+        if(moveScr > bestScr){
+            bestScr = moveScr;
+            bestIndx = i;
+        }
+    }
+
+    const Move best = moveList.moves[bestIndx];
+    moveList.moves[bestIndx] = moveList.moves[current];
+    moveList.moves[current] = best;
+    ++current;
+    return best;
+}
+
+} // namespace Akerbeltz
@@ -0,0 +1,59 @@
+#ifndef INCLUDE_MOVEPICKER_H
+#define INCLUDE_MOVEPICKER_H
+
+#include "movegen.h"
+#include "move.h"
+#include "types.h"
+
+namespace Akerbeltz{
+
+class Position;
+
+/*Staged move ordering for alpha_beta: the TT move before anything is
+generated, then captures that do not lose material by MVV-LVA, the killers,
+quiets by history and last the captures that lose material (by SEE). A stage is
+generated only when the previous ones did not cut, and each move is picked
+from its stage when asked for.
+*/
+class MovePicker{
+
+public:
+
+    MovePicker(const Position &position, Move ttMove, Move killer0, Move killer1,
+               const MoveScore (&history)[PIECE_SIZE][SQ64_SIZE]);
+
+    // Pseudo-legal moves, each once; NOMOVE when all stages are done
+    Move next_move();
+
+private:
+
+    enum Stage : int{
+        STAGE_TT_MOVE,
+        STAGE_GENERATE_CAPTURES,
+        STAGE_GOOD_CAPTURES,
+        STAGE_KILLERS,
+        STAGE_GENERATE_QUIETS,
+        STAGE_QUIETS,
+        STAGE_BAD_CAPTURES,
+        STAGE_DONE
+    };
+
+    Move full_move(Move move) const;
+    bool is_killer(Move move) const;
+    Move pick_best();
+
+    const Position &position;
+    const MoveScore (&history)[PIECE_SIZE][SQ64_SIZE];
+    Move ttMove;
+    Move killers[MAX_KILLERMOVES];
+    MoveGen::MoveList moveList;
+    int stage{STAGE_TT_MOVE};
+    int current{0};
+    int end{0};
+    int badEnd{0};     // Losing captures are parked in [0, badEnd)
+    int killerIndex{0};
+};
+
+} // namespace Akerbeltz
+
+#endif // #ifndef INCLUDE_MOVEPICKER_H
@@ -0,0 +1,226 @@
+#include "nnue.h"
+#include "nnue_kernels.h"
+#include "bitboards.h"
+#include "position.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+namespace Akerbeltz {
+
+namespace NNUE {
+
+    struct Network {
+        alignas(64) int16_t ftBias[HIDDEN];
+        alignas(64) int16_t ftWeights[INPUTS][HIDDEN];
+        int32_t psqtWeights[INPUTS][PSQT_BUCKETS];
+        int32_t outBias;
+        alignas(64) int8_t outWeights[2 * HIDDEN];
+    };
+
+    /*Network file: this header followed by ftBias, ftWeights, psqtWeights,
+    outBias and outWeights, little-endian, without padding. Bump
+    FILE_VERSION whenever the layout changes.
+    */
+    struct FileHeader {
+        char     magic[8];
+        uint32_t version;
+        uint32_t inputs;
+        uint32_t hidden;
+        uint32_t psqtBuckets;
+    };
+
+    constexpr char     FILE_MAGIC[8] = {'A', 'K', 'B', 'Z', 'N', 'N', 'U', 'E'};
+    constexpr uint32_t FILE_VERSION  = 1;
+
+    Network network;
+    std::string networkName = DEFAULT_NET_NAME;
+    bool useNnue = false;
+    Key networkSalt = 0xD6E8FEB86659FD93ULL;
+
+    static void build_default(Network &net);
+
+    // Feature of a piece seen from one side: own pieces first, the board
+    // flipped vertically for black
+    inline int feature(Color perspective, Piece piece, Square64 square) {
+        const int relSquare = perspective == WHITE ? square : square ^ 56;
+        const int side = piece_color(piece) == perspective ? 0 : 1;
+        return (side * 6 + piece_type(piece) - 1) * SQ64_SIZE + relSquare;
+    }
+
+    inline int psqt_bucket(const Position &position) {
+        return (Bitboards::cpop(position.get_occupied_bitboard(COLOR_NC)) - 1) / 4;
+    }
+
+    inline void add_feature(Accumulator &accumulator, Color perspective, int f) {
+        kernels.add(accumulator.values[perspective], network.ftWeights[f]);
+        for (int b = 0; b < PSQT_BUCKETS; ++b)
+            accumulator.psqt[perspective][b] += network.psqtWeights[f][b];
+    }
+
+    inline void sub_feature(Accumulator &accumulator, Color perspective, int f) {
+        kernels.sub(accumulator.values[perspective], network.ftWeights[f]);
+        for (int b = 0; b < PSQT_BUCKETS; ++b)
+            accumulator.psqt[perspective][b] -= network.psqtWeights[f][b];
+    }
+
+    void init() {
+        build_default(network);
+        networkName = DEFAULT_NET_NAME;
+    }
+
+    bool enabled() { return useNnue; }
+
+    void set_enabled(bool enable) { useNnue = enable; }
+
+    const std::string& network_name() { return networkName; }
+
+    Key cache_salt() { return useNnue ? networkSalt : 0; }
+
+    bool load(const std::string &path) {
+
+        auto loaded = std::make_unique<Network>();
+
+        if (path.empty() || path == DEFAULT_NET_NAME) {
+            build_default(*loaded);
+        } else {
+            std::ifstream file(path, std::ios::binary);
+            FileHeader header{};
+            if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+                return false;
+
+            if (std::memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) != 0
+             || header.version != FILE_VERSION
+             || header.inputs != INPUTS
+             || header.hidden != HIDDEN
+             || header.psqtBuckets != PSQT_BUCKETS)
+                return false;
+
+            if (!file.read(reinterpret_cast<char*>(loaded->ftBias), sizeof(loaded->ftBias))
+             || !file.read(reinterpret_cast<char*>(loaded->ftWeights), sizeof(loaded->ftWeights))
+             || !file.read(reinterpret_cast<char*>(loaded->psqtWeights), sizeof(loaded->psqtWeights))
+             || !file.read(reinterpret_cast<char*>(&loaded->outBias), sizeof(loaded->outBias))
+             || !file.read(reinterpret_cast<char*>(loaded->outWeights), sizeof(loaded->outWeights)))
+                return false;
+
+            // Trailing bytes mean a different layout
+            if (file.peek() != std::ifstream::traits_type::eof())
+                return false;
+        }
+
+        network = *loaded;
+        networkSalt = (networkSalt + 1) * 0x9E3779B97F4A7C15ULL;
+        networkName = path.empty() ? DEFAULT_NET_NAME : path;
+        return true;
+    }
+
+    bool save(const std::string &path) {
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+
+        FileHeader header{};
+        std::memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+        header.version     = FILE_VERSION;
+        header.inputs      = INPUTS;
+        header.hidden      = HIDDEN;
+        header.psqtBuckets = PSQT_BUCKETS;
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(network.ftBias), sizeof(network.ftBias));
+        file.write(reinterpret_cast<const char*>(network.ftWeights), sizeof(network.ftWeights));
+        file.write(reinterpret_cast<const char*>(network.psqtWeights), sizeof(network.psqtWeights));
+        file.write(reinterpret_cast<const char*>(&network.outBias), sizeof(network.outBias));
+        file.write(reinterpret_cast<const char*>(network.outWeights), sizeof(network.outWeights));
+        return bool(file);
+    }
+
+    void refresh(const Position &position, Accumulator &accumulator) {
+
+        for (Color c : {WHITE, BLACK}) {
+            std::copy(std::begin(network.ftBias), std::end(network.ftBias), accumulator.values[c]);
+            std::fill(std::begin(accumulator.psqt[c]), std::end(accumulator.psqt[c]), 0);
+        }
+
+        for (int s = 0; s < SQ64_SIZE; ++s) {
+            const Piece piece = position.get_mailbox_piece(Square64(s));
+            if (piece != NO_PIECE)
+                add_piece(accumulator, piece, Square64(s));
+        }
+    }
+
+    void add_piece(Accumulator &accumulator, Piece piece, Square64 square) {
+        add_feature(accumulator, WHITE, feature(WHITE, piece, square));
+        add_feature(accumulator, BLACK, feature(BLACK, piece, square));
+    }
+
+    void remove_piece(Accumulator &accumulator, Piece piece, Square64 square) {
+        sub_feature(accumulator, WHITE, feature(WHITE, piece, square));
+        sub_feature(accumulator, BLACK, feature(BLACK, piece, square));
+    }
+
+    void move_piece(Accumulator &accumulator, Piece piece, Square64 from, Square64 to) {
+        for (Color c : {WHITE, BLACK}) {
+            const int fromFeature = feature(c, piece, from);
+            const int toFeature   = feature(c, piece, to);
+            kernels.add_sub(accumulator.values[c], network.ftWeights[toFeature], network.ftWeights[fromFeature]);
+
+            const int32_t* fromPsqt = network.psqtWeights[fromFeature];
+            const int32_t* toPsqt   = network.psqtWeights[toFeature];
+            for (int b = 0; b < PSQT_BUCKETS; ++b)
+                accumulator.psqt[c][b] += toPsqt[b] - fromPsqt[b];
+        }
+    }
+
+    Evaluate::Score evaluate(const Position &position) {
+
+        const Accumulator &accumulator = position.accumulator();
+        const Color us = position.get_side_to_move();
+        const Color them = ~us;
+        const int bucket = psqt_bucket(position);
+
+        const int32_t psqt = (accumulator.psqt[us][bucket] - accumulator.psqt[them][bucket]) / 2;
+
+        const int64_t output = int64_t(network.outBias)
+                             + kernels.crelu_dot(accumulator.values[us], network.outWeights)
+                             + kernels.crelu_dot(accumulator.values[them], network.outWeights + HIDDEN);
+
+        return Evaluate::Score(psqt + output * EVAL_SCALE / (QA * QB));
+    }
+
+    /*No trained network ships with the engine. The default one reproduces
+    the classical material + PST terms through the PSQT output: each
+    bucket holds the tapered table value at the game phase its piece count
+    suggests, positive for own pieces and negative for enemy ones. The
+    hidden layer is left at zero, so a trained net only has to replace
+    this file's weights.
+    */
+    static void build_default(Network &net) {
+
+        std::memset(&net, 0, sizeof(net));
+
+        for (int b = 0; b < PSQT_BUCKETS; ++b) {
+            // Bucket b holds 4b+1 .. 4b+4 pieces; two are kings
+            const int pieces = 4 * b + 3;
+            const Evaluate::GamePhaseWeight phase =
+                std::min(Evaluate::MAX_PHASE_PIECE_WEIGHT, (pieces - 2) * Evaluate::MAX_PHASE_PIECE_WEIGHT / 30);
+
+            for (int pt = PAWN; pt <= KING; ++pt) {
+                const Piece whitePiece = make_piece(WHITE, PieceType(pt));
+                for (int s = 0; s < SQ64_SIZE; ++s) {
+                    // Own piece on relative square s; an enemy piece on s
+                    // stands on s ^ 56 from its own side
+                    const int ownFeature   = (pt - 1) * SQ64_SIZE + s;
+                    const int enemyFeature = (6 + pt - 1) * SQ64_SIZE + s;
+                    net.psqtWeights[ownFeature][b]   =  Evaluate::taper(Evaluate::PSQT[whitePiece][s], phase);
+                    net.psqtWeights[enemyFeature][b] = -Evaluate::taper(Evaluate::PSQT[whitePiece][s ^ 56], phase);
+                }
+            }
+        }
+    }
+
+} // namespace NNUE
+
+} // namespace Akerbeltz
@@ -0,0 +1,74 @@
+#ifndef INCLUDE_NNUE_H
+#define INCLUDE_NNUE_H
+
+#include "types.h"
+#include "evaluate.h"
+
+#include <cstdint>
+#include <string>
+
+namespace Akerbeltz{
+
+class Position;
+
+namespace NNUE{
+
+    /*Network: 768 -> 2x128 -> 1
+    Inputs are (own/enemy, piece type, square) seen from each side, with
+    the board flipped for black. Each side's 128 int16 accumulator values
+    go through a clipped ReLU (0..127) into an int8 output layer, taking
+    the side to move first. A second, linear output per feature
+    (PSQT_BUCKETS of them, chosen by piece count) skips the hidden layer
+    and carries material and placement.
+    */
+    constexpr int INPUTS       = 2 * 6 * SQ64_SIZE;
+    constexpr int HIDDEN       = 128;
+    constexpr int PSQT_BUCKETS = 8;
+
+    // Activation clip, output weight scale and the output scale to Score
+    constexpr int QA         = 127;
+    constexpr int QB         = 64;
+    constexpr int EVAL_SCALE = 400;
+
+    // EvalFile value naming the default network
+    constexpr const char* DEFAULT_NET_NAME = "<internal>";
+
+    // One half per perspective, indexed by WHITE / BLACK
+    struct alignas(64) Accumulator{
+        int16_t values[2][HIDDEN];
+        int32_t psqt[2][PSQT_BUCKETS];
+    };
+
+    // Builds the default network (see nnue.cpp)
+    void init();
+
+    // Incremental updates are only kept while the network is in use
+    bool enabled();
+    void set_enabled(bool enable);
+
+    // Loads a network file, or the default network for DEFAULT_NET_NAME.
+    // On failure the network in use is kept.
+    bool load(const std::string &path);
+
+    // Writes the network in use in the EvalFile format
+    bool save(const std::string &path);
+
+    // Mixed into eval cache keys: zero while disabled, new for each load
+    Key cache_salt();
+
+    // Name of the network in use (DEFAULT_NET_NAME for the default one)
+    const std::string& network_name();
+
+    void refresh(const Position &position, Accumulator &accumulator);
+
+    void add_piece(Accumulator &accumulator, Piece piece, Square64 square);
+    void remove_piece(Accumulator &accumulator, Piece piece, Square64 square);
+    void move_piece(Accumulator &accumulator, Piece piece, Square64 from, Square64 to);
+
+    Evaluate::Score evaluate(const Position &position);
+
+} // namespace NNUE
+
+} // namespace Akerbeltz
+
+#endif // #ifndef INCLUDE_NNUE_H
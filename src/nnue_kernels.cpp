@@ -0,0 +1,227 @@
+#include "nnue_kernels.h"
+#include "nnue.h"
+
+#include <algorithm>
+
+#if (defined(__clang__) || defined(__GNUC__)) && (defined(__x86_64__) || defined(__i386__))
+    #define NNUE_X86_KERNELS
+    #include <immintrin.h>
+#endif
+
+namespace Akerbeltz {
+
+namespace NNUE {
+
+    // ---------- Scalar (reference) ----------
+    static void add_scalar(int16_t* accumulator, const int16_t* row) {
+        for (int i = 0; i < HIDDEN; ++i)
+            accumulator[i] += row[i];
+    }
+
+    static void sub_scalar(int16_t* accumulator, const int16_t* row) {
+        for (int i = 0; i < HIDDEN; ++i)
+            accumulator[i] -= row[i];
+    }
+
+    static void add_sub_scalar(int16_t* accumulator, const int16_t* addRow, const int16_t* subRow) {
+        for (int i = 0; i < HIDDEN; ++i)
+            accumulator[i] += addRow[i] - subRow[i];
+    }
+
+    static int32_t crelu_dot_scalar(const int16_t* values, const int8_t* weights) {
+        int32_t sum = 0;
+        for (int i = 0; i < HIDDEN; ++i)
+            sum += std::clamp<int>(values[i], 0, QA) * weights[i];
+        return sum;
+    }
+
+#ifdef NNUE_X86_KERNELS
+
+    // ---------- SSE4.1: 8 values per step ----------
+    __attribute__((target("sse4.1")))
+    static void add_sse41(int16_t* accumulator, const int16_t* row) {
+        for (int i = 0; i < HIDDEN; i += 8) {
+            __m128i* a = reinterpret_cast<__m128i*>(accumulator + i);
+            const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+            _mm_storeu_si128(a, _mm_add_epi16(_mm_loadu_si128(a), w));
+        }
+    }
+
+    __attribute__((target("sse4.1")))
+    static void sub_sse41(int16_t* accumulator, const int16_t* row) {
+        for (int i = 0; i < HIDDEN; i += 8) {
+            __m128i* a = reinterpret_cast<__m128i*>(accumulator + i);
+            const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+            _mm_storeu_si128(a, _mm_sub_epi16(_mm_loadu_si128(a), w));
+        }
+    }
+
+    __attribute__((target("sse4.1")))
+    static void add_sub_sse41(int16_t* accumulator, const int16_t* addRow, const int16_t* subRow) {
+        for (int i = 0; i < HIDDEN; i += 8) {
+            __m128i* a = reinterpret_cast<__m128i*>(accumulator + i);
+            const __m128i add = _mm_loadu_si128(reinterpret_cast<const __m128i*>(addRow + i));
+            const __m128i sub = _mm_loadu_si128(reinterpret_cast<const __m128i*>(subRow + i));
+            _mm_storeu_si128(a, _mm_sub_epi16(_mm_add_epi16(_mm_loadu_si128(a), add), sub));
+        }
+    }
+
+    __attribute__((target("sse4.1")))
+    static int32_t hsum_sse41(__m128i sum) {
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+        return _mm_cvtsi128_si32(sum);
+    }
+
+    __attribute__((target("sse4.1")))
+    static int32_t crelu_dot_sse41(const int16_t* values, const int8_t* weights) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i clip = _mm_set1_epi16(QA);
+        __m128i sum = _mm_setzero_si128();
+        for (int i = 0; i < HIDDEN; i += 8) {
+            const __m128i v = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)), zero), clip);
+            const __m128i w = _mm_cvtepi8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(weights + i)));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(v, w));
+        }
+        return hsum_sse41(sum);
+    }
+
+    // ---------- AVX2: 16 values per step ----------
+    __attribute__((target("avx2")))
+    static void add_avx2(int16_t* accumulator, const int16_t* row) {
+        for (int i = 0; i < HIDDEN; i += 16) {
+            __m256i* a = reinterpret_cast<__m256i*>(accumulator + i);
+            const __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+            _mm256_storeu_si256(a, _mm256_add_epi16(_mm256_loadu_si256(a), w));
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static void sub_avx2(int16_t* accumulator, const int16_t* row) {
+        for (int i = 0; i < HIDDEN; i += 16) {
+            __m256i* a = reinterpret_cast<__m256i*>(accumulator + i);
+            const __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+            _mm256_storeu_si256(a, _mm256_sub_epi16(_mm256_loadu_si256(a), w));
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static void add_sub_avx2(int16_t* accumulator, const int16_t* addRow, const int16_t* subRow) {
+        for (int i = 0; i < HIDDEN; i += 16) {
+            __m256i* a = reinterpret_cast<__m256i*>(accumulator + i);
+            const __m256i add = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(addRow + i));
+            const __m256i sub = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(subRow + i));
+            _mm256_storeu_si256(a, _mm256_sub_epi16(_mm256_add_epi16(_mm256_loadu_si256(a), add), sub));
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static int32_t crelu_dot_avx2(const int16_t* values, const int8_t* weights) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i clip = _mm256_set1_epi16(QA);
+        __m256i sum = _mm256_setzero_si256();
+        for (int i = 0; i < HIDDEN; i += 16) {
+            const __m256i v = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)), zero), clip);
+            const __m256i w = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i)));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, w));
+        }
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+        return _mm_cvtsi128_si32(half);
+    }
+
+    // ---------- AVX-512 (BW): 32 values per step ----------
+    __attribute__((target("avx512f,avx512bw")))
+    static void add_avx512(int16_t* accumulator, const int16_t* row) {
+        for (int i = 0; i < HIDDEN; i += 32) {
+            const __m512i a = _mm512_loadu_si512(accumulator + i);
+            _mm512_storeu_si512(accumulator + i, _mm512_add_epi16(a, _mm512_loadu_si512(row + i)));
+        }
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    static void sub_avx512(int16_t* accumulator, const int16_t* row) {
+        for (int i = 0; i < HIDDEN; i += 32) {
+            const __m512i a = _mm512_loadu_si512(accumulator + i);
+            _mm512_storeu_si512(accumulator + i, _mm512_sub_epi16(a, _mm512_loadu_si512(row + i)));
+        }
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    static void add_sub_avx512(int16_t* accumulator, const int16_t* addRow, const int16_t* subRow) {
+        for (int i = 0; i < HIDDEN; i += 32) {
+            const __m512i a = _mm512_add_epi16(_mm512_loadu_si512(accumulator + i), _mm512_loadu_si512(addRow + i));
+            _mm512_storeu_si512(accumulator + i, _mm512_sub_epi16(a, _mm512_loadu_si512(subRow + i)));
+        }
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    static int32_t crelu_dot_avx512(const int16_t* values, const int8_t* weights) {
+        const __m512i zero = _mm512_setzero_si512();
+        const __m512i clip = _mm512_set1_epi16(QA);
+        __m512i sum = _mm512_setzero_si512();
+        for (int i = 0; i < HIDDEN; i += 32) {
+            const __m512i v = _mm512_min_epi16(_mm512_max_epi16(_mm512_loadu_si512(values + i), zero), clip);
+            const __m512i w = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i)));
+            sum = _mm512_add_epi32(sum, _mm512_madd_epi16(v, w));
+        }
+        return _mm512_reduce_add_epi32(sum);
+    }
+
+    static_assert(HIDDEN % 32 == 0, "SIMD kernels step over HIDDEN in blocks of up to 32");
+
+#endif
+
+    static const Kernels KERNELS[SIMD_LEVEL_SIZE] = {
+        {add_scalar, sub_scalar, add_sub_scalar, crelu_dot_scalar},
+#ifdef NNUE_X86_KERNELS
+        {add_sse41,  sub_sse41,  add_sub_sse41,  crelu_dot_sse41},
+        {add_avx2,   sub_avx2,   add_sub_avx2,   crelu_dot_avx2},
+        {add_avx512, sub_avx512, add_sub_avx512, crelu_dot_avx512},
+#else
+        {add_scalar, sub_scalar, add_sub_scalar, crelu_dot_scalar},
+        {add_scalar, sub_scalar, add_sub_scalar, crelu_dot_scalar},
+        {add_scalar, sub_scalar, add_sub_scalar, crelu_dot_scalar},
+#endif
+    };
+
+    static SimdLevel detect_simd() {
+#ifdef NNUE_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512bw")) return SIMD_AVX512;
+        if (__builtin_cpu_supports("avx2"))     return SIMD_AVX2;
+        if (__builtin_cpu_supports("sse4.1"))   return SIMD_SSE41;
+#endif
+        return SIMD_SCALAR;
+    }
+
+    const SimdLevel detectedLevel = detect_simd();
+    SimdLevel activeLevel = detectedLevel;
+    Kernels kernels = KERNELS[detectedLevel];
+
+    SimdLevel detected_simd() { return detectedLevel; }
+
+    const Kernels& kernels_for(SimdLevel level) {
+        return KERNELS[level <= detectedLevel ? level : SIMD_SCALAR];
+    }
+
+    void set_simd(SimdLevel level) {
+        activeLevel = std::min(level, detectedLevel);
+        kernels = KERNELS[activeLevel];
+    }
+
+    SimdLevel simd() { return activeLevel; }
+
+    const char* simd_name(SimdLevel level) {
+        switch (level) {
+            case SIMD_SSE41:  return "sse4.1";
+            case SIMD_AVX2:   return "avx2";
+            case SIMD_AVX512: return "avx512";
+            default:          return "scalar";
+        }
+    }
+
+} // namespace NNUE
+
+} // namespace Akerbeltz
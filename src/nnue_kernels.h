@@ -0,0 +1,55 @@
+#ifndef INCLUDE_NNUE_KERNELS_H
+#define INCLUDE_NNUE_KERNELS_H
+
+#include <cstdint>
+
+namespace Akerbeltz{
+
+namespace NNUE{
+
+    /*Inner loops of the network, one set per instruction set. All of them
+    work on exactly HIDDEN values and give bit-identical results: int16
+    sums wrap the same way in every set, and the clipped dot product is
+    exact in int32. The sets are compiled with per-function target
+    attributes and picked at startup from CPUID, so a generic build still
+    runs the widest one the CPU has.
+    */
+    enum SimdLevel : int{
+        SIMD_SCALAR,
+        SIMD_SSE41,
+        SIMD_AVX2,
+        SIMD_AVX512,
+        SIMD_LEVEL_SIZE
+    };
+
+    struct Kernels{
+        // accumulator += row
+        void (*add)(int16_t* accumulator, const int16_t* row);
+        // accumulator -= row
+        void (*sub)(int16_t* accumulator, const int16_t* row);
+        // accumulator += addRow - subRow
+        void (*add_sub)(int16_t* accumulator, const int16_t* addRow, const int16_t* subRow);
+        // sum of clamp(values, 0, QA) * weights
+        int32_t (*crelu_dot)(const int16_t* values, const int8_t* weights);
+    };
+
+    // Kernels in use, set by set_simd (the detected level by default)
+    extern Kernels kernels;
+
+    // Widest level supported by this build and CPU
+    SimdLevel detected_simd();
+
+    // Kernels of one level; levels above detected_simd() give the scalar ones
+    const Kernels& kernels_for(SimdLevel level);
+
+    // Selects a level, clamped to detected_simd()
+    void set_simd(SimdLevel level);
+    SimdLevel simd();
+
+    const char* simd_name(SimdLevel level);
+
+} // namespace NNUE
+
+} // namespace Akerbeltz
+
+#endif // #ifndef INCLUDE_NNUE_KERNELS_H
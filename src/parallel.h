@@ -0,0 +1,104 @@
+#ifndef INCLUDE_PARALLEL_H
+#define INCLUDE_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Akerbeltz{
+
+namespace Parallel{
+
+    // 0 threads means one per core
+    inline std::size_t resolve_threads(std::size_t threads) {
+        return threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Runs fn(begin, end) over [0, size) split into one slice per thread,
+    // and sums what the slices return
+    template<typename Fn>
+    std::size_t for_each_slice(std::size_t size, std::size_t threads, Fn fn) {
+
+        std::atomic<std::size_t> total{0};
+        std::vector<std::thread> workers;
+        const std::size_t slice = (size + threads - 1) / threads;
+
+        for (std::size_t t = 0; t < threads; ++t) {
+            const std::size_t begin = std::min(size, t * slice);
+            const std::size_t end   = std::min(size, begin + slice);
+            workers.emplace_back([&, begin, end] { total += fn(begin, end); });
+        }
+        for (std::thread &worker : workers)
+            worker.join();
+
+        return total;
+    }
+
+    // A thread kept alive between jobs, sleeping on a condition variable, so
+    // its thread_local state (the eval caches) carries over from one job to
+    // the next
+    class Worker {
+    public:
+        Worker() : thread([this] { idle_loop(); }) {}
+        Worker(const Worker&) = delete;
+        Worker& operator=(const Worker&) = delete;
+
+        ~Worker() {
+            wait();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                exiting = true;
+            }
+            cv.notify_all();
+            thread.join();
+        }
+
+        // Waits for the previous job, then starts this one and returns
+        void run(std::function<void()> fn) {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return !busy; });
+            job = std::move(fn);
+            busy = true;
+            lock.unlock();
+            cv.notify_all();
+        }
+
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return !busy; });
+        }
+
+    private:
+        void idle_loop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                cv.wait(lock, [this] { return busy || exiting; });
+                if (!busy)
+                    return;
+                lock.unlock();
+                job();
+                lock.lock();
+                job = nullptr;
+                busy = false;
+                cv.notify_all();
+            }
+        }
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::function<void()> job;
+        bool busy{false};
+        bool exiting{false};
+        std::thread thread;    // Last, so it starts once the rest is built
+    };
+
+} // namespace Parallel
+
+} // namespace Akerbeltz
+
+#endif // #ifndef INCLUDE_PARALLEL_H
@@ -1,5 +1,6 @@
 #include "position.h"
 #include "attacks.h"
+#include "ttable.h"
 
 #include <random>
 
@@ -13,6 +14,9 @@ namespace Zobrist{
     Key enpassantSquare[FILE_SIZE];
     Key castlingRight[CASTLING_POSIBILITIES];
     Key blackMoves;
+    // One key per piece and count: the n-th piece of a kind toggles
+    // materialCount[piece][n], so the material key depends on counts only
+    Key materialCount[PIECE_SIZE][MAX_SAME_PIECE + 1];
 
 }
 
@@ -56,6 +60,14 @@ void Position::init(){
     zobris_prng();
 }
 
+Key Position::material_key(const Piece *pieces, int count){
+    int counts[PIECE_SIZE] = {};
+    Key key = 0;
+    for (int i = 0; i < count; ++i)
+        key ^= Zobrist::materialCount[pieces[i]][++counts[pieces[i]]];
+    return key;
+}
+
 void Position::clear_position(){
     clear_position_info();
     clear_pieceTypes_bitboards();
@@ -75,7 +87,12 @@ void Position::clear_position_info(){
     moveHistory[ply-1].fullMoves = 1;
     moveHistory[ply-1].enpassantSquare = SQ64_NO_SQUARE;
     moveHistory[ply-1].positionKey = 0;
+    moveHistory[ply-1].pawnKey = 0;
+    moveHistory[ply-1].materialKey = 0;
     moveHistory[ply-1].phaseWeight = 0;
+    moveHistory[ply-1].psqt = 0;
+    moveHistory[ply-1].checkers = 0;
+    moveHistory[ply-1].pinned = 0;
 
 }
 
@@ -106,9 +123,9 @@ void Position::clear_mailbox(){
 void Position::zobris_prng(){
 
    	std::mt19937_64 e2(Zobrist::ZOBRIST_SEED);
-    std::uniform_int_distribution<Key> dist(
-    		std::llround(std::pow(2,61)),
-    		std::llround(std::pow(2,62)));
+    // Keys span the full 64 bits: the TT bucket index is taken from the
+    // high bits of the position key
+    std::uniform_int_distribution<Key> dist;
 
     // Initializes a random key for each piece on each square
 	for (int piece_type = 0; piece_type < PIECE_SIZE; piece_type++) {
@@ -126,6 +143,11 @@ void Position::zobris_prng(){
 	}
 
 	Zobrist::blackMoves = dist(e2);
+
+	for (int piece = 0; piece < PIECE_SIZE; piece++) {
+		for (int count = 0; count <= MAX_SAME_PIECE; count++)
+			Zobrist::materialCount[piece][count] = dist(e2);
+	}
 }
 
 void Position::set_FEN(std::string fenNotation){
@@ -195,6 +217,9 @@ void Position::set_FEN(std::string fenNotation){
     iss >>  moveHistory[ply-1].fullMoves;
 
     calc_key();
+    set_check_info();
+    if(NNUE::enabled())
+        refresh_accumulator();
 
 }
 
@@ -279,6 +304,116 @@ bool Position::is_repetition() const {
     return false;
 }
 
+// Checkers and pinned pieces of the side to move, computed once per position
+void Position::set_check_info(){
+
+    HistoryInfo &info = moveHistory[ply-1];
+    info.checkers = 0;
+    info.pinned = 0;
+
+    const Bitboard kingBitboard = pieceTypesBitboards[sideToMove][KING];
+    if(!kingBitboard){
+        return;
+    }
+
+    const Square64 kingsq64{Bitboards::ctz(kingBitboard)};
+    const Color them = ~sideToMove;
+    info.checkers = attackers_to(kingsq64, occupiedBitboards[COLOR_NC]) & occupiedBitboards[them];
+
+    // Enemy sliders on an empty line to the king pin a lone own blocker
+    const Bitboard queens = pieceTypesBitboards[them][QUEEN];
+    Bitboard snipers = (Attacks::sliding_side_attacks(kingsq64, ZERO) & (pieceTypesBitboards[them][ROOK] | queens))
+                     | (Attacks::sliding_diagonal_attacks(kingsq64, ZERO) & (pieceTypesBitboards[them][BISHOP] | queens));
+    while(snipers){
+        const Bitboard blockers = Attacks::betweenSquares[kingsq64][Bitboards::ctz(snipers)] & occupiedBitboards[COLOR_NC];
+        if(blockers && !(blockers & (blockers - 1))){
+            info.pinned |= blockers & occupiedBitboards[sideToMove];
+        }
+        snipers &= snipers - 1;
+    }
+}
+
+Bitboard Position::attackers_to(Square64 sq64, Bitboard occupied) const{
+
+    const Bitboard queens = pieceTypesBitboards[WHITE][QUEEN] | pieceTypesBitboards[BLACK][QUEEN];
+
+    return   (Attacks::pawnAttacks[BLACK][sq64] & pieceTypesBitboards[WHITE][PAWN])
+           | (Attacks::pawnAttacks[WHITE][sq64] & pieceTypesBitboards[BLACK][PAWN])
+           | (Attacks::knightAttacks[sq64] & (pieceTypesBitboards[WHITE][KNIGHT] | pieceTypesBitboards[BLACK][KNIGHT]))
+           | (Attacks::kingAttacks[sq64] & (pieceTypesBitboards[WHITE][KING] | pieceTypesBitboards[BLACK][KING]))
+           | (Attacks::sliding_diagonal_attacks(sq64, occupied) & (pieceTypesBitboards[WHITE][BISHOP] | pieceTypesBitboards[BLACK][BISHOP] | queens))
+           | (Attacks::sliding_side_attacks(sq64, occupied) & (pieceTypesBitboards[WHITE][ROOK] | pieceTypesBitboards[BLACK][ROOK] | queens));
+}
+
+bool Position::see(Move move, Evaluate::Score threshold) const{
+
+    // Castling, en passant and promotions are not worth the swap
+    if(move_special(move) != NO_SPECIAL && move_special(move) != PAWN_START){
+        return threshold <= 0;
+    }
+
+    const Square64 from = move_from(move);
+    const Square64 to   = move_to(move);
+
+    // Gain if the exchange stops right away, then if the mover is taken back
+    Evaluate::Score swap = Evaluate::SEE_VALUE[piece_type(mailbox[to])] - threshold;
+    if(swap < 0){
+        return false;
+    }
+    swap = Evaluate::SEE_VALUE[piece_type(mailbox[from])] - swap;
+    if(swap <= 0){
+        return true;
+    }
+
+    Bitboard occupied  = occupiedBitboards[COLOR_NC] ^ (ONE << from) ^ (ONE << to);
+    Bitboard attackers = attackers_to(to, occupied);
+    const Bitboard bishops = pieceTypesBitboards[WHITE][BISHOP] | pieceTypesBitboards[BLACK][BISHOP]
+                           | pieceTypesBitboards[WHITE][QUEEN]  | pieceTypesBitboards[BLACK][QUEEN];
+    const Bitboard rooks   = pieceTypesBitboards[WHITE][ROOK]   | pieceTypesBitboards[BLACK][ROOK]
+                           | pieceTypesBitboards[WHITE][QUEEN]  | pieceTypesBitboards[BLACK][QUEEN];
+
+    Color side = piece_color(mailbox[from]);
+    bool result = true;
+
+    while(true){
+        side = ~side;
+        attackers &= occupied;
+        const Bitboard sideAttackers = attackers & occupiedBitboards[side];
+        if(!sideAttackers){
+            break;
+        }
+        result = !result;
+
+        // Least valuable attacker; removing it may uncover a slider behind
+        PieceType type = PAWN;
+        while(!(sideAttackers & pieceTypesBitboards[side][type])){
+            type = PieceType(type + 1);
+        }
+
+        if(type == KING){
+            // The king may only take when nothing defends the square
+            return (attackers & occupiedBitboards[~side]) ? !result : result;
+        }
+
+        swap = Evaluate::SEE_VALUE[type] - swap;
+        if(swap < Evaluate::Score(result)){
+            break;
+        }
+
+        const Bitboard pieces = sideAttackers & pieceTypesBitboards[side][type];
+        occupied ^= pieces & (~pieces + 1);
+
+        if(type == PAWN || type == BISHOP || type == QUEEN){
+            attackers |= Attacks::sliding_diagonal_attacks(to, occupied) & bishops;
+        }
+        if(type == ROOK || type == QUEEN){
+            attackers |= Attacks::sliding_side_attacks(to, occupied) & rooks;
+        }
+    }
+
+    return result;
+}
+
 /*returns true if the side is attacking the square*/
 bool Position::square_is_attacked_bySide(Square64 sq64, Color side) const{
 
@@ -290,6 +425,81 @@ bool Position::square_is_attacked_bySide(Square64 sq64, Color side) const{
 }
 
 
+bool Position::is_pseudo_legal(Move move) const{
+
+    const Square64 from = move_from(move);
+    const Square64 to   = move_to(move);
+    const SpecialMove special = move_special(move);
+    const Piece piece = mailbox[from];
+    const Bitboard toMask = ONE << to;
+    const Bitboard occupied = occupiedBitboards[COLOR_NC];
+
+    if(move == NOMOVE || piece == NO_PIECE || piece_color(piece) != sideToMove || (occupiedBitboards[sideToMove] & toMask)){
+        return false;
+    }
+
+    switch(special){
+        case NO_SPECIAL: case ENPASSANT: case PAWN_START: case CASTLE:
+        case PROMOTION_KNIGHT: case PROMOTION_BISHOP: case PROMOTION_ROOK: case PROMOTION_QUEEN:
+            break;
+        default:
+            return false;
+    }
+
+    // Same conditions as the generator: empty path, king and crossed square not attacked
+    if(special == CASTLE){
+        if(piece_type(piece) != KING) return false;
+        const CastlingRight rights = get_castling_right();
+        if(sideToMove == WHITE && from == SQ64_E1){
+            if(to == SQ64_G1) return (rights & WKCA) && !(occupied & 0x0000000000000060)
+                                  && !checkers() && !square_is_attacked_bySide(SQ64_F1, BLACK);
+            if(to == SQ64_C1) return (rights & WQCA) && !(occupied & 0x000000000000000E)
+                                  && !checkers() && !square_is_attacked_bySide(SQ64_D1, BLACK);
+        }
+        if(sideToMove == BLACK && from == SQ64_E8){
+            if(to == SQ64_G8) return (rights & BKCA) && !(occupied & 0x6000000000000000)
+                                  && !checkers() && !square_is_attacked_bySide(SQ64_F8, WHITE);
+            if(to == SQ64_C8) return (rights & BQCA) && !(occupied & 0x0E00000000000000)
+                                  && !checkers() && !square_is_attacked_bySide(SQ64_D8, WHITE);
+        }
+        return false;
+    }
+
+    if(piece_type(piece) == PAWN){
+        const int up = sideToMove == WHITE ? NORTH : SOUTH;
+        const bool lastRank = square_rank(to) == (sideToMove == WHITE ? RANK_8 : RANK_1);
+
+        if(special == ENPASSANT){
+            return to == get_enpassant_square() && (Attacks::pawnAttacks[sideToMove][from] & toMask);
+        }
+        if(special == PAWN_START){
+            return square_rank(from) == (sideToMove == WHITE ? RANK_2 : RANK_7) && int(to) == int(from) + 2 * up
+                && !(occupied & (toMask | ONE << (int(from) + up)));
+        }
+        // Promotions exactly when reaching the last rank
+        if((special != NO_SPECIAL) != lastRank){
+            return false;
+        }
+        if(occupiedBitboards[~sideToMove] & toMask){
+            return Attacks::pawnAttacks[sideToMove][from] & toMask;
+        }
+        return int(to) == int(from) + up;
+    }
+
+    if(special != NO_SPECIAL){
+        return false;
+    }
+
+    switch(piece_type(piece)){
+        case KNIGHT: return Attacks::knightAttacks[from] & toMask;
+        case BISHOP: return Attacks::sliding_diagonal_attacks(from, occupied) & toMask;
+        case ROOK:   return Attacks::sliding_side_attacks(from, occupied) & toMask;
+        case QUEEN:  return (Attacks::sliding_diagonal_attacks(from, occupied) | Attacks::sliding_side_attacks(from, occupied)) & toMask;
+        case KING:   return Attacks::kingAttacks[from] & toMask;
+        default:     return false;
+    }
+}
+
 bool Position::do_move(Move move){
 
     Square64 from = move_from(move);
@@ -301,7 +511,10 @@ bool Position::do_move(Move move){
 
     ++ply;
     moveHistory[ply-1].positionKey = moveHistory[ply-2].positionKey;
+    moveHistory[ply-1].pawnKey = moveHistory[ply-2].pawnKey;
+    moveHistory[ply-1].materialKey = moveHistory[ply-2].materialKey;
     moveHistory[ply-1].phaseWeight = moveHistory[ply-2].phaseWeight;
+    moveHistory[ply-1].psqt = moveHistory[ply-2].psqt;
     moveHistory[ply-1].positionKey ^= Zobrist::castlingRight[moveHistory[ply-2].castlingRight];
 
     if(specialMove != SpecialMove::NO_SPECIAL){
@@ -385,22 +598,82 @@ bool Position::do_move(Move move){
         add_piece(to, promPiece);
     }
 
+    //The child key is final here: fetch its TT bucket while legality is checked
+    TT::prefetch(moveHistory[ply-1].positionKey ^ Zobrist::blackMoves);
+
     Bitboard kingBitboard = pieceTypesBitboards[sideToMove][KING];
     Square64 kingsq64{Bitboards::ctz(kingBitboard)};
 
-    if(square_is_attacked_bySide(kingsq64, ~sideToMove)){
+    //Out of check, only king moves, pinned pieces and en passant can expose the king
+    const HistoryInfo &parent = moveHistory[ply-2];
+    const bool mayExposeKing = parent.checkers || (parent.pinned & (ONE << from))
+                            || kingsq64 == to || specialMove == SpecialMove::ENPASSANT;
+
+    if(mayExposeKing && square_is_attacked_bySide(kingsq64, ~sideToMove)){
         sideToMove =~ sideToMove;
         moveHistory[ply-1].positionKey ^= Zobrist::blackMoves;
         undo_move();
         return false;
     }
 
+    //Only legal moves pay for the network update; undo just drops the ply
+    if(NNUE::enabled() && has_accumulators())
+        update_accumulator(move);
+
     sideToMove =~ sideToMove;
     moveHistory[ply-1].positionKey ^= Zobrist::blackMoves;
+    set_check_info();
 
     return true;
 }
 
+void Position::refresh_accumulator(){
+    if(accumulators.empty())
+        accumulators.resize(MAX_GAME_MOVES);
+    NNUE::refresh(*this, accumulators[ply-1]);
+}
+
+void Position::release_accumulators(){
+    accumulators = std::vector<NNUE::Accumulator>();
+}
+
+void Position::update_accumulator(Move move){
+
+    Square64 from = move_from(move);
+    Square64 to = move_to(move);
+    SpecialMove specialMove = move_special(move);
+    NNUE::Accumulator &accumulator = accumulators[ply-1];
+
+    accumulator = accumulators[ply-2];
+
+    if(specialMove == SpecialMove::ENPASSANT){
+        Square64 capturedSquare = Square64(sideToMove == Color::WHITE ? to + Direction::SOUTH : to + Direction::NORTH);
+        NNUE::remove_piece(accumulator, make_piece(~sideToMove, PAWN), capturedSquare);
+    }
+    else if(specialMove == SpecialMove::CASTLE){
+        Piece rook = make_piece(sideToMove, ROOK);
+        switch (to)
+        {
+        case Square64::SQ64_C1: NNUE::move_piece(accumulator, rook, Square64::SQ64_A1, Square64::SQ64_D1); break;
+        case Square64::SQ64_G1: NNUE::move_piece(accumulator, rook, Square64::SQ64_H1, Square64::SQ64_F1); break;
+        case Square64::SQ64_C8: NNUE::move_piece(accumulator, rook, Square64::SQ64_A8, Square64::SQ64_D8); break;
+        case Square64::SQ64_G8: NNUE::move_piece(accumulator, rook, Square64::SQ64_H8, Square64::SQ64_F8); break;
+        default: break;
+        }
+    }
+
+    Piece capturedPiece = captured_piece(move);
+    if(capturedPiece != Piece::NO_PIECE)
+        NNUE::remove_piece(accumulator, capturedPiece, to);
+
+    if(promoted_piece(move) != PieceType::NO_PIECE_TYPE){
+        NNUE::remove_piece(accumulator, make_piece(sideToMove, PAWN), from);
+        NNUE::add_piece(accumulator, mailbox[to], to);
+    } else {
+        NNUE::move_piece(accumulator, mailbox[to], from, to);
+    }
+}
+
 void Position::undo_move(){
     
     Move move = moveHistory[ply-2].nextMove;
@@ -460,7 +733,12 @@ void Position::undo_move(){
     moveHistory[ply-1].fullMoves = 0;
     moveHistory[ply-1].enpassantSquare = Square64::SQ64_NO_SQUARE;
     moveHistory[ply-1].positionKey = 0;
+    moveHistory[ply-1].pawnKey = 0;
+    moveHistory[ply-1].materialKey = 0;
     moveHistory[ply-1].phaseWeight = 0;
+    moveHistory[ply-1].psqt = 0;
+    moveHistory[ply-1].checkers = 0;
+    moveHistory[ply-1].pinned = 0;
 
     --ply;
 
@@ -482,10 +760,17 @@ void Position::move_piece(Square64 from, Square64 to){
     occupiedBitboards[pieceColor] = Bitboards::set_pieces(occupiedBitboards[pieceColor], to);
     occupiedBitboards[Color::COLOR_NC] = Bitboards::set_pieces(occupiedBitboards[Color::COLOR_NC],to);
 
+    moveHistory[ply-1].psqt += Evaluate::PSQT[piece][to] - Evaluate::PSQT[piece][from];
+
     //Update key
     moveHistory[ply-1].positionKey ^= Zobrist::pieceSquare[piece][from];
     moveHistory[ply-1].positionKey ^= Zobrist::pieceSquare[piece][to];
 
+    if(pieceType == PieceType::PAWN){
+        moveHistory[ply-1].pawnKey ^= Zobrist::pieceSquare[piece][from];
+        moveHistory[ply-1].pawnKey ^= Zobrist::pieceSquare[piece][to];
+    }
+
 }
 
 void Position::remove_piece(Square64 square){
@@ -495,6 +780,8 @@ void Position::remove_piece(Square64 square){
     Color pieceColor = piece_color(piece);
     PieceType pieceType = piece_type(piece);
     moveHistory[ply-1].phaseWeight -= Evaluate::PHASE_PIECE_WEIGHT[piece];
+    moveHistory[ply-1].psqt -= Evaluate::PSQT[piece][square];
+    moveHistory[ply-1].materialKey ^= Zobrist::materialCount[piece][Bitboards::cpop(pieceTypesBitboards[pieceColor][pieceType])];
 
     pieceTypesBitboards[pieceColor][pieceType] = Bitboards::clear_pieces(pieceTypesBitboards[pieceColor][pieceType], square);
     occupiedBitboards[pieceColor] = Bitboards::clear_pieces(occupiedBitboards[pieceColor], square);
@@ -502,6 +789,8 @@ void Position::remove_piece(Square64 square){
 
     //Update key
     moveHistory[ply-1].positionKey ^= Zobrist::pieceSquare[piece][square];
+    if(pieceType == PieceType::PAWN)
+        moveHistory[ply-1].pawnKey ^= Zobrist::pieceSquare[piece][square];
 }
 
 void Position::add_piece(Square64 square, Piece piece){
@@ -515,9 +804,13 @@ void Position::add_piece(Square64 square, Piece piece){
     occupiedBitboards[Color::COLOR_NC] = Bitboards::set_pieces(occupiedBitboards[Color::COLOR_NC], square);
 
     moveHistory[ply-1].phaseWeight += Evaluate::PHASE_PIECE_WEIGHT[piece];
+    moveHistory[ply-1].psqt += Evaluate::PSQT[piece][square];
+    moveHistory[ply-1].materialKey ^= Zobrist::materialCount[piece][Bitboards::cpop(pieceTypesBitboards[pieceColor][pieceType])];
 
     //Update key
     moveHistory[ply-1].positionKey ^= Zobrist::pieceSquare[piece][square];
+    if(pieceType == PieceType::PAWN)
+        moveHistory[ply-1].pawnKey ^= Zobrist::pieceSquare[piece][square];
 
 }
 
@@ -526,7 +819,10 @@ void Position::do_null_move() {
 
     ++ply;
     moveHistory[ply-1].positionKey = moveHistory[ply-2].positionKey;
+    moveHistory[ply-1].pawnKey = moveHistory[ply-2].pawnKey;
+    moveHistory[ply-1].materialKey = moveHistory[ply-2].materialKey;
     moveHistory[ply-1].phaseWeight = moveHistory[ply-2].phaseWeight;
+    moveHistory[ply-1].psqt = moveHistory[ply-2].psqt;
     moveHistory[ply-1].positionKey ^= Zobrist::castlingRight[moveHistory[ply-2].castlingRight];
     moveHistory[ply-1].castlingRight = moveHistory[ply-2].castlingRight;
     moveHistory[ply-1].positionKey ^= Zobrist::castlingRight[moveHistory[ply-1].castlingRight];
@@ -545,8 +841,13 @@ void Position::do_null_move() {
 
     moveHistory[ply-1].enpassantSquare = Square64::SQ64_NO_SQUARE;
 
+    if(NNUE::enabled() && has_accumulators())
+        accumulators[ply-1] = accumulators[ply-2];
+
     sideToMove =~ sideToMove;
     moveHistory[ply-1].positionKey ^= Zobrist::blackMoves;
+    TT::prefetch(moveHistory[ply-1].positionKey);
+    set_check_info();
 }
 
 void Position::undo_null_move(){
@@ -559,7 +860,12 @@ void Position::undo_null_move(){
     moveHistory[ply-1].fullMoves = 0;
     moveHistory[ply-1].enpassantSquare = Square64::SQ64_NO_SQUARE;
     moveHistory[ply-1].positionKey = 0;
+    moveHistory[ply-1].pawnKey = 0;
+    moveHistory[ply-1].materialKey = 0;
     moveHistory[ply-1].phaseWeight = 0;
+    moveHistory[ply-1].psqt = 0;
+    moveHistory[ply-1].checkers = 0;
+    moveHistory[ply-1].pinned = 0;
 
     --ply;
 }
@@ -4,7 +4,9 @@
 #include "bitboards.h"
 #include "move.h"
 #include "evaluate.h"
+#include "nnue.h"
 #include <sstream>
+#include <vector>
 
 
 namespace Akerbeltz{
@@ -16,7 +18,12 @@ namespace Akerbeltz{
         unsigned short int fullMoves;
         Square64 enpassantSquare;
         Key positionKey;
+        Key pawnKey;
+        Key materialKey;   // Piece counts only, see Zobrist::materialCount
         Evaluate::GamePhaseWeight phaseWeight;
+        Evaluate::PackedScore psqt;    // Material + PST, white minus black
+        Bitboard checkers;   // Pieces giving check to the side to move
+        Bitboard pinned;     // Side to move pieces pinned to their king
     };
 
 class Position{
@@ -36,10 +43,30 @@ public:
     Bitboard get_pieceTypes_bitboard(Color color, PieceType pieceType) const;
     Bitboard get_occupied_bitboard(Color color) const;
     Key get_key() const;
+    Key get_pawn_key() const;
+    Key get_material_key() const;
+    // get_material_key() of a position holding just these pieces
+    static Key material_key(const Piece *pieces, int count);
     bool square_is_attacked_bySide(Square64 square, Color side) const; 
+    // Pieces of both colors attacking the square through the given occupancy
+    Bitboard attackers_to(Square64 square, Bitboard occupied) const;
+    Bitboard checkers() const;
+    Bitboard pinned() const;
+    // Whether the move generator could produce the move here. Only from, to
+    // and the special flag are checked, so TT and killer moves qualify.
+    bool is_pseudo_legal(Move move) const;
+    // Static exchange evaluation: whether the capture sequence on the target
+    // square, each side taking with its least valuable piece and stopping when
+    // it pays, wins at least the threshold for the side to move
+    bool see(Move move, Evaluate::Score threshold) const;
     bool is_repetition() const;
     Evaluate::GamePhaseWeight game_phase_weight() const;
+    Evaluate::PackedScore psqt() const;
     bool is_endgame_phase() const;
+    const NNUE::Accumulator& accumulator() const;
+    bool has_accumulators() const;
+    void refresh_accumulator();
+    void release_accumulators();
 
     //Move related functions
     bool do_move(Move move);
@@ -61,6 +88,8 @@ private:
     void clear_mailbox();
 
     void calc_key();
+    void set_check_info();
+    void update_accumulator(Move move);
     
     Bitboard pieceTypesBitboards[COLOR_SIZE][PIECETYPE_SIZE];
     Bitboard occupiedBitboards[COLOR_SIZE];
@@ -68,6 +97,10 @@ private:
     Color sideToMove{COLOR_NC};
     int ply;
     HistoryInfo moveHistory[MAX_GAME_MOVES];
+    // Network accumulator of each ply, kept only while NNUE is enabled. About
+    // 1.2 MB, so it is allocated by the first refresh with the network on and
+    // classical positions stay small to build and copy
+    std::vector<NNUE::Accumulator> accumulators;
 };
 
 std::ostream& operator<<(std::ostream& os, const Position& pos);
@@ -81,6 +114,12 @@ inline int Position::get_ply() const{
 inline CastlingRight Position::get_castling_right() const{
     return moveHistory[ply-1].castlingRight;
 }
+inline Bitboard Position::checkers() const{
+    return moveHistory[ply-1].checkers;
+}
+inline Bitboard Position::pinned() const{
+    return moveHistory[ply-1].pinned;
+}
 inline Square64 Position::get_enpassant_square() const{
     return moveHistory[ply-1].enpassantSquare;
 }
@@ -102,12 +141,27 @@ inline Bitboard Position::get_occupied_bitboard(Color color) const{
 inline Key Position::get_key() const{
     return moveHistory[ply-1].positionKey;
 }
+inline Key Position::get_pawn_key() const{
+    return moveHistory[ply-1].pawnKey;
+}
+inline Key Position::get_material_key() const{
+    return moveHistory[ply-1].materialKey;
+}
 inline Evaluate::GamePhaseWeight Position::game_phase_weight() const{
     return moveHistory[ply-1].phaseWeight;
 }
+inline Evaluate::PackedScore Position::psqt() const{
+    return moveHistory[ply-1].psqt;
+}
 inline bool Position::is_endgame_phase() const{
     return game_phase_weight() <= Evaluate::ENDGAME_PHASE_THRESHOLD;
 }
+inline bool Position::has_accumulators() const{
+    return !accumulators.empty();
+}
+inline const NNUE::Accumulator& Position::accumulator() const{
+    return accumulators[ply-1];
+}
 
 
 } // namespace Akerbeltz
@@ -1,10 +1,21 @@
 #include "search.h"
 
 #include "movegen.h"
+#include "movepicker.h"
+#include "nnue.h"
+#include "parallel.h"
 #include "position.h"
+#include "tablebase.h"
 #include "ttable.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
 
 namespace Akerbeltz{
 
@@ -13,24 +24,91 @@ namespace Search{
 using namespace Evaluate;
 
 static NodesSize leafCounter;
-TT::PVLine pvLine;
+
+// Per-thread search state: every Lazy SMP thread owns its PV and heuristics
+thread_local TT::PVLine pvLine;
 
 //Killer heuristic
-Move killerMoves[MAX_KILLERMOVES][MAX_DEPTH];
+thread_local Move killerMoves[MAX_KILLERMOVES][MAX_DEPTH];
 
 //History Heuristic
-MoveScore searchHistory[PIECE_SIZE][SQ64_SIZE];
+thread_local MoveScore searchHistory[PIECE_SIZE][SQ64_SIZE];
+
+// Qsearch skips captures that cannot lift the stand pat this close to alpha
+constexpr Score DELTA_MARGIN = 200;
+
+// Half width of the first aspiration window, doubled on every fail
+constexpr Score ASPIRATION_WINDOW = 25;
+constexpr DepthSize ASPIRATION_MIN_DEPTH = 4;
+
+// Root and PV nodes search an open window for the exact score. NonPV nodes
+// only prove a bound with a null window, so they take the TT and null move
+// shortcuts and never re-search
+enum NodeType{
+    NODE_ROOT,
+    NODE_PV,
+    NODE_NON_PV
+};
+
+struct HelperThread{
+    Position position;
+    SearchInfo searchInfo;
+    std::atomic<NodesSize> nodes{0};
+    DepthSize completedDepth{0};
+    Score bestMoveScore{-CHECKMATE_SCORE};
+    Move bestMove{NOMOVE};
+    EvalStats evalStats;
+    Parallel::Worker worker;    // Last, so it is joined before the rest goes
+};
+
+std::size_t threadCount = DEFAULT_THREADS;
+std::vector<std::unique_ptr<HelperThread>> helpers;
 
 void perft(Position &position, DepthSize depth);
 
+template<NodeType NT>
 Score alpha_beta(Position &position, SearchInfo &searchInfo, Score alpha, Score beta, DepthSize depth, bool nullMovePrune);
+Score aspiration_search(Position &position, SearchInfo &searchInfo, Score prevScore, DepthSize depth);
 Score quiescence_search(Position &position, SearchInfo &searchInfo, Score alpha, Score beta);
 void clean_search_info(SearchInfo &searchInfo);
 void pick_move(int moveIndx, MoveGen::MoveList &moveList);
 bool is_draw(const Position &position, const SearchInfo &searchInfo);
 static Move first_legal_move(Position& position);
-void print_iter_info(DepthSize currentDepth, Score bestmoveScoreCP, SearchInfo &searchInfo);
+void print_iter_info(DepthSize currentDepth, Score bestmoveScoreCP, NodesSize nodes, SearchInfo &searchInfo);
+void start_helpers(const Position &position, const SearchInfo &searchInfo);
+void stop_helpers();
+void helper_search(HelperThread &helper, std::size_t helperId);
+NodesSize total_nodes(const SearchInfo &searchInfo);
+Move vote_best_move(Move bestMove, Score bestMoveScore, DepthSize completedDepth);
+void print_eval_stats();
+
+
+// Must not be called while a search runs
+void set_threads(std::size_t threads){
+    threadCount = std::clamp(threads, MIN_THREADS, MAX_THREADS);
+
+    while(helpers.size() > threadCount - 1){
+        helpers.pop_back();
+    }
+    while(helpers.size() < threadCount - 1){
+        helpers.push_back(std::make_unique<HelperThread>());
+    }
+}
 
+Parallel::Worker& main_worker(){
+    static Parallel::Worker worker;
+    return worker;
+}
+
+void start_search(Position &position, SearchInfo &searchInfo){
+    main_worker().run([&position, &searchInfo]{ search(position, searchInfo); });
+}
+
+void wait_search(){
+    main_worker().wait();
+}
+
+std::size_t thread_count(){ return threadCount; }
 
 void search(Position &position, SearchInfo &searchInfo){
 
@@ -39,27 +117,55 @@ void search(Position &position, SearchInfo &searchInfo){
     Move bestMove = first_legal_move(position);
     if (!bestMove) { std::cout << "bestmove 0000\n"; return; }
 
+    // Positions in the tablebases are played from the tables: at once on
+    // the clock, otherwise after the requested search
+    Tablebase::ProbeResult tbResult;
+    const Move tbMove = Tablebase::root_move(position, tbResult);
+    if (tbMove) {
+        const Score tbScore = tbResult.wdl == Tablebase::WDL_WIN  ?  Tablebase::TB_WIN_SCORE
+                            : tbResult.wdl == Tablebase::WDL_LOSS ? -Tablebase::TB_WIN_SCORE : DRAW_SOCORE;
+        std::cout << "info depth 0 score cp " << to_centipawns(tbScore, position.game_phase_weight())
+                  << " tbhits 1 pv " << algebraic_move(tbMove) << " string dtz " << tbResult.dtz << std::endl;
+        if (searchInfo.timeManager.remaining_ms() && !searchInfo.infinite) {
+            std::cout << "bestmove " << algebraic_move(tbMove) << std::endl;
+            return;
+        }
+        bestMove = tbMove;
+    }
+
     clean_search_info(searchInfo);
+    TT::new_search();
+    // Moves given while NNUE was off left the accumulator stale. With the
+    // network off the accumulators go, so the helper copies skip them
+    if (NNUE::enabled())
+        position.refresh_accumulator();
+    else
+        position.release_accumulators();
+    start_helpers(position, searchInfo);
 
     NodesSize prevTotalNodes = searchInfo.nodes;
     uint64_t  lastIterNodes  = 0;   
+    DepthSize completedDepth = 0;
 
     for(DepthSize currentDepth = 1; currentDepth <= searchInfo.depth; ++currentDepth){
 
         const TimeManager::Ms iterStartMs = searchInfo.timeManager.elapsed_ms();
 
-        bestMoveScore = alpha_beta(position, searchInfo, -CHECKMATE_SCORE, CHECKMATE_SCORE, currentDepth, true);
+        Score iterScore = aspiration_search(position, searchInfo, bestMoveScore, currentDepth);
 
         //Necessary for avoid loading partially calculated pv line
         if (searchInfo.timeManager.out_of_time() || searchInfo.stop) {
             break;
         }
 
+        bestMoveScore = iterScore;
+        completedDepth = currentDepth;
+
         TT::load_pv_line(position, pvLine, MAX_DEPTH);
         if (pvLine.depth > 0) bestMove = pvLine.moves[0];
         
         Score bestMoveScoreCP = to_centipawns(bestMoveScore, position.game_phase_weight());
-        print_iter_info(currentDepth, bestMoveScoreCP, searchInfo);
+        print_iter_info(currentDepth, bestMoveScoreCP, total_nodes(searchInfo), searchInfo);
 
         // Check iteration times
         const auto iterEndMs  = searchInfo.timeManager.elapsed_ms();
@@ -77,31 +183,185 @@ void search(Position &position, SearchInfo &searchInfo){
 
     }
 
+    stop_helpers();
+    bestMove = tbMove ? tbMove : vote_best_move(bestMove, bestMoveScore, completedDepth);
+    searchInfo.nodes = total_nodes(searchInfo);
+    print_eval_stats();
+
+    // "go infinite" ends with "stop" even when the search ran out of depth
+    while(searchInfo.infinite && !searchInfo.stop)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
     std::cout << "bestmove " << algebraic_move(bestMove) << std::endl;
 }
 
+// Wakes the helpers on a copy of the root; their eval caches are kept from
+// the previous searches, killers and history start afresh
+void start_helpers(const Position &position, const SearchInfo &searchInfo){
+
+    for(std::size_t i = 0; i < helpers.size(); ++i){
+        HelperThread &helper = *helpers[i];
+        helper.position = position;
+        helper.searchInfo.depth = searchInfo.depth;
+        helper.searchInfo.nodes = 0;
+        helper.searchInfo.searchPly = 0;
+        helper.searchInfo.timeManager = searchInfo.timeManager;
+        helper.searchInfo.stop = false;
+        helper.nodes.store(0, std::memory_order_relaxed);
+        helper.completedDepth = 0;
+        helper.bestMoveScore = -CHECKMATE_SCORE;
+        helper.bestMove = NOMOVE;
+        helper.worker.run([&helper, helperId = i + 1]{ helper_search(helper, helperId); });
+    }
+}
+
+void stop_helpers(){
+    for(auto &helper : helpers){
+        helper->searchInfo.stop = true;
+    }
+    for(auto &helper : helpers){
+        helper->worker.wait();
+    }
+}
+
+// Helpers run their own iterative deepening silently; odd helpers start one
+// ply deeper so the threads do not walk the tree in lockstep
+void helper_search(HelperThread &helper, std::size_t helperId){
+
+    SearchInfo &searchInfo = helper.searchInfo;
+    clean_search_info(searchInfo);
+
+    for(DepthSize currentDepth = 1 + (helperId & 1); currentDepth <= searchInfo.depth; ++currentDepth){
+
+        Score iterScore = aspiration_search(helper.position, searchInfo, helper.bestMoveScore, currentDepth);
+        helper.nodes.store(searchInfo.nodes, std::memory_order_relaxed);
+
+        if (searchInfo.timeManager.out_of_time() || searchInfo.stop) {
+            break;
+        }
+
+        TT::load_pv_line(helper.position, pvLine, MAX_DEPTH);
+        if (pvLine.depth > 0){
+            helper.bestMove = pvLine.moves[0];
+            helper.bestMoveScore = iterScore;
+            helper.completedDepth = currentDepth;
+        }
+    }
+
+    helper.nodes.store(searchInfo.nodes, std::memory_order_relaxed);
+    helper.evalStats = Evaluate::thread_stats();
+}
+
+NodesSize total_nodes(const SearchInfo &searchInfo){
+    NodesSize nodes = searchInfo.nodes;
+    for(const auto &helper : helpers){
+        nodes += helper->nodes.load(std::memory_order_relaxed);
+    }
+    return nodes;
+}
+
+// Every thread votes for its best move, weighted by completed depth and by
+// how much its score exceeds the worst score reported
+Move vote_best_move(Move bestMove, Score bestMoveScore, DepthSize completedDepth){
+
+    if (helpers.empty() || completedDepth == 0) return bestMove;
+
+    struct Candidate{ Move move; Score score; DepthSize depth; };
+    std::vector<Candidate> candidates{{bestMove, bestMoveScore, completedDepth}};
+
+    for(const auto &helper : helpers){
+        if(helper->completedDepth > 0 && helper->bestMove != NOMOVE)
+            candidates.push_back({helper->bestMove, helper->bestMoveScore, helper->completedDepth});
+    }
+
+    Score minScore = bestMoveScore;
+    for(const auto &c : candidates) minScore = std::min(minScore, c.score);
+
+    int64_t bestVotes = -1;
+    for(const auto &c : candidates){
+        int64_t votes = 0;
+        for(const auto &other : candidates){
+            if(equal_move(other.move, c.move))
+                votes += (int64_t(other.score) - minScore + 14) * other.depth;
+        }
+        if(votes > bestVotes){
+            bestVotes = votes;
+            bestMove = c.move;
+        }
+    }
+
+    return bestMove;
+}
+
+
+// From ASPIRATION_MIN_DEPTH the search starts in a window around the last
+// iteration's score, widened on the failing side until the score falls inside
+Score aspiration_search(Position &position, SearchInfo &searchInfo, Score prevScore, DepthSize depth){
+
+    Score delta = ASPIRATION_WINDOW;
+    Score alpha = -CHECKMATE_SCORE;
+    Score beta  =  CHECKMATE_SCORE;
 
+    // Mate and tablebase scores move by more than any window between iterations
+    if(depth >= ASPIRATION_MIN_DEPTH && std::abs(prevScore) < Tablebase::TB_WIN_SCORE - MAX_DEPTH){
+        alpha = std::max(prevScore - delta, -CHECKMATE_SCORE);
+        beta  = std::min(prevScore + delta,  CHECKMATE_SCORE);
+    }
+
+    while(true){
+
+        const Score score = alpha_beta<NODE_ROOT>(position, searchInfo, alpha, beta, depth, true);
+
+        if(searchInfo.timeManager.out_of_time() || searchInfo.stop){
+            return score;
+        }
+
+        if(score <= alpha && alpha > -CHECKMATE_SCORE){
+            alpha = std::max(alpha - delta, -CHECKMATE_SCORE);
+        }
+        else if(score >= beta && beta < CHECKMATE_SCORE){
+            beta = std::min(beta + delta, CHECKMATE_SCORE);
+        }
+        else{
+            return score;
+        }
+        delta += delta;
+    }
+}
+
+template<NodeType NT>
 Score alpha_beta(Position &position, SearchInfo &searchInfo, Score alpha, Score beta, DepthSize depth, bool nullMovePrune){
 
+    constexpr bool rootNode = NT == NODE_ROOT;
+    constexpr bool pvNode   = NT != NODE_NON_PV;
+
     if (is_draw(position, searchInfo)) { return DRAW_SOCORE; }
 
+    // Exact results for few pieces; nearer wins score higher
+    if (!rootNode && Bitboards::cpop(position.get_occupied_bitboard(COLOR_NC)) <= Tablebase::probe_limit()) {
+        const Tablebase::WDL wdl = Tablebase::probe_wdl(position);
+        if (wdl == Tablebase::WDL_WIN)  { return  Tablebase::TB_WIN_SCORE - searchInfo.searchPly; }
+        if (wdl == Tablebase::WDL_LOSS) { return -Tablebase::TB_WIN_SCORE + searchInfo.searchPly; }
+        if (wdl == Tablebase::WDL_DRAW) { return DRAW_SOCORE; }
+    }
+
     if(depth==0) { return quiescence_search(position, searchInfo, alpha, beta); }
 
     ++searchInfo.nodes;
 
-    bool isCheck = position.square_is_attacked_bySide(Square64(Bitboards::ctz(position.get_pieceTypes_bitboard(position.get_side_to_move(), KING))), ~position.get_side_to_move());
+    bool isCheck = position.checkers();
 
     if(isCheck){
         depth++;
     }
-    else if (nullMovePrune && depth >= 3 && !position.is_endgame_phase()) {
+    else if (!pvNode && nullMovePrune && depth >= 3 && !position.is_endgame_phase()) {
 
         const DepthSize R = 2; 
 
         position.do_null_move();
         ++searchInfo.searchPly;
 
-        Score nullScore = -alpha_beta(position,
+        Score nullScore = -alpha_beta<NODE_NON_PV>(position,
                                       searchInfo,
                                       -beta,
                                       -beta + 1,
@@ -125,7 +385,8 @@ Score alpha_beta(Position &position, SearchInfo &searchInfo, Score alpha, Score
     if (TT::probe(key, ttEntry)) {
         hashMove = ttEntry.move; 
 
-        if (ttEntry.depth >= depth) {
+        // PV nodes search on so the PV stays whole
+        if (!pvNode && ttEntry.depth >= depth) {
             Score ttScore = ttEntry.score;
 
             if (ttEntry.flag == TT::FLAG_EXACT)
@@ -137,48 +398,29 @@ Score alpha_beta(Position &position, SearchInfo &searchInfo, Score alpha, Score
         }
     }
 
-    MoveGen::MoveList moveList;
-    MoveGen::generate_pseudo_moves(position, moveList);
-
-    //Set move scores
-    for(int mIndx = 0; mIndx < moveList.size; ++mIndx){
-
-        Move move = moveList.moves[mIndx];
-
-        if(equal_move(move, hashMove)){
-            moveList.moves[mIndx] = set_heuristic_score(move, PV_SCORE);
-        }else if(is_capture(move)){
-            if(move_special(move) == ENPASSANT){
-                moveList.moves[mIndx] = set_heuristic_score(move, MVVLVAScores[PAWN][PAWN]);
-            }
-            else{
-                moveList.moves[mIndx] = set_heuristic_score(move, MVVLVAScores[piece_type(attacker_piece(move))][piece_type(captured_piece(move))]);
-            }
-        }
-        else if(equal_move(move, killerMoves[0][searchInfo.searchPly])){
-            moveList.moves[mIndx] = set_heuristic_score(move, KILLERMOVE_SOCORE_0);
-        }else if(equal_move(move, killerMoves[1][searchInfo.searchPly])){
-            moveList.moves[mIndx] = set_heuristic_score(move, KILLERMOVE_SOCORE_1);
-        }else{ 
-            moveList.moves[mIndx] = set_heuristic_score(move, searchHistory[position.get_mailbox_piece(move_from(move))][move_to(move)]);
-        }
-    }
+    MovePicker movePicker(position, hashMove, killerMoves[0][searchInfo.searchPly],
+                          killerMoves[1][searchInfo.searchPly], searchHistory);
 
     Score score = -CHECKMATE_SCORE;
     Move bestMove = 0;
     int legalMoves = 0;
 
-    for(int mIndx = 0; mIndx < moveList.size; ++mIndx){
+    for(Move move = movePicker.next_move(); move != NOMOVE; move = movePicker.next_move()){
 
-        pick_move(mIndx, moveList);
-        Move move = moveList.moves[mIndx];
         if(!position.do_move(move)){
             continue;
         }
         ++searchInfo.searchPly;
         ++legalMoves;
         
-        score = -alpha_beta(position, searchInfo, -beta, -alpha, depth - 1, true);
+        // PVS: after the first move a null window proves the move is no
+        // better, and only a PV node re-searches one that beats alpha
+        if(!pvNode || legalMoves > 1){
+            score = -alpha_beta<NODE_NON_PV>(position, searchInfo, -alpha - 1, -alpha, depth - 1, true);
+        }
+        if(pvNode && (legalMoves == 1 || (score > alpha && score < beta))){
+            score = -alpha_beta<NODE_PV>(position, searchInfo, -beta, -alpha, depth - 1, true);
+        }
         position.undo_move();
         --searchInfo.searchPly;
 
@@ -233,18 +475,38 @@ Score alpha_beta(Position &position, SearchInfo &searchInfo, Score alpha, Score
 Score quiescence_search(Position &position, SearchInfo &searchInfo, Score alpha, Score beta){
 
     ++searchInfo.nodes;  
+    ++searchInfo.qsearchNodes;
 
     if (is_draw(position, searchInfo)){
         return DRAW_SOCORE;
     }
 
-    if(searchInfo.depth > MAX_DEPTH - 1){
-        return Evaluate::calc_score(position);
+    // Transposed leaves reuse the static eval stored in the TT. Otherwise
+    // stand pat only tests the eval against the window, so a cheap bound
+    // clear of it is enough; a full eval is stored however the node ends
+    const Key key = position.get_key();
+    TT::Entry ttEntry;
+    Score eval;
+    Score newEval = TT::NO_EVAL;
+    if (TT::probe(key, ttEntry) && ttEntry.eval != TT::NO_EVAL) {
+        eval = ttEntry.eval;
+        ++Evaluate::thread_stats().ttEvalHits;
+    }
+    else {
+        bool exactEval;
+        eval = Evaluate::lazy_evaluate(position, alpha, beta, exactEval);
+        if (exactEval) newEval = eval;
     }
 
-    Score score = Evaluate::calc_score(position);
+    if(searchInfo.searchPly >= MAX_DEPTH - 1){
+        return eval;
+    }
 
+    Score score = eval;
     if(score >= beta){
+        if (newEval != TT::NO_EVAL) {
+            TT::store(key, 0, beta, TT::FLAG_LOWERBOUND, NOMOVE, newEval);
+        }
         return beta;
     }
 
@@ -263,6 +525,18 @@ Score quiescence_search(Position &position, SearchInfo &searchInfo, Score alpha,
         pick_move(mIndx, moveList);
 
         Move move = moveList.moves[mIndx];
+
+        // Delta pruning: even the captured piece for free stays below alpha
+        const PieceType captured = move_special(move) == ENPASSANT ? PAWN : piece_type(captured_piece(move));
+        if(promoted_piece(move) == NO_PIECE_TYPE && eval + SEE_VALUE[captured] + DELTA_MARGIN <= alpha){
+            continue;
+        }
+
+        // Captures that lose material in the exchange
+        if(!position.see(move, 0)){
+            continue;
+        }
+
         if(!position.do_move(move)){
             continue;
         }
@@ -276,6 +550,7 @@ Score quiescence_search(Position &position, SearchInfo &searchInfo, Score alpha,
         
         if(score>alpha){
             if(score>=beta){
+                TT::store(key, 0, beta, TT::FLAG_LOWERBOUND, move, newEval);
                 return beta;
             }
             alpha = score;
@@ -283,8 +558,8 @@ Score quiescence_search(Position &position, SearchInfo &searchInfo, Score alpha,
         }
     }
 
-    if (bestMove != NOMOVE) {
-        TT::store(position.get_key(), 0, alpha, TT::FLAG_EXACT, bestMove);
+    if (bestMove != NOMOVE || newEval != TT::NO_EVAL) {
+        TT::store(key, 0, alpha, bestMove != NOMOVE ? TT::FLAG_EXACT : TT::FLAG_UPPERBOUND, bestMove, newEval);
     }
 
     return alpha;
@@ -293,7 +568,8 @@ Score quiescence_search(Position &position, SearchInfo &searchInfo, Score alpha,
 
 void clean_search_info(SearchInfo &searchInfo){
     searchInfo.nodes = 0;
-    TT::clear();
+    searchInfo.qsearchNodes = 0;
+    Evaluate::thread_stats() = EvalStats{};
     //searchInfo.timeOver = false;
     
     for(int i = 0; i < MAX_KILLERMOVES; ++i){
@@ -309,7 +585,9 @@ void clean_search_info(SearchInfo &searchInfo){
 }
 
 bool is_draw(const Position &position, const SearchInfo &searchInfo) {
-    if ((position.is_repetition() || position.get_fifty_moves_counter() >= 100) && searchInfo.searchPly) {
+    // Dead material cuts the whole subtree, like a repetition
+    if ((position.is_repetition() || position.get_fifty_moves_counter() >= 100
+         || Evaluate::material_draw(position)) && searchInfo.searchPly) {
         return true;
     }
     return false;
@@ -317,12 +595,8 @@ bool is_draw(const Position &position, const SearchInfo &searchInfo) {
 
 static Move first_legal_move(Position& position) {
     MoveGen::MoveList ml;
-    MoveGen::generate_pseudo_moves(position, ml);
-    for (int i = 0; i < ml.size; ++i) {
-        Move m = ml.moves[i];
-        if (position.do_move(m)) { position.undo_move(); return m; }
-    }
-    return 0;
+    MoveGen::generate_legal(position, ml);
+    return ml.size ? ml.moves[0] : 0;
 }
 
 void pick_move(int moveIndx, MoveGen::MoveList &moveList){
@@ -344,14 +618,45 @@ void pick_move(int moveIndx, MoveGen::MoveList &moveList){
     moveList.moves[bestIndx] = moveTemp;
 }
 
-void print_iter_info(DepthSize currentDepth, Score bestMoveScoreCP, SearchInfo &searchInfo){
+// Cache hit rates summed over all search threads
+void print_eval_stats(){
+
+        EvalStats stats = Evaluate::thread_stats();
+        for(const auto &helper : helpers){
+            stats.pawnProbes += helper->evalStats.pawnProbes;
+            stats.pawnHits   += helper->evalStats.pawnHits;
+            stats.evalProbes += helper->evalStats.evalProbes;
+            stats.evalHits   += helper->evalStats.evalHits;
+            stats.materialProbes += helper->evalStats.materialProbes;
+            stats.materialHits   += helper->evalStats.materialHits;
+            stats.ttEvalHits += helper->evalStats.ttEvalHits;
+            stats.lazyProbes += helper->evalStats.lazyProbes;
+            stats.lazyHits   += helper->evalStats.lazyHits;
+        }
+
+        const auto percent = [](uint64_t hits, uint64_t probes){ return probes ? 100.0 * hits / probes : 0.0; };
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "info string pawn hash hits " << percent(stats.pawnHits, stats.pawnProbes) << "%"
+                  << " (" << stats.pawnHits << "/" << stats.pawnProbes << ")"
+                  << " eval cache hits " << percent(stats.evalHits, stats.evalProbes) << "%"
+                  << " (" << stats.evalHits << "/" << stats.evalProbes << ")"
+                  << " material hash hits " << percent(stats.materialHits, stats.materialProbes) << "%"
+                  << " (" << stats.materialHits << "/" << stats.materialProbes << ")"
+                  << " lazy eval hits " << percent(stats.lazyHits, stats.lazyProbes) << "%"
+                  << " (" << stats.lazyHits << "/" << stats.lazyProbes << ")"
+                  << " tt evals " << stats.ttEvalHits << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+}
+
+void print_iter_info(DepthSize currentDepth, Score bestMoveScoreCP, NodesSize nodes, SearchInfo &searchInfo){
 
         std::cout <<
         "info" << 
         " depth " << currentDepth << 
         " score cp " << bestMoveScoreCP << 
         " move " << algebraic_move(pvLine.moves[0]) <<
-        " nodes " << searchInfo.nodes <<
+        " nodes " << nodes <<
         " time " << searchInfo.timeManager.elapsed_ms().count();
 
         std::cout << " pv";
@@ -372,14 +677,18 @@ void perft(Position &position, DepthSize depth){
     } 
 
     MoveGen::MoveList moveList;
-    MoveGen::generate_pseudo_moves(position, moveList);
+    MoveGen::generate_legal(position, moveList);
+
+    // Every generated move is legal, so the last ply is just counted
+    if(depth == 1){
+        leafCounter += moveList.size;
+        return;
+    }
 
     for(int mIndx = 0; mIndx < moveList.size; ++mIndx){
         
         Move move = moveList.moves[mIndx];
-        if(!position.do_move(move)){
-            continue;
-        }
+        position.do_move(move);
         //std::cout << "\n" << "Sub-move:"<< algebraic_move(move);
         perft(position, depth-1);
         position.undo_move();
@@ -391,21 +700,20 @@ void perft(Position &position, DepthSize depth){
 NodesSize perftTest(Position &position, SearchInfo &searchInfo){
 
     clean_search_info(searchInfo);
+    searchInfo.timeManager.mark_start();
     leafCounter = 0;
     NodesSize allNodesCounter = 0;
     DepthSize actualDepth = searchInfo.depth-1;
 
     MoveGen::MoveList moveList;
-    MoveGen::generate_pseudo_moves(position, moveList);
+    MoveGen::generate_legal(position, moveList);
 
     std::cout << "\n";
     
     for(int mIndx = 0; mIndx < moveList.size;++mIndx){
 
         Move move = moveList.moves[mIndx];
-        if(!position.do_move(move)){
-            continue;
-        }
+        position.do_move(move);
 
         long cumnodes = leafCounter;
         perft(position, actualDepth);
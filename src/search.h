@@ -6,23 +6,41 @@
 #include "timemanager.h"
 
 #include <atomic>
+#include <cstddef>
 
 namespace Akerbeltz{
 
 class Position;
 
 namespace Search{
+
+    constexpr std::size_t DEFAULT_THREADS = 1;
+    constexpr std::size_t MIN_THREADS     = 1;
+    constexpr std::size_t MAX_THREADS     = 256;
+
     struct SearchInfo{
         DepthSize depth;
         NodesSize nodes;
+        NodesSize qsearchNodes;   // Part of nodes, this thread only
         DepthSize searchPly;
         Akerbeltz::TimeManager timeManager;
         std::atomic_bool stop;
+        bool infinite;            // "go infinite": bestmove only after stop
     };
 
     NodesSize perftTest(Position &position, SearchInfo &searchInfo);
     void search(Position &position, SearchInfo &searchInfo);
 
+    // search() on the long-lived main search thread. start_search returns at
+    // once; both the position and the info must outlive the search
+    void start_search(Position &position, SearchInfo &searchInfo);
+    void wait_search();
+
+    // Lazy SMP: the searching thread plus (threads - 1) helpers sharing the
+    // TT. The helpers are started here and sleep between searches
+    void set_threads(std::size_t threads);
+    std::size_t thread_count();
+
 }
 
 }
@@ -0,0 +1,1146 @@
+#include "tablebase.h"
+#include "attacks.h"
+#include "memory.h"
+#include "movegen.h"
+#include "parallel.h"
+#include "position.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace Akerbeltz {
+
+namespace Tablebase {
+
+    // ---------- Material signatures ----------
+    using Counts = int[PIECETYPE_SIZE];
+
+    // Order of the pieces after each king
+    constexpr PieceType CODE_ORDER[] = {QUEEN, ROOK, BISHOP, KNIGHT, PAWN};
+    constexpr int       CODE_VALUES[PIECETYPE_SIZE] = {0, 1, 3, 3, 5, 9, 0};
+
+    static std::string side_code(const Counts counts) {
+        std::string code = "K";
+        for (PieceType pieceType : CODE_ORDER)
+            code.append(counts[pieceType], PIECE_NAMES[make_piece(WHITE, pieceType)]);
+        return code;
+    }
+
+    static int side_value(const std::string &side) {
+        int value = 0;
+        for (char letter : side)
+            value += CODE_VALUES[piece_type(Piece(PIECE_NAMES.find(letter)))];
+        return value;
+    }
+
+    // The side the tables put as white: more material, then the larger code
+    static bool stronger(const std::string &a, const std::string &b) {
+        const int valueA = side_value(a), valueB = side_value(b);
+        return valueA != valueB ? valueA > valueB : a >= b;
+    }
+
+    static std::string join(const Counts white, const Counts black) {
+        const std::string a = side_code(white), b = side_code(black);
+        return stronger(a, b) ? a + b : b + a;
+    }
+
+    // Counts of the code's first (strong) and second side
+    static bool parse_code(const std::string &code, Counts counts[COLOR_SIZE]) {
+
+        std::string upper = code;
+        std::transform(upper.begin(), upper.end(), upper.begin(), [](char c) { return char(std::toupper(c)); });
+
+        const std::size_t weakStart = upper.find('K', 1);
+        if (upper.size() < std::size_t(MIN_PIECES) || upper.size() > std::size_t(MAX_PIECES)
+         || upper[0] != 'K' || weakStart == std::string::npos || upper.find('K', weakStart + 1) != std::string::npos)
+            return false;
+
+        std::memset(counts, 0, COLOR_SIZE * sizeof(Counts));
+        for (std::size_t i = 1; i < upper.size(); ++i) {
+            const std::size_t piece = PIECE_NAMES.find(upper[i]);
+            if (i == weakStart)
+                continue;
+            if (piece == std::string::npos || piece == W_KING || piece == NO_PIECE)
+                return false;
+            ++counts[i < weakStart ? WHITE : BLACK][piece];
+        }
+        return true;
+    }
+
+    std::string canonical_code(const std::string &code) {
+        Counts counts[COLOR_SIZE];
+        return parse_code(code, counts) ? join(counts[WHITE], counts[BLACK]) : std::string();
+    }
+
+    // Signatures one capture and/or promotion away
+    static std::vector<std::string> dependencies(const std::string &code) {
+
+        Counts counts[COLOR_SIZE];
+        parse_code(code, counts);
+        std::vector<std::string> codes;
+
+        auto add = [&](Counts changed[COLOR_SIZE]) {
+            const std::string dependency = join(changed[WHITE], changed[BLACK]);
+            if (dependency != "KK" && std::find(codes.begin(), codes.end(), dependency) == codes.end())
+                codes.push_back(dependency);
+        };
+
+        for (Color color : {WHITE, BLACK}) {
+            for (PieceType pieceType : CODE_ORDER) {
+                if (!counts[color][pieceType])
+                    continue;
+
+                Counts changed[COLOR_SIZE];
+                std::memcpy(changed, counts, sizeof(changed));
+                --changed[color][pieceType];
+                add(changed);
+
+                if (pieceType != PAWN)
+                    continue;
+
+                for (PieceType promoted : {QUEEN, ROOK, BISHOP, KNIGHT}) {
+                    ++changed[color][promoted];
+                    add(changed);
+                    // Capturing promotions
+                    for (PieceType captured : CODE_ORDER) {
+                        if (!changed[~color][captured])
+                            continue;
+                        --changed[~color][captured];
+                        add(changed);
+                        ++changed[~color][captured];
+                    }
+                    --changed[color][promoted];
+                }
+            }
+        }
+        return codes;
+    }
+
+    // ---------- Indexing ----------
+    struct Layout {
+        int         count;
+        Piece       pieces[MAX_PIECES];   // White king, black king, white pieces, black pieces
+        bool        pawns;
+        std::size_t size;
+    };
+
+    // White king squares of pawnless tables: the a1-d1-d4 triangle
+    constexpr Square64 TRIANGLE[10] = {SQ64_A1, SQ64_B1, SQ64_C1, SQ64_D1, SQ64_B2,
+                                       SQ64_C2, SQ64_D2, SQ64_C3, SQ64_D3, SQ64_D4};
+
+    constexpr int triangle_slot(Square64 square) {
+        const int file = square_file(square), rank = square_rank(square);
+        return rank == 0 ? file : rank == 1 ? 3 + file : rank == 2 ? 5 + file : 9;
+    }
+
+    inline Square64 flip_file(Square64 square)     { return Square64(square ^ 7); }
+    inline Square64 flip_rank(Square64 square)     { return Square64(square ^ 56); }
+    inline Square64 flip_diagonal(Square64 square) { return Square64(((square >> 3) | (square << 3)) & 63); }
+
+    // Pawns stand on a2-h7
+    inline int piece_squares(Piece piece) { return piece_type(piece) == PAWN ? 48 : SQ64_SIZE; }
+
+    static Layout make_layout(const std::string &code) {
+
+        Counts counts[COLOR_SIZE];
+        parse_code(code, counts);
+
+        Layout layout{2, {W_KING, B_KING}, false, 0};
+        for (Color color : {WHITE, BLACK})
+            for (PieceType pieceType : CODE_ORDER)
+                for (int n = 0; n < counts[color][pieceType]; ++n)
+                    layout.pieces[layout.count++] = make_piece(color, pieceType);
+
+        layout.pawns = counts[WHITE][PAWN] || counts[BLACK][PAWN];
+        layout.size  = 2 * (layout.pawns ? 32 : 10) * SQ64_SIZE;
+        for (int i = 2; i < layout.count; ++i)
+            layout.size *= piece_squares(layout.pieces[i]);
+        return layout;
+    }
+
+    // The white king goes to files a-d, and without pawns to the triangle
+    static std::size_t index(const Layout &layout, const Square64 *squares, Color stm) {
+
+        Square64 sq[MAX_PIECES];
+        std::copy(squares, squares + layout.count, sq);
+
+        if (square_file(sq[0]) > FILE_D)
+            std::transform(sq, sq + layout.count, sq, flip_file);
+        if (!layout.pawns) {
+            if (square_rank(sq[0]) > RANK_4)
+                std::transform(sq, sq + layout.count, sq, flip_rank);
+            if (int(square_rank(sq[0])) > int(square_file(sq[0])))
+                std::transform(sq, sq + layout.count, sq, flip_diagonal);
+        }
+
+        std::size_t idx = layout.pawns ? square_rank(sq[0]) * 4 + square_file(sq[0]) : triangle_slot(sq[0]);
+        idx = idx * SQ64_SIZE + sq[1];
+        for (int i = 2; i < layout.count; ++i)
+            idx = idx * piece_squares(layout.pieces[i]) + (piece_type(layout.pieces[i]) == PAWN ? sq[i] - 8 : sq[i]);
+        // Side to move last, so neighbouring entries tend to agree
+        return stm * (layout.size / 2) + idx;
+    }
+
+    static Color decode(const Layout &layout, std::size_t idx, Square64 *squares) {
+
+        const Color stm = idx < layout.size / 2 ? WHITE : BLACK;
+        idx %= layout.size / 2;
+
+        for (int i = layout.count - 1; i >= 2; --i) {
+            const int n = piece_squares(layout.pieces[i]);
+            squares[i] = Square64(idx % n + (n == 48 ? 8 : 0));
+            idx /= n;
+        }
+        squares[1] = Square64(idx % SQ64_SIZE);
+        idx /= SQ64_SIZE;
+        squares[0] = layout.pawns ? make_square64(Rank(idx / 4), File(idx % 4)) : TRIANGLE[idx];
+        return stm;
+    }
+
+    // ---------- Boards ----------
+    // Just the pieces, enough to generate moves on
+    struct Board {
+        int      count;
+        Piece    pieces[MAX_PIECES];
+        Square64 squares[MAX_PIECES];
+        Color    stm;
+    };
+
+    inline Bitboard occupancy(const Board &board) {
+        Bitboard occupied = 0;
+        for (int i = 0; i < board.count; ++i)
+            occupied |= ONE << board.squares[i];
+        return occupied;
+    }
+
+    inline Square64 king_square(const Board &board, Color color) {
+        for (int i = 0; i < board.count; ++i)
+            if (board.pieces[i] == make_piece(color, KING))
+                return board.squares[i];
+        return SQ64_NO_SQUARE;
+    }
+
+    inline Bitboard piece_attacks(Piece piece, Square64 square, Bitboard occupied) {
+        switch (piece_type(piece)) {
+            case PAWN:   return Attacks::pawnAttacks[piece_color(piece)][square];
+            case KNIGHT: return Attacks::knightAttacks[square];
+            case BISHOP: return Attacks::sliding_diagonal_attacks(square, occupied);
+            case ROOK:   return Attacks::sliding_side_attacks(square, occupied);
+            case QUEEN:  return Attacks::sliding_diagonal_attacks(square, occupied) | Attacks::sliding_side_attacks(square, occupied);
+            default:     return Attacks::kingAttacks[square];
+        }
+    }
+
+    static bool attacked(const Board &board, Square64 square, Color side, Bitboard occupied) {
+        for (int i = 0; i < board.count; ++i)
+            if (piece_color(board.pieces[i]) == side
+             && (piece_attacks(board.pieces[i], board.squares[i], occupied) & (ONE << square)))
+                return true;
+        return false;
+    }
+
+    // Distinct squares, kings apart and the side not to move not in check
+    static bool valid(const Board &board) {
+        Bitboard occupied = 0;
+        for (int i = 0; i < board.count; ++i) {
+            if (occupied & (ONE << board.squares[i]))
+                return false;
+            occupied |= ONE << board.squares[i];
+        }
+        return square_distance(king_square(board, WHITE), king_square(board, BLACK)) > 1
+            && !attacked(board, king_square(board, ~board.stm), board.stm, occupied);
+    }
+
+    inline bool in_check(const Board &board) {
+        return attacked(board, king_square(board, board.stm), ~board.stm, occupancy(board));
+    }
+
+    enum MoveKind {
+        REVERSIBLE,    // Stays in the table, DTZ keeps counting
+        PAWN_MOVE,     // Stays in the table, zeroing
+        DOUBLE_PUSH,   // Like PAWN_MOVE, may allow en passant
+        CONVERSION     // Capture or promotion: another table
+    };
+
+    // Calls fn(after, kind, to) for every legal move. Moves within the table
+    // keep the piece order, so the board indexes in the same layout.
+    template<typename Fn>
+    void for_each_move(const Board &board, Fn fn) {
+
+        const Color us = board.stm;
+        const Bitboard occupied = occupancy(board);
+        Bitboard own = 0;
+        for (int i = 0; i < board.count; ++i)
+            if (piece_color(board.pieces[i]) == us)
+                own |= ONE << board.squares[i];
+
+        for (int i = 0; i < board.count; ++i) {
+
+            const Piece piece = board.pieces[i];
+            if (piece_color(piece) != us)
+                continue;
+
+            const Square64 from = board.squares[i];
+            const bool pawn = piece_type(piece) == PAWN;
+            Bitboard targets;
+
+            if (pawn) {
+                const int forward = us == WHITE ? NORTH : SOUTH;
+                const Square64 push = Square64(int(from) + forward);
+                targets = Attacks::pawnAttacks[us][from] & occupied & ~own;
+                if (!(occupied & (ONE << push))) {
+                    targets |= ONE << push;
+                    const Square64 doublePush = Square64(int(push) + forward);
+                    if (square_rank(from) == (us == WHITE ? RANK_2 : RANK_7) && !(occupied & (ONE << doublePush)))
+                        targets |= ONE << doublePush;
+                }
+            }
+            else
+                targets = piece_attacks(piece, from, occupied) & ~own;
+
+            for (; targets; targets &= targets - 1) {
+
+                const Square64 to = Square64(Bitboards::ctz(targets));
+                Board after = board;
+                after.stm = ~us;
+                after.squares[i] = to;
+
+                MoveKind kind = !pawn ? REVERSIBLE : std::abs(to - from) == NORTH_NORTH ? DOUBLE_PUSH : PAWN_MOVE;
+                int moved = i;
+
+                if (occupied & ~own & (ONE << to)) {
+                    for (int j = 0; j < after.count; ++j) {
+                        if (j != i && after.squares[j] == to) {
+                            std::copy(after.pieces + j + 1, after.pieces + after.count, after.pieces + j);
+                            std::copy(after.squares + j + 1, after.squares + after.count, after.squares + j);
+                            --after.count;
+                            moved -= j < i;
+                            break;
+                        }
+                    }
+                    kind = CONVERSION;
+                }
+
+                if (attacked(after, king_square(after, us), ~us, occupancy(after)))
+                    continue;
+
+                if (pawn && (square_rank(to) == RANK_8 || square_rank(to) == RANK_1)) {
+                    for (PieceType promoted : {QUEEN, ROOK, BISHOP, KNIGHT}) {
+                        after.pieces[moved] = make_piece(us, promoted);
+                        fn(after, CONVERSION, to);
+                    }
+                }
+                else
+                    fn(after, kind, to);
+            }
+        }
+    }
+
+    // ---------- Files ----------
+    /*Table file: this header, blocks + 1 WDL offsets and blocks + 1 DTZ
+    offsets (uint64, from the start of each stream), then the WDL stream and
+    the DTZ stream. A WDL block holds the results of BLOCK_ENTRIES entries
+    as LEB128 runs of length << 2 | result. The DTZ block next to it holds
+    the DTZ of its won and lost entries, in order, Huffman coded with a code
+    of its own: the longest code length, the number of codes of each length
+    (LEB128), the symbols in code order (uint16) and the code bits, high bit
+    first. A block without won or lost entries is a single 0. Unreachable
+    positions join the run they are in, with the DTZ before them.
+    Little-endian.
+    */
+    struct FileHeader {
+        char     magic[8];
+        uint32_t version;
+        uint32_t blockEntries;
+        uint64_t entries;
+        char     code[8];
+    };
+
+    constexpr char        FILE_MAGIC[8] = {'A', 'K', 'B', 'Z', 'E', 'G', 'T', 'B'};
+    constexpr uint32_t    FILE_VERSION  = 2;
+    constexpr std::size_t BLOCK_ENTRIES = 1024;
+
+    // Codes of a block are shorter: a code of 15 bits takes more than
+    // BLOCK_ENTRIES symbols (Fibonacci weights)
+    constexpr int MAX_CODE_LENGTH = 16;
+
+    enum EntryResult : uint16_t {
+        ENTRY_DRAW,
+        ENTRY_WIN,
+        ENTRY_LOSS
+    };
+
+    // Unreachable positions; stored as whatever keeps runs long
+    constexpr uint16_t ENTRY_INVALID = 0xFFFF;
+    constexpr int      MAX_DTZ       = 0x3FFF;
+
+    inline ProbeResult decode_entry(uint16_t entry) {
+        const WDL wdl = (entry & 3) == ENTRY_WIN ? WDL_WIN : (entry & 3) == ENTRY_LOSS ? WDL_LOSS : WDL_DRAW;
+        return {wdl, entry >> 2};
+    }
+
+    static std::size_t get_varint(const uint8_t* &in) {
+        std::size_t value = 0;
+        for (int shift = 0; ; shift += 7) {
+            const uint8_t byte = *in++;
+            value |= std::size_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+    }
+
+    // Canonical Huffman decoding of a DTZ block, one symbol at a time
+    struct DtzReader {
+        int            maxLength;
+        int            counts[MAX_CODE_LENGTH + 1] = {};
+        const uint8_t* symbols;
+        const uint8_t* bits;
+        std::size_t    position = 0;
+
+        explicit DtzReader(const uint8_t* block) {
+            maxLength = std::min<int>(*block++, MAX_CODE_LENGTH);
+            for (int length = 1; length <= maxLength; ++length)
+                counts[length] = int(get_varint(block));
+            symbols = block;
+            for (int length = 1; length <= maxLength; ++length)
+                block += 2 * counts[length];
+            bits = block;
+        }
+
+        int next() {
+            int code = 0, first = 0, symbol = 0;
+            for (int length = 1; length <= maxLength; ++length) {
+                code |= (bits[position >> 3] >> (7 - (position & 7))) & 1;
+                ++position;
+                if (code - first < counts[length]) {
+                    const uint8_t* value = symbols + 2 * (symbol + code - first);
+                    return value[0] | (value[1] << 8);
+                }
+                symbol += counts[length];
+                first = (first + counts[length]) << 1;
+                code <<= 1;
+            }
+            return 0;
+        }
+    };
+
+    struct Table {
+        Layout             layout;
+        Memory::MappedFile file;
+        const uint64_t*    wdlOffsets{nullptr};
+        const uint64_t*    dtzOffsets{nullptr};
+        const uint8_t*     wdlData{nullptr};
+        const uint8_t*     dtzData{nullptr};
+        // Whole table decoded while other tables are generated from it
+        std::vector<uint16_t> expanded;
+
+        ~Table() { Memory::unmap_file(file); }
+
+        // Result of the entry; `decisive` counts the won and lost entries
+        // before it in its block
+        EntryResult result(std::size_t idx, std::size_t &decisive) const {
+
+            const uint8_t* run = wdlData + wdlOffsets[idx / BLOCK_ENTRIES];
+            std::size_t skip = idx % BLOCK_ENTRIES;
+            decisive = 0;
+            while (true) {
+                const std::size_t code = get_varint(run);
+                const EntryResult wdl = EntryResult(code & 3);
+                const std::size_t length = code >> 2;
+                if (skip < length) {
+                    decisive += wdl != ENTRY_DRAW ? skip : 0;
+                    return wdl;
+                }
+                skip -= length;
+                decisive += wdl != ENTRY_DRAW ? length : 0;
+            }
+        }
+
+        // DTZ << 2 | result; without DTZ only the result is decoded
+        uint16_t entry(std::size_t idx, bool withDtz = true) const {
+
+            if (!expanded.empty())
+                return expanded[idx];
+
+            std::size_t decisive;
+            const EntryResult wdl = result(idx, decisive);
+            if (wdl == ENTRY_DRAW || !withDtz)
+                return wdl;
+
+            DtzReader reader(dtzData + dtzOffsets[idx / BLOCK_ENTRIES]);
+            for (; decisive; --decisive)
+                reader.next();
+            return uint16_t(reader.next() << 2 | wdl);
+        }
+
+        void expand() {
+            if (!expanded.empty())
+                return;
+            std::vector<uint16_t> values(layout.size);
+            for (std::size_t begin = 0; begin < layout.size; begin += BLOCK_ENTRIES) {
+                const std::size_t end = std::min(layout.size, begin + BLOCK_ENTRIES);
+                const uint8_t* run = wdlData + wdlOffsets[begin / BLOCK_ENTRIES];
+                DtzReader reader(dtzData + dtzOffsets[begin / BLOCK_ENTRIES]);
+                for (std::size_t idx = begin; idx < end; ) {
+                    const std::size_t code = get_varint(run);
+                    const EntryResult wdl = EntryResult(code & 3);
+                    for (std::size_t length = code >> 2; length && idx < end; --length, ++idx)
+                        values[idx] = wdl == ENTRY_DRAW ? uint16_t(ENTRY_DRAW) : uint16_t(reader.next() << 2 | wdl);
+                }
+            }
+            expanded.swap(values);
+        }
+    };
+
+    std::unordered_map<std::string, std::unique_ptr<Table>> tables;
+
+    // Tables by the material key of either colouring, so probes find them
+    // without building signatures
+    struct MaterialSlot {
+        const Table* table;
+        bool         flip;   // Black holds the table's white pieces
+    };
+    std::unordered_map<Key, MaterialSlot> byMaterial;
+    int maxPieces  = 0;
+    int probeLimit = MAX_PIECES;
+
+    static std::string table_path(const std::string &directory, const std::string &code) {
+        return (std::filesystem::path(directory) / (code + FILE_EXTENSION)).string();
+    }
+
+    static std::unique_ptr<Table> load_table(const std::string &path) {
+
+        auto table = std::make_unique<Table>();
+        table->file = Memory::map_file(path);
+        const uint8_t* bytes = static_cast<const uint8_t*>(table->file.ptr);
+        if (!bytes || table->file.size < sizeof(FileHeader))
+            return nullptr;
+
+        FileHeader header;
+        std::memcpy(&header, bytes, sizeof(header));
+        header.code[sizeof(header.code) - 1] = '\0';
+
+        const std::string code = header.code;
+        if (std::memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) != 0
+         || header.version != FILE_VERSION || header.blockEntries != BLOCK_ENTRIES
+         || canonical_code(code) != code)
+            return nullptr;
+
+        table->layout = make_layout(code);
+        const std::size_t blocks = (table->layout.size + BLOCK_ENTRIES - 1) / BLOCK_ENTRIES;
+        const std::size_t dataStart = sizeof(FileHeader) + 2 * (blocks + 1) * sizeof(uint64_t);
+        if (header.entries != table->layout.size || table->file.size < dataStart)
+            return nullptr;
+
+        table->wdlOffsets = reinterpret_cast<const uint64_t*>(bytes + sizeof(FileHeader));
+        table->dtzOffsets = table->wdlOffsets + blocks + 1;
+        const std::size_t dataSize = table->file.size - dataStart;
+        if (table->wdlOffsets[blocks] > dataSize || table->dtzOffsets[blocks] != dataSize - table->wdlOffsets[blocks])
+            return nullptr;
+        for (std::size_t block = 0; block < blocks; ++block)
+            if (table->wdlOffsets[block] >= table->wdlOffsets[block + 1]
+             || table->dtzOffsets[block] >= table->dtzOffsets[block + 1])
+                return nullptr;
+
+        table->wdlData = bytes + dataStart;
+        table->dtzData = table->wdlData + table->wdlOffsets[blocks];
+        return table;
+    }
+
+    static void add_table(const std::string &code, std::unique_ptr<Table> table) {
+        const Layout &layout = table->layout;
+        Piece flipped[MAX_PIECES];
+        for (int i = 0; i < layout.count; ++i)
+            flipped[i] = make_piece(~piece_color(layout.pieces[i]), piece_type(layout.pieces[i]));
+
+        // Symmetric signatures end up with the unflipped slot
+        byMaterial[Position::material_key(flipped, layout.count)]       = {table.get(), true};
+        byMaterial[Position::material_key(layout.pieces, layout.count)] = {table.get(), false};
+
+        maxPieces = std::max(maxPieces, layout.count);
+        tables[code] = std::move(table);
+    }
+
+    static void put_varint(std::vector<uint8_t> &out, std::size_t value) {
+        for (; value >= 0x80; value >>= 7)
+            out.push_back(uint8_t(value | 0x80));
+        out.push_back(uint8_t(value));
+    }
+
+    // Huffman codes the DTZ of a block's won and lost entries; ties between
+    // weights go to the lower symbol, so files are reproducible
+    static void put_dtz_block(std::vector<uint8_t> &out, const std::vector<uint16_t> &dtz) {
+
+        if (dtz.empty()) {
+            out.push_back(0);
+            return;
+        }
+
+        std::map<uint16_t, std::size_t> frequency;
+        for (const uint16_t value : dtz)
+            ++frequency[value];
+
+        // Leaves in symbol order, then the inner nodes
+        using Node = std::pair<std::size_t, int>;
+        std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+        std::vector<int> parent(2 * frequency.size() - 1, -1);
+        int node = 0;
+        for (const auto &[value, count] : frequency)
+            queue.emplace(count, node++);
+        while (queue.size() > 1) {
+            const Node low = queue.top();
+            queue.pop();
+            const Node high = queue.top();
+            queue.pop();
+            parent[low.second] = parent[high.second] = node;
+            queue.emplace(low.first + high.first, node++);
+        }
+
+        // (length, symbol) in code order
+        std::vector<std::pair<int, uint16_t>> codes;
+        int leaf = 0;
+        for (const auto &[value, count] : frequency) {
+            int length = 0;
+            for (int n = leaf++; parent[n] >= 0; n = parent[n])
+                ++length;
+            codes.emplace_back(std::max(length, 1), value);
+        }
+        std::sort(codes.begin(), codes.end());
+
+        const int maxLength = codes.back().first;
+        out.push_back(uint8_t(maxLength));
+        for (int length = 1; length <= maxLength; ++length)
+            put_varint(out, std::size_t(std::count_if(codes.begin(), codes.end(),
+                                                      [&](const auto &code) { return code.first == length; })));
+        for (const auto &code : codes) {
+            out.push_back(uint8_t(code.second));
+            out.push_back(uint8_t(code.second >> 8));
+        }
+
+        std::map<uint16_t, std::pair<int, uint32_t>> canonical;
+        uint32_t next = 0;
+        int previous = 1;
+        for (const auto &[length, value] : codes) {
+            next <<= length - previous;
+            previous = length;
+            canonical[value] = {length, next++};
+        }
+
+        std::size_t position = 0;
+        for (const uint16_t value : dtz) {
+            const auto [length, code] = canonical[value];
+            for (int bit = length - 1; bit >= 0; --bit, ++position) {
+                if (!(position & 7))
+                    out.push_back(0);
+                out.back() |= uint8_t(((code >> bit) & 1) << (7 - (position & 7)));
+            }
+        }
+    }
+
+    static bool write_table(const std::string &path, const std::string &code, const std::vector<uint16_t> &entries) {
+
+        const std::size_t blocks = (entries.size() + BLOCK_ENTRIES - 1) / BLOCK_ENTRIES;
+        std::vector<uint64_t> wdlOffsets{0}, dtzOffsets{0};
+        std::vector<uint8_t> wdlData, dtzData;
+        std::vector<uint16_t> dtz;
+
+        for (std::size_t block = 0; block < blocks; ++block) {
+            const std::size_t begin = block * BLOCK_ENTRIES;
+            const std::size_t end   = std::min(entries.size(), begin + BLOCK_ENTRIES);
+
+            // Invalid entries join whichever run they are in
+            const auto firstValid = std::find_if(entries.begin() + begin, entries.begin() + end,
+                                                 [](uint16_t entry) { return entry != ENTRY_INVALID; });
+            uint16_t value = firstValid != entries.begin() + end ? *firstValid : uint16_t(ENTRY_DRAW);
+            uint16_t last  = value >> 2;
+            std::size_t length = 0;
+            dtz.clear();
+
+            for (std::size_t idx = begin; idx < end; ++idx) {
+                if (entries[idx] != ENTRY_INVALID) {
+                    if ((entries[idx] & 3) != (value & 3)) {
+                        put_varint(wdlData, length << 2 | (value & 3));
+                        value  = entries[idx];
+                        length = 0;
+                    }
+                    last = entries[idx] >> 2;
+                }
+                ++length;
+                if ((value & 3) != ENTRY_DRAW)
+                    dtz.push_back(last);
+            }
+            put_varint(wdlData, length << 2 | (value & 3));
+            put_dtz_block(dtzData, dtz);
+            wdlOffsets.push_back(wdlData.size());
+            dtzOffsets.push_back(dtzData.size());
+        }
+
+        FileHeader header{};
+        std::memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+        header.version      = FILE_VERSION;
+        header.blockEntries = BLOCK_ENTRIES;
+        header.entries      = entries.size();
+        std::memcpy(header.code, code.data(), code.size());
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(wdlOffsets.data()), std::streamsize(wdlOffsets.size() * sizeof(uint64_t)));
+        file.write(reinterpret_cast<const char*>(dtzOffsets.data()), std::streamsize(dtzOffsets.size() * sizeof(uint64_t)));
+        file.write(reinterpret_cast<const char*>(wdlData.data()), std::streamsize(wdlData.size()));
+        file.write(reinterpret_cast<const char*>(dtzData.data()), std::streamsize(dtzData.size()));
+        return bool(file);
+    }
+
+    // ---------- Probing ----------
+    inline Key material_key(const Board &board) { return Position::material_key(board.pieces, board.count); }
+
+    // Result for the side to move, looked up in the table of its material;
+    // DTZ is decoded only when asked for
+    static ProbeResult probe_board(const Board &board, Key materialKey, bool withDtz = true) {
+
+        if (board.count == 2)
+            return {WDL_DRAW, 0};
+
+        const auto it = byMaterial.find(materialKey);
+        if (it == byMaterial.end())
+            return {WDL_NONE, 0};
+
+        // Board pieces in table order, colours swapped when black is stronger
+        const bool flip = it->second.flip;
+        const Layout &layout = it->second.table->layout;
+        Square64 squares[MAX_PIECES];
+        bool used[MAX_PIECES] = {};
+        for (int k = 0; k < layout.count; ++k) {
+            const Piece wanted = flip ? make_piece(~piece_color(layout.pieces[k]), piece_type(layout.pieces[k]))
+                                      : layout.pieces[k];
+            for (int j = 0; j < board.count; ++j) {
+                if (!used[j] && board.pieces[j] == wanted) {
+                    used[j] = true;
+                    squares[k] = flip ? flip_rank(board.squares[j]) : board.squares[j];
+                    break;
+                }
+            }
+        }
+
+        return decode_entry(it->second.table->entry(index(layout, squares, flip ? ~board.stm : board.stm), withDtz));
+    }
+
+    // Legal en passant captures, like castling rights, are not in the tables
+    static bool has_enpassant_capture(const Position &position) {
+        MoveGen::MoveList moveList;
+        MoveGen::generate_legal(position, moveList);
+        for (int mIndx = 0; mIndx < moveList.size; ++mIndx)
+            if (move_special(moveList.moves[mIndx]) == ENPASSANT)
+                return true;
+        return false;
+    }
+
+    // An en passant square nobody can capture on is probed as cleared
+    static bool make_board(const Position &position, Board &board) {
+
+        if (position.get_castling_right() != NO_RIGHT
+         || Bitboards::cpop(position.get_occupied_bitboard(COLOR_NC)) > probe_limit()
+         || (position.get_enpassant_square() != SQ64_NO_SQUARE && has_enpassant_capture(position)))
+            return false;
+
+        board.count = 0;
+        board.stm = position.get_side_to_move();
+        for (Color color : {WHITE, BLACK})
+            for (int pieceType = PAWN; pieceType <= KING; ++pieceType)
+                for (Bitboard b = position.get_pieceTypes_bitboard(color, PieceType(pieceType)); b; b &= b - 1) {
+                    board.pieces[board.count]  = make_piece(color, PieceType(pieceType));
+                    board.squares[board.count] = Square64(Bitboards::ctz(b));
+                    ++board.count;
+                }
+        return true;
+    }
+
+    std::size_t init(const std::string &directory) {
+
+        byMaterial.clear();
+        tables.clear();
+        maxPieces = 0;
+
+        std::error_code error;
+        for (const auto &file : std::filesystem::directory_iterator(directory, error)) {
+            if (file.path().extension() != FILE_EXTENSION)
+                continue;
+            if (auto table = load_table(file.path().string())) {
+                const std::string code = file.path().stem().string();
+                if (code == canonical_code(code))
+                    add_table(code, std::move(table));
+            }
+        }
+        return tables.size();
+    }
+
+    int probe_limit() { return std::min(probeLimit, maxPieces); }
+
+    void set_probe_limit(int pieces) { probeLimit = std::clamp(pieces, 0, MAX_PIECES); }
+
+    ProbeResult probe(const Position &position) {
+        Board board;
+        return make_board(position, board) ? probe_board(board, position.get_material_key()) : ProbeResult{WDL_NONE, 0};
+    }
+
+    WDL probe_wdl(const Position &position) {
+        Board board;
+        return make_board(position, board) ? probe_board(board, position.get_material_key(), false).wdl : WDL_NONE;
+    }
+
+    Move root_move(Position &position, ProbeResult &result) {
+
+        result = probe(position);
+        if (result.wdl == WDL_NONE)
+            return NOMOVE;
+
+        MoveGen::MoveList moveList;
+        MoveGen::generate_pseudo_moves(position, moveList);
+
+        Move bestMove = NOMOVE;
+        int bestRank = INT_MIN;
+
+        for (int mIndx = 0; mIndx < moveList.size; ++mIndx) {
+
+            const Move move = moveList.moves[mIndx];
+            const bool zeroing = is_capture(move) || piece_type(position.get_mailbox_piece(move_from(move))) == PAWN;
+            if (!position.do_move(move))
+                continue;
+            const ProbeResult after = probe(position);
+            position.undo_move();
+
+            // En passant capture open after a double push
+            if (after.wdl == WDL_NONE)
+                continue;
+
+            // Shortest win, longest loss
+            const int plies = zeroing ? 1 : after.dtz + 1;
+            const int rank = after.wdl == WDL_LOSS ? 2 * MAX_DTZ - plies : after.wdl == WDL_DRAW ? 0 : plies - 2 * MAX_DTZ;
+            if (rank > bestRank) {
+                bestRank = rank;
+                bestMove = move;
+            }
+        }
+        return bestMove;
+    }
+
+    // ---------- Generation ----------
+    enum State : uint8_t {
+        S_INVALID,
+        S_UNKNOWN,
+        S_LOSS,
+        S_DRAW,
+        S_WIN
+    };
+
+    inline State to_state(WDL wdl) { return wdl == WDL_WIN ? S_WIN : wdl == WDL_LOSS ? S_LOSS : S_DRAW; }
+
+    inline State negate(State state) { return state == S_WIN ? S_LOSS : state == S_LOSS ? S_WIN : state; }
+
+    // Working entry during generation: DTZ << 3 | state
+    constexpr int WORK_MAX_DTZ = 0x1FFF;
+
+    inline State    work_state(uint16_t work) { return State(work & 7); }
+    inline int      work_dtz(uint16_t work)   { return work >> 3; }
+    inline uint16_t make_work(State state, int dtz) { return uint16_t(std::min(dtz, WORK_MAX_DTZ) << 3 | state); }
+
+    // Entries of the frontier being expanded change under other threads
+    inline uint16_t load_work(std::vector<uint16_t> &work, std::size_t idx) {
+        return std::atomic_ref<uint16_t>(work[idx]).load(std::memory_order_relaxed);
+    }
+
+    inline bool settle(std::vector<uint16_t> &work, std::size_t idx, uint16_t expected, uint16_t settled) {
+        return std::atomic_ref<uint16_t>(work[idx]).compare_exchange_strong(expected, settled, std::memory_order_relaxed);
+    }
+
+    inline State conversion_state(const Board &after) {
+        return negate(to_state(probe_board(after, material_key(after), false).wdl));
+    }
+
+    // Best en passant capture for the side to move after a double push to
+    // `to`, from its point of view; S_INVALID when there is none
+    static State en_passant(const Board &board, Square64 to) {
+
+        const Color us = board.stm;
+        const Square64 passed = Square64(int(to) + (us == WHITE ? NORTH : SOUTH));
+        State best = S_INVALID;
+
+        for (int i = 0; i < board.count; ++i) {
+            if (board.pieces[i] != make_piece(us, PAWN) || !(Attacks::pawnAttacks[us][board.squares[i]] & (ONE << passed)))
+                continue;
+
+            Board after = board;
+            after.stm = ~us;
+            after.squares[i] = passed;
+            for (int j = 0; j < after.count; ++j) {
+                if (after.squares[j] == to) {
+                    std::copy(after.pieces + j + 1, after.pieces + after.count, after.pieces + j);
+                    std::copy(after.squares + j + 1, after.squares + after.count, after.squares + j);
+                    --after.count;
+                    break;
+                }
+            }
+            if (!attacked(after, king_square(after, us), ~us, occupancy(after)))
+                best = std::max(best, conversion_state(after));
+        }
+        return best;
+    }
+
+    // Result for the side to move of a pawn move within the table. It lands
+    // on a more advanced pawn level, already solved: unsettled means drawn.
+    static State pawn_move_state(const Layout &layout, const Board &after, MoveKind kind, Square64 to,
+                                 const std::vector<uint16_t> &work) {
+        State theirs = work_state(work[index(layout, after.squares, after.stm)]);
+        if (theirs == S_UNKNOWN)
+            theirs = S_DRAW;
+        if (kind == DOUBLE_PUSH)
+            theirs = std::max(theirs, en_passant(after, to));
+        return negate(theirs);
+    }
+
+    // Sum of the pawns' advances: every pawn move within the table raises it
+    static int pawn_level(const Board &board) {
+        int level = 0;
+        for (int i = 0; i < board.count; ++i)
+            if (piece_type(board.pieces[i]) == PAWN)
+                level += piece_color(board.pieces[i]) == WHITE ? square_rank(board.squares[i])
+                                                               : RANK_8 - square_rank(board.squares[i]);
+        return level;
+    }
+
+    // Calls fn(before) for every board whose side to move reaches this one by
+    // a move staying in the table and keeping its pawn level: a piece other
+    // than a pawn stepping back to an empty square. Whether `before` is a
+    // legal position is left to the caller.
+    template<typename Fn>
+    void for_each_unmove(const Board &board, Fn fn) {
+
+        const Color them = ~board.stm;
+        const Bitboard occupied = occupancy(board);
+
+        for (int i = 0; i < board.count; ++i) {
+            const Piece piece = board.pieces[i];
+            if (piece_color(piece) != them || piece_type(piece) == PAWN)
+                continue;
+
+            for (Bitboard from = piece_attacks(piece, board.squares[i], occupied) & ~occupied; from; from &= from - 1) {
+                Board before = board;
+                before.stm = them;
+                before.squares[i] = Square64(Bitboards::ctz(from));
+                fn(before);
+            }
+        }
+    }
+
+    static Board layout_board(const Layout &layout, std::size_t idx) {
+        Board board;
+        board.count = layout.count;
+        std::copy(layout.pieces, layout.pieces + layout.count, board.pieces);
+        board.stm = decode(layout, idx, board.squares);
+        return board;
+    }
+
+    // Every move of the board loses, its moves within the level reaching
+    // positions won in at most `dtz` plies
+    static bool all_moves_lose(const Layout &layout, const Board &board, int dtz, std::vector<uint16_t> &work) {
+        bool lost = true;
+        for_each_move(board, [&](const Board &after, MoveKind kind, Square64 to) {
+            if (!lost)
+                return;
+            if (kind == REVERSIBLE) {
+                const uint16_t succ = load_work(work, index(layout, after.squares, after.stm));
+                lost = work_state(succ) == S_WIN && work_dtz(succ) <= dtz;
+            }
+            else
+                lost = (kind == CONVERSION ? conversion_state(after) : pawn_move_state(layout, after, kind, to, work)) == S_LOSS;
+        });
+        return lost;
+    }
+
+    /*Retrograde analysis. Pawn moves only go forward, so the table is solved
+    one pawn level at a time, most advanced first, and the pawn moves of a
+    level lead to positions already solved. Within a level, mates are the
+    DTZ 0 frontier, and positions whose captures, promotions or pawn moves
+    settle them are the DTZ 1 frontier. The frontier at DTZ d settles the
+    next one through un-moves: whoever can move into a lost position wins
+    in d + 1, and whoever moves into a won one loses in d + 1 once all its
+    moves lose. What is left unsettled is drawn. Each index holds its state
+    and DTZ in 16 bits; frontiers are index lists, split across threads.
+    */
+    static std::vector<uint16_t> build(const std::string &code, std::size_t threads, int &plies) {
+
+        const Layout layout = make_layout(code);
+        std::vector<uint16_t> work(layout.size, make_work(S_INVALID, 0));
+        std::mutex frontierMutex;
+        plies = 0;
+
+        int maxLevel = 0;
+        for (int i = 2; i < layout.count; ++i)
+            maxLevel += piece_type(layout.pieces[i]) == PAWN ? RANK_7 : 0;
+
+        for (int level = maxLevel; level >= 0; --level) {
+
+            // Frontiers at DTZ d and d + 1
+            std::vector<uint32_t> frontier, next;
+
+            Parallel::for_each_slice(layout.size, threads, [&](std::size_t begin, std::size_t end) {
+                std::vector<uint32_t> mates, zeroing;
+                for (std::size_t idx = begin; idx < end; ++idx) {
+                    const Board board = layout_board(layout, idx);
+                    if (pawn_level(board) != level || !valid(board))
+                        continue;
+
+                    bool anyMove = false, reversible = false;
+                    State zeroingBest = S_INVALID;
+                    for_each_move(board, [&](const Board &after, MoveKind kind, Square64 to) {
+                        anyMove = true;
+                        if (kind == REVERSIBLE)
+                            reversible = true;
+                        else if (zeroingBest != S_WIN)
+                            zeroingBest = std::max(zeroingBest, kind == CONVERSION ? conversion_state(after)
+                                                                                   : pawn_move_state(layout, after, kind, to, work));
+                    });
+
+                    if (!anyMove) {
+                        work[idx] = make_work(in_check(board) ? S_LOSS : S_DRAW, 0);
+                        if (in_check(board))
+                            mates.push_back(uint32_t(idx));
+                    }
+                    else if (zeroingBest == S_WIN || (!reversible && zeroingBest == S_LOSS)) {
+                        work[idx] = make_work(zeroingBest, 1);
+                        zeroing.push_back(uint32_t(idx));
+                    }
+                    else
+                        work[idx] = make_work(reversible ? S_UNKNOWN : S_DRAW, 0);
+                }
+
+                std::lock_guard<std::mutex> lock(frontierMutex);
+                frontier.insert(frontier.end(), mates.begin(), mates.end());
+                next.insert(next.end(), zeroing.begin(), zeroing.end());
+                return std::size_t(0);
+            });
+
+            for (int dtz = 0; !frontier.empty() || !next.empty(); ++dtz) {
+
+                Parallel::for_each_slice(frontier.size(), threads, [&](std::size_t begin, std::size_t end) {
+                    std::vector<uint32_t> settled;
+                    for (std::size_t f = begin; f < end; ++f) {
+                        const Board board = layout_board(layout, frontier[f]);
+                        const bool lost = work_state(work[frontier[f]]) == S_LOSS;
+
+                        auto visit = [&](const Board &before) {
+                            const std::size_t idx = index(layout, before.squares, before.stm);
+                            const uint16_t current = load_work(work, idx);
+                            if (work_state(current) != S_UNKNOWN)
+                                return;
+                            if (lost ? settle(work, idx, current, make_work(S_WIN, dtz + 1))
+                                     : all_moves_lose(layout, layout_board(layout, idx), dtz, work)
+                                       && settle(work, idx, current, make_work(S_LOSS, dtz + 1)))
+                                settled.push_back(uint32_t(idx));
+                        };
+
+                        // Without pawns a king on the diagonal leaves the mirror
+                        // image a separate index, reached by its own un-moves
+                        for_each_unmove(board, visit);
+                        if (!layout.pawns) {
+                            Board mirrored = board;
+                            std::transform(board.squares, board.squares + board.count, mirrored.squares, flip_diagonal);
+                            for_each_unmove(mirrored, visit);
+                        }
+                    }
+
+                    std::lock_guard<std::mutex> lock(frontierMutex);
+                    next.insert(next.end(), settled.begin(), settled.end());
+                    return std::size_t(0);
+                });
+
+                frontier.swap(next);
+                next.clear();
+                plies = std::max(plies, dtz);
+            }
+        }
+
+        // Working entries become file entries in place
+        for (uint16_t &entry : work) {
+            const State state = work_state(entry);
+            const int dtz = std::min(work_dtz(entry), MAX_DTZ);
+            entry = state == S_INVALID ? ENTRY_INVALID
+                  : state == S_WIN     ? uint16_t(dtz << 2 | ENTRY_WIN)
+                  : state == S_LOSS    ? uint16_t(dtz << 2 | ENTRY_LOSS)
+                  : uint16_t(ENTRY_DRAW);
+        }
+        return work;
+    }
+
+    // Loads the table from the directory or generates it, its dependencies first
+    static bool ensure_table(const std::string &code, const std::string &directory, std::size_t threads) {
+
+        if (tables.count(code))
+            return true;
+
+        const std::string path = table_path(directory, code);
+        if (auto table = load_table(path)) {
+            add_table(code, std::move(table));
+            return true;
+        }
+
+        for (const std::string &dependency : dependencies(code)) {
+            if (!ensure_table(dependency, directory, threads))
+                return false;
+            tables[dependency]->expand();
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        int plies = 0;
+        const std::vector<uint16_t> entries = build(code, threads, plies);
+
+        if (!write_table(path, code, entries)) {
+            std::cout << "Could not write " << path << std::endl;
+            return false;
+        }
+
+        auto table = load_table(path);
+        if (!table)
+            return false;
+
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << code << ": " << entries.size() << " positions, DTZ up to " << plies << ", "
+                  << table->file.size << " bytes, " << ms.count() << " ms" << std::endl;
+
+        add_table(code, std::move(table));
+        return true;
+    }
+
+    bool generate(const std::string &code, const std::string &directory, std::size_t threads) {
+
+        const std::string canonical = canonical_code(code);
+        if (canonical.empty()) {
+            std::cout << "Unsupported material " << code << " (3 to 5 pieces, like KRPKR)" << std::endl;
+            return false;
+        }
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+
+        const bool generated = ensure_table(canonical, directory, Parallel::resolve_threads(threads));
+        for (auto &table : tables)
+            std::vector<uint16_t>().swap(table.second->expanded);
+        return generated;
+    }
+
+} // namespace Tablebase
+
+} // namespace Akerbeltz
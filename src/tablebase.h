@@ -0,0 +1,72 @@
+#ifndef INCLUDE_TABLEBASE_H
+#define INCLUDE_TABLEBASE_H
+
+#include "types.h"
+#include "evaluate.h"
+#include "move.h"
+
+#include <cstddef>
+#include <string>
+
+namespace Akerbeltz{
+
+class Position;
+
+namespace Tablebase{
+
+    /*Endgame tablebases of 3 to 5 pieces, generated offline by the engine
+    ("Akerbeltz tbgen KRPKR"). One file per material signature, with the
+    stronger side as white, holds for every position the result for the
+    side to move and its DTZ: plies to the next capture or pawn move with
+    best play. Castling, en passant rights of the probed position and the
+    fifty-move rule are not part of the tables.
+    */
+    constexpr int MIN_PIECES = 3;
+    constexpr int MAX_PIECES = 5;
+
+    constexpr const char* FILE_EXTENSION = ".aktb";
+
+    // Above every evaluation, below every mate the search finds
+    constexpr Evaluate::Score TB_WIN_SCORE = Evaluate::CHECKMATE_SCORE - 2 * MAX_DEPTH;
+
+    enum WDL : int{
+        WDL_LOSS = -1,
+        WDL_DRAW =  0,
+        WDL_WIN  =  1,
+        WDL_NONE =  2   // Not covered by the loaded tables
+    };
+
+    struct ProbeResult{
+        WDL wdl;
+        int dtz;   // 0 when drawn or mated
+    };
+
+    // Loads every table in the directory, dropping the loaded ones;
+    // returns how many were loaded
+    std::size_t init(const std::string &directory);
+
+    // Builds the table of a signature like "KRPKR" by retrograde analysis
+    // on all cores (0 threads), first building or loading the tables it
+    // converts into. Tables are written to, and reused from, the directory.
+    bool generate(const std::string &code, const std::string &directory, std::size_t threads = 0);
+
+    // Signature in table order ("kpk" -> "KPK", "KRKQ" -> "KQKR"), empty
+    // when malformed or outside 3-5 pieces
+    std::string canonical_code(const std::string &code);
+
+    // Search probes positions with at most this many pieces
+    int probe_limit();
+    void set_probe_limit(int pieces);
+
+    ProbeResult probe(const Position &position);
+    WDL probe_wdl(const Position &position);
+
+    // Move keeping the result with the best DTZ, NOMOVE when the position
+    // is not in the tables
+    Move root_move(Position &position, ProbeResult &result);
+
+} // namespace Tablebase
+
+} // namespace Akerbeltz
+
+#endif // #ifndef INCLUDE_TABLEBASE_H
@@ -1,18 +1,82 @@
 #include "ttable.h"
+#include "memory.h"
+#include "movegen.h"
+#include "parallel.h"
 #include "position.h"
 
 #include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
 #include <vector>
 
 namespace Akerbeltz {
 
 namespace TT {
 
+    /*Packed entry (10 bytes):
+    check    16 bits -> key bits 0-15 XOR the other fields
+    move     16 bits -> PackedMove
+    score    16 bits
+    eval     16 bits -> static evaluation
+    depth     8 bits
+    genBound  8 bits -> generation (6 bits) << 2 | flag (2 bits)
+
+    Folding the data into the key check lets a probe reject an entry torn
+    by concurrent writers. The fields are relaxed atomics, and hash moves
+    are still validated against the position before being played.
+    */
+    constexpr int     GEN_BITS = 6;
+    constexpr uint8_t GEN_MASK = (1 << GEN_BITS) - 1;
+
+    struct PackedEntry {
+        std::atomic<uint16_t> check;
+        std::atomic<uint16_t> move;
+        std::atomic<int16_t>  score;
+        std::atomic<int16_t>  eval;
+        std::atomic<uint8_t>  depth;
+        std::atomic<uint8_t>  genBound;
+    };
+
+    struct alignas(32) Bucket {
+        PackedEntry entries[BUCKET_ENTRIES];
+        char padding[2];
+    };
+
+    static_assert(sizeof(PackedEntry) == 10, "TT entry must pack to 10 bytes");
+    static_assert(sizeof(Bucket) == 32, "TT bucket must be half a cache line");
+
+    /*Table file: this header followed by the raw buckets, in native byte
+    order. Bump FILE_VERSION whenever the entry layout changes.
+    */
+    struct FileHeader {
+        char     magic[8];
+        uint32_t version;
+        uint32_t bucketBytes;
+        uint64_t bucketCount;
+        uint8_t  generation;
+        uint8_t  reserved[7];
+    };
+
+    constexpr char        FILE_MAGIC[8] = {'A', 'K', 'B', 'Z', 'H', 'A', 'S', 'H'};
+    constexpr uint32_t    FILE_VERSION  = 1;
+    constexpr std::size_t FILE_IO_BYTES = 16 * 1024 * 1024;
+
     std::size_t clamp_mb(std::size_t sizeMB);
-    std::size_t entry_count(std::size_t sizeMB);
+    std::size_t bucket_count(std::size_t sizeMB);
+    Move find_pseudo_move(const Position& pos, Move move);
 
     std::size_t ttSizeMB = TT::DEFAULT_TT_MB;
-    std::vector<Entry> table(entry_count(ttSizeMB));
+    Memory::LargeAllocation tableMemory;
+    Bucket*     table     = nullptr;
+    std::size_t tableSize = 0;
+    bool        numaInterleave = false;
+    uint8_t     ttGeneration = 0;
+
+    [[maybe_unused]] const bool tableAllocated = (resize(TT::DEFAULT_TT_MB), true);
 
     constexpr std::size_t mb_to_bytes(std::size_t mb) { return mb * 1024ULL * 1024ULL; }
 
@@ -22,48 +86,280 @@ namespace TT {
         return sizeMB;
     }
 
-    std::size_t entry_count(std::size_t sizeMB) {
+    std::size_t bucket_count(std::size_t sizeMB) {
         const auto bytes = mb_to_bytes(sizeMB);
-        return std::max<std::size_t>(1, bytes / sizeof(Entry));
+        return std::max<std::size_t>(1, bytes / sizeof(Bucket));
+    }
+
+    // The bucket index comes from the high bits of the key, so the check
+    // uses the low bits to stay independent of it
+    inline uint16_t key_check(Key key) { return uint16_t(key); }
+
+    //GCC/Clang
+    #if defined(__clang__) || defined(__GNUC__)
+
+    __extension__ typedef unsigned __int128 uint128;
+
+    inline uint64_t mul_hi(uint64_t a, uint64_t b) { return uint64_t((uint128(a) * b) >> 64); }
+
+    inline void prefetch_address(const void* addr) { __builtin_prefetch(addr); }
+
+    //For other compilers, portable multiply-high and no prefetch
+    #else
+
+    inline uint64_t mul_hi(uint64_t a, uint64_t b) {
+        const uint64_t aLo = uint32_t(a), aHi = a >> 32;
+        const uint64_t bLo = uint32_t(b), bHi = b >> 32;
+        const uint64_t mid = (aLo * bLo >> 32) + uint32_t(aHi * bLo) + aLo * bHi;
+        return aHi * bHi + (aHi * bLo >> 32) + (mid >> 32);
+    }
+
+    inline void prefetch_address(const void*) {}
+
+    #endif
+
+    inline uint16_t fold(uint16_t move, int16_t score, int16_t eval, uint8_t depth, uint8_t genBound) {
+        return move ^ uint16_t(score) ^ uint16_t(eval) ^ uint16_t(depth | (genBound << 8));
     }
 
-    void resize(std::size_t sizeMB) {
+    // Entries written in older searches lose value as the generation advances
+    inline int replace_value(uint8_t depth, uint8_t genBound) {
+        const uint8_t age = (ttGeneration - (genBound >> 2)) & GEN_MASK;
+        return depth - 8 * age;
+    }
+
+    // Swaps in a new, untouched table of sizeMB
+    bool allocate(std::size_t sizeMB) {
         ttSizeMB = clamp_mb(sizeMB);
-        table.assign(entry_count(ttSizeMB), Entry{});
+
+        Memory::free_large(tableMemory);
+        table = nullptr;
+        tableSize = 0;
+
+        const std::size_t buckets = bucket_count(ttSizeMB);
+        tableMemory = Memory::alloc_large(buckets * sizeof(Bucket), numaInterleave);
+        if (!tableMemory.ptr) return false;
+
+        table = static_cast<Bucket*>(tableMemory.ptr);
+        tableSize = buckets;
+        return true;
+    }
+
+    void resize(std::size_t sizeMB, std::size_t threads) {
+        // Fresh pages are first touched by clear(), by the same number of
+        // threads that will search, so they spread over the threads' nodes
+        if (allocate(sizeMB))
+            clear(threads);
     }
 
+    void set_numa_interleave(bool interleave) { numaInterleave = interleave; }
+
+    Memory::PageMode page_mode() { return tableMemory.mode; }
+
+    bool numa_interleaved() { return tableMemory.interleaved; }
+
     std::size_t current_size_mb() { return ttSizeMB; }
 
-    void clear() {
-        std::fill(table.begin(), table.end(), Entry{});
+    std::size_t bucket_count() { return tableSize; }
+
+    // Maps the key onto [0, tableSize) with a multiply-high (Lemire's
+    // fastrange) instead of a 64-bit division, for any table size
+    std::size_t bucket_index(Key key) { return std::size_t(mul_hi(key, tableSize)); }
+
+    void prefetch(Key key) {
+        if (tableSize) prefetch_address(table + bucket_index(key));
+    }
+
+    void clear(std::size_t threads) {
+
+        Parallel::for_each_slice(tableSize, std::max<std::size_t>(threads, 1), [](std::size_t begin, std::size_t end) {
+            std::memset(static_cast<void*>(table + begin), 0, (end - begin) * sizeof(Bucket));
+            return std::size_t{0};
+        });
+
+        ttGeneration = 0;
     }
 
+    void new_search() { ttGeneration = (ttGeneration + 1) & GEN_MASK; }
+
+    uint8_t generation() { return ttGeneration; }
+
     bool probe(Key key, Entry &outEntry) {
-        if (table.empty()) return false;
+        if (!tableSize) return false;
+
+        Bucket &bucket = table[bucket_index(key)];
 
-        std::size_t index = key % table.size();
-        Entry &e = table[index];
+        for (PackedEntry &e : bucket.entries) {
+            const uint8_t genBound = e.genBound.load(std::memory_order_relaxed);
+            if (genBound == 0) continue;
 
-        if (e.key == 0 || e.key != key)
+            const uint16_t move  = e.move.load(std::memory_order_relaxed);
+            const int16_t  score = e.score.load(std::memory_order_relaxed);
+            const int16_t  eval  = e.eval.load(std::memory_order_relaxed);
+            const uint8_t  depth = e.depth.load(std::memory_order_relaxed);
+
+            if ((e.check.load(std::memory_order_relaxed) ^ fold(move, score, eval, depth, genBound)) != key_check(key))
+                continue;
+
+            outEntry.key   = key;
+            outEntry.score = score;
+            outEntry.depth = depth;
+            outEntry.flag  = Flag(genBound & 0x3);
+            outEntry.move  = unpack_move(move);
+            outEntry.eval  = eval;
+            outEntry.age   = genBound >> 2;
+            return true;
+        }
+        return false;
+    }
+
+    void store(Key key, DepthSize depth, Score score, Flag flag, Move bestMove, Score eval) {
+        if (!tableSize) return;
+
+        Bucket &bucket = table[bucket_index(key)];
+        const uint16_t check = key_check(key);
+
+        PackedEntry *victim = &bucket.entries[0];
+        int victimValue = INT32_MAX;
+        uint16_t move = pack_move(bestMove);
+
+        for (PackedEntry &e : bucket.entries) {
+            const uint8_t genBound = e.genBound.load(std::memory_order_relaxed);
+
+            if (genBound == 0) {
+                victim = &e;
+                break;
+            }
+
+            const uint16_t oldMove  = e.move.load(std::memory_order_relaxed);
+            const uint8_t  oldDepth = e.depth.load(std::memory_order_relaxed);
+            const uint16_t oldCheck = e.check.load(std::memory_order_relaxed)
+                                    ^ fold(oldMove, e.score.load(std::memory_order_relaxed),
+                                           e.eval.load(std::memory_order_relaxed), oldDepth, genBound);
+
+            if (oldCheck == check) {
+                // Same position: keep a deeper result from this search, only
+                // adding the static eval it lacks
+                if (oldDepth > depth && (genBound >> 2) == ttGeneration && flag != FLAG_EXACT) {
+                    if (eval == NO_EVAL || e.eval.load(std::memory_order_relaxed) != NO_EVAL)
+                        return;
+                    depth    = oldDepth;
+                    score    = e.score.load(std::memory_order_relaxed);
+                    flag     = Flag(genBound & 0x3);
+                    bestMove = NOMOVE;
+                }
+                if (bestMove == NOMOVE)
+                    move = oldMove;
+                if (eval == NO_EVAL)
+                    eval = e.eval.load(std::memory_order_relaxed);
+                victim = &e;
+                break;
+            }
+
+            const int value = replace_value(oldDepth, genBound);
+            if (value < victimValue) {
+                victim = &e;
+                victimValue = value;
+            }
+        }
+
+        const int16_t  newScore    = int16_t(std::clamp<Score>(score, INT16_MIN + 1, INT16_MAX));
+        const int16_t  newEval     = int16_t(std::clamp<Score>(eval, INT16_MIN, INT16_MAX));
+        const uint8_t  newDepth    = uint8_t(std::min<DepthSize>(depth, 0xFF));
+        const uint8_t  newGenBound = uint8_t((ttGeneration << 2) | flag);
+
+        victim->move.store(move, std::memory_order_relaxed);
+        victim->score.store(newScore, std::memory_order_relaxed);
+        victim->eval.store(newEval, std::memory_order_relaxed);
+        victim->depth.store(newDepth, std::memory_order_relaxed);
+        victim->genBound.store(newGenBound, std::memory_order_relaxed);
+        victim->check.store(check ^ fold(move, newScore, newEval, newDepth, newGenBound), std::memory_order_relaxed);
+    }
+
+    bool save(const std::string &path) {
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file || !tableSize) return false;
+
+        FileHeader header{};
+        std::memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+        header.version     = FILE_VERSION;
+        header.bucketBytes = sizeof(Bucket);
+        header.bucketCount = tableSize;
+        header.generation  = ttGeneration;
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        const char* data = reinterpret_cast<const char*>(table);
+        const std::size_t bytes = tableSize * sizeof(Bucket);
+        for (std::size_t offset = 0; offset < bytes && file; offset += FILE_IO_BYTES)
+            file.write(data + offset, std::streamsize(std::min(FILE_IO_BYTES, bytes - offset)));
+
+        return bool(file.flush());
+    }
+
+    bool load(const std::string &path, std::size_t threads) {
+
+        std::ifstream file(path, std::ios::binary);
+        FileHeader header{};
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+            return false;
+
+        if (std::memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) != 0
+         || header.version != FILE_VERSION
+         || header.bucketBytes != sizeof(Bucket))
+            return false;
+
+        // Only tables of a whole, valid number of MB can be restored
+        const uint64_t bytes  = header.bucketCount * sizeof(Bucket);
+        const uint64_t sizeMB = bytes / mb_to_bytes(1);
+        if (bytes % mb_to_bytes(1) || clamp_mb(sizeMB) != sizeMB)
+            return false;
+
+        file.seekg(0, std::ios::end);
+        if (uint64_t(file.tellg()) != sizeof(header) + bytes)
+            return false;
+        file.close();
+
+        if (!allocate(sizeMB))
+            return false;
+
+        // Each thread reads (and first touches) its own slice of the table
+        std::atomic<bool> ok{true};
+        Parallel::for_each_slice(tableSize, std::max<std::size_t>(threads, 1), [&](std::size_t begin, std::size_t end) {
+            std::ifstream part(path, std::ios::binary);
+            part.seekg(std::streamoff(sizeof(header) + begin * sizeof(Bucket)));
+
+            char* data = reinterpret_cast<char*>(table + begin);
+            const std::size_t partBytes = (end - begin) * sizeof(Bucket);
+            for (std::size_t offset = 0; offset < partBytes && part; offset += FILE_IO_BYTES)
+                part.read(data + offset, std::streamsize(std::min(FILE_IO_BYTES, partBytes - offset)));
+
+            if (!part) ok = false;
+            return std::size_t{0};
+        });
+
+        if (!ok) {
+            clear(threads);
             return false;
+        }
 
-        outEntry = e;
+        ttGeneration = header.generation & GEN_MASK;
         return true;
     }
 
-    void store(Key key, DepthSize depth, Score score, Flag flag, Move bestMove) {
-        if (table.empty()) return;
+    Move find_pseudo_move(const Position& pos, Move move) {
 
-        std::size_t index = key % table.size();
-        Entry &e = table[index];
+        if (move == NOMOVE) return NOMOVE;
 
-        if (e.depth > depth && (e.key == key || e.key != 0)) return;
+        MoveGen::MoveList moveList;
+        MoveGen::generate_pseudo_moves(pos, moveList);
 
-        e.key   = key;
-        e.depth = depth;
-        e.flag  = flag;
-        e.move  = raw_move(bestMove);
-        e.score = score;
+        for (int mIndx = 0; mIndx < moveList.size; ++mIndx) {
+            if (equal_move(moveList.moves[mIndx], move))
+                return moveList.moves[mIndx];
+        }
+        return NOMOVE;
     }
 
     void load_pv_line(Position& pos, PVLine& pvLine, DepthSize depth) {
@@ -72,7 +368,9 @@ namespace TT {
 
         Entry entry;
         while (pvLine.depth < depth && TT::probe(pos.get_key(), entry )) {
-            Move m = entry.move;
+            // Other search threads may have overwritten the entry, so only
+            // play moves that are pseudo-legal in this position
+            Move m = find_pseudo_move(pos, entry.move);
             if (m == NOMOVE) break;
 
             if (!pos.do_move(m)) break;
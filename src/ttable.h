@@ -4,9 +4,11 @@
 #include "types.h"
 #include "move.h"
 #include "evaluate.h"
+#include "memory.h"
 
 #include <cstddef>
 #include <cstdint>
+#include <string>
 
 namespace Akerbeltz {
 
@@ -20,6 +22,12 @@ namespace TT {
     constexpr std::size_t MIN_TT_MB     = 4;
     constexpr std::size_t MAX_TT_MB     = 4096;
 
+    // 10-byte entries per 32-byte bucket (two buckets per cache line)
+    constexpr std::size_t BUCKET_ENTRIES = 3;
+
+    // Marks entries stored without a static evaluation
+    constexpr Score NO_EVAL = INT16_MIN;
+
     enum Flag : uint8_t {
         FLAG_NONE,
         FLAG_EXACT,
@@ -27,12 +35,15 @@ namespace TT {
         FLAG_UPPERBOUND
     };
 
+    // Unpacked view of a stored entry, as returned by probe()
     struct Entry {
         Key        key;    // Zobrist key
         Score      score;  // Position Score 
         DepthSize  depth;  // Search depth
         Flag       flag;   // TT::Flag
-        Move       move;   // Best move from position
+        Move       move;   // Best move from position (no attacker/captured fields)
+        Score      eval;   // Static evaluation or NO_EVAL
+        uint8_t    age;    // Generation the entry was written in
     };
 
     struct PVLine {
@@ -40,16 +51,50 @@ namespace TT {
         DepthSize depth;
     };
 
-    void resize(std::size_t sizeMB);
+    // Reallocates the table on large pages when available; the new memory
+    // is zeroed (and first touched) by the given number of threads
+    void resize(std::size_t sizeMB, std::size_t threads = 1);
+
+    // Applied on the next resize()
+    void set_numa_interleave(bool interleave);
+
+    Memory::PageMode page_mode();
+
+    bool numa_interleaved();
 
     std::size_t current_size_mb();
 
-    void clear();
+    // Zeroes the table, splitting the work in chunks across threads
+    void clear(std::size_t threads = 1);
+
+    // Bumps the generation; call once per search so older entries age out
+    void new_search();
+
+    uint8_t generation();
+
+    std::size_t bucket_count();
+
+    std::size_t bucket_index(Key key);
+
+    // Starts loading the bucket of key into cache, so a later probe of the
+    // same key does not stall on memory
+    void prefetch(Key key);
 
     // Returns true if key exist
     bool probe(Key key, Entry &outEntry);
 
-    void store(Key key, DepthSize depth, Score score, Flag flag, Move bestMove);
+    // NO_EVAL (alpha_beta has no static eval) keeps the eval already stored
+    // for the key. A shallower store kept out by a deeper entry of this
+    // search still fills in the eval that entry lacks
+    void store(Key key, DepthSize depth, Score score, Flag flag, Move bestMove, Score eval = NO_EVAL);
+
+    // Writes the whole table to path in a versioned binary format
+    bool save(const std::string &path);
+
+    // Replaces the table (and Hash size) with the one saved in path. The
+    // file is read in parallel slices, one per thread. On failure the
+    // table is left empty or untouched.
+    bool load(const std::string &path, std::size_t threads = 1);
 
     void load_pv_line(Position& pos, PVLine& line, DepthSize depth = MAX_DEPTH);
 
@@ -109,6 +109,13 @@ constexpr Rank square_rank(Square64 square){
   return Rank(square/8);
 }
 
+// King moves between two squares
+constexpr int square_distance(Square64 a, Square64 b){
+  const int files = square_file(a) > square_file(b) ? square_file(a) - square_file(b) : square_file(b) - square_file(a);
+  const int ranks = square_rank(a) > square_rank(b) ? square_rank(a) - square_rank(b) : square_rank(b) - square_rank(a);
+  return files > ranks ? files : ranks;
+}
+
 enum CastlingRight: int{ 
   NO_RIGHT = 0,
   WKCA     = 1, 
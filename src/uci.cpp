@@ -1,16 +1,20 @@
 #include "uci.h"
 #include "engine_info.h"
+#include "nnue.h"
+#include "nnue_kernels.h"
 #include "position.h"
 #include "search.h"
+#include "tablebase.h"
 #include "timemanager.h"
 #include "ttable.h"
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <exception>
 #include <iostream>
 #include <sstream>
 #include <string>
-#include <thread>
-#include <functional>
 
 namespace Akerbeltz{
 
@@ -20,10 +24,29 @@ const std::string START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQk
 
 void position(Position & pos, std::istringstream &is);
 Move make_move(const Position &pos, std::string algebraic_move);
-void go(Position & pos, std::istringstream &is, Search::SearchInfo &searchInfo, std::thread &searchThread);
+void go(Position & pos, std::istringstream &is, Search::SearchInfo &searchInfo);
 void go_info(const Position & pos, std::istringstream &is, Search::SearchInfo &searchInfo);
 void uci_info();
-void setoption(std::istringstream &is);
+void setoption(std::istringstream &is, Search::SearchInfo &searchInfo);
+void print_hash_memory();
+void wait_search(Search::SearchInfo &searchInfo);
+void hash_file_command(const std::string &command, std::istringstream &is);
+void bench(Position &pos, std::istringstream &is, Search::SearchInfo &searchInfo);
+
+// Middlegame, tactical and endgame positions searched by "bench"
+const std::string BENCH_FENS[] = {
+    START_FEN,
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+// Default path for save_hash/load_hash, set with the "Hash File" option
+std::string hashFile;
 
 void run(){
 
@@ -31,7 +54,6 @@ void run(){
     pos.set_FEN(START_FEN);
 
     Search::SearchInfo searchInfo;
-    std::thread searchThread;
 
     std::string inputStr, token;
 
@@ -42,7 +64,7 @@ void run(){
             continue;
 
         if (token == "go"){
-            go(pos, is, searchInfo, searchThread);
+            go(pos, is, searchInfo);
             continue;
         }
 
@@ -52,6 +74,8 @@ void run(){
         }
 
         else if (token == "ucinewgame"){
+            wait_search(searchInfo);
+            TT::clear(Search::thread_count());
             is.clear();
             is.str("startpos");
             is.seekg(0);
@@ -75,7 +99,19 @@ void run(){
         }
         
         else if (token == "setoption"){
-            setoption(is);
+            setoption(is, searchInfo);
+            continue;
+        }
+
+        else if (token == "bench"){
+            wait_search(searchInfo);
+            bench(pos, is, searchInfo);
+            continue;
+        }
+
+        else if (token == "save_hash" || token == "load_hash"){
+            wait_search(searchInfo);
+            hash_file_command(token, is);
             continue;
         }
 
@@ -93,9 +129,7 @@ void run(){
                   << " Type 'quit' for quit program." << std::endl;
     }
 
-    searchInfo.stop = true;
-    if(searchThread.joinable())
-        searchThread.join();
+    wait_search(searchInfo);
 
 }
 
@@ -171,13 +205,16 @@ Move make_move(const Position &pos, std::string algebraic_move){
     return make_capture_move(from, to, specialMove, piece, capturedPiece);
 }
 
-void go(Position & pos, std::istringstream &is, Search::SearchInfo &searchInfo, std::thread &searchThread){
+void go(Position & pos, std::istringstream &is, Search::SearchInfo &searchInfo){
 
     std::string arg;
     std::streampos isParamPos = is.tellg();
 
     is >> arg;
 
+    // A new go waits for the running search to finish on its own
+    Search::wait_search();
+
     if(arg == "perft"){
 
         std::string depthToken;
@@ -190,9 +227,7 @@ void go(Position & pos, std::istringstream &is, Search::SearchInfo &searchInfo,
     else{
         is.seekg(isParamPos);
         go_info(pos, is, searchInfo);
-        if (searchThread.joinable())
-            searchThread.join();
-        searchThread = std::thread(Search::search, std::ref(pos), std::ref(searchInfo));
+        Search::start_search(pos, searchInfo);
     }
 
 }
@@ -203,6 +238,7 @@ void go_info(const Position & pos, std::istringstream &is, Search::SearchInfo &s
 
     searchInfo.depth     = MAX_DEPTH;
     searchInfo.stop      = false;
+    searchInfo.infinite  = false;
     searchInfo.searchPly = 0;
 
     using TM = TimeManager;
@@ -229,7 +265,7 @@ void go_info(const Position & pos, std::istringstream &is, Search::SearchInfo &s
         else if (arg == "binc"  && pos.get_side_to_move() == BLACK) { read_ms(bP.incMs); }
         else if (arg == "movestogo") { read_int(bP.movesToGo); }
         else if (arg == "movetime")  { read_ms(bP.moveTimeMs); }
-        else if (arg == "infinite")  { bP.moveTimeMs.reset(); bP.colorTimeMs.reset(); }
+        else if (arg == "infinite")  { bP.moveTimeMs.reset(); bP.colorTimeMs.reset(); searchInfo.infinite = true; }
     }
 
     tm.allocate_budget(bP);
@@ -247,11 +283,22 @@ void uci_info(){
     std::cout << "option name Hash type spin default " << TT::DEFAULT_TT_MB
               << " min " << TT::MIN_TT_MB
               << " max " << TT::MAX_TT_MB << "\n";
+    std::cout << "option name Threads type spin default " << Search::DEFAULT_THREADS
+              << " min " << Search::MIN_THREADS
+              << " max " << Search::MAX_THREADS << "\n";
+    std::cout << "option name Clear Hash type button" << "\n";
+    std::cout << "option name NUMA Interleave type check default false" << "\n";
+    std::cout << "option name Hash File type string default <empty>" << "\n";
+    std::cout << "option name Use NNUE type check default false" << "\n";
+    std::cout << "option name EvalFile type string default " << NNUE::DEFAULT_NET_NAME << "\n";
+    std::cout << "option name TablebasePath type string default <empty>" << "\n";
+    std::cout << "option name TablebaseProbeLimit type spin default " << Tablebase::MAX_PIECES
+              << " min 0 max " << Tablebase::MAX_PIECES << "\n";
     std::cout << "uciok" << "\n";
 
 }
 
-void setoption(std::istringstream &is) {
+void setoption(std::istringstream &is, Search::SearchInfo &searchInfo) {
 
     std::string token;
     std::string name;
@@ -264,7 +311,10 @@ void setoption(std::istringstream &is) {
                 name += token;
             }
             if (token == "value") {
-                is >> value;
+                // Values may contain spaces (file paths)
+                std::getline(is >> std::ws, value);
+                while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back())))
+                    value.pop_back();
             }
             break;
         }
@@ -272,11 +322,159 @@ void setoption(std::istringstream &is) {
 
     if (name == "Hash" && !value.empty()) {
 
+        // The table is freed and mapped again under the search
+        wait_search(searchInfo);
         const std::size_t hashMB = std::stoull(value);
-        TT::resize(hashMB);
+        TT::resize(hashMB, Search::thread_count());
         std::cout << "info string Hash set to " << TT::current_size_mb() << " MB" << std::endl;
+        print_hash_memory();
+
+    }
+    else if (name == "Threads" && !value.empty()) {
+
+        wait_search(searchInfo);
+        Search::set_threads(std::stoull(value));
+        std::cout << "info string Threads set to " << Search::thread_count() << std::endl;
+
+    }
+    else if (name == "Clear Hash") {
+
+        wait_search(searchInfo);
+        TT::clear(Search::thread_count());
+        std::cout << "info string Hash cleared" << std::endl;
+
+    }
+    else if (name == "Hash File") {
+
+        hashFile = value == "<empty>" ? "" : value;
+        std::cout << "info string Hash File set to " << (hashFile.empty() ? "<empty>" : hashFile) << std::endl;
+
+    }
+    else if (name == "NUMA Interleave" && !value.empty()) {
+
+        wait_search(searchInfo);
+        TT::set_numa_interleave(value == "true");
+        TT::resize(TT::current_size_mb(), Search::thread_count());
+        print_hash_memory();
+
+    }
+    else if (name == "Use NNUE" && !value.empty()) {
+
+        // The search only updates accumulators while enabled, and stored
+        // scores and evals come from the other evaluation
+        wait_search(searchInfo);
+        NNUE::set_enabled(value == "true");
+        TT::clear(Search::thread_count());
+        std::cout << "info string NNUE evaluation " << (NNUE::enabled() ? "enabled" : "disabled")
+                  << " (" << NNUE::network_name() << ", " << NNUE::simd_name(NNUE::simd()) << ")" << std::endl;
+
+    }
+    else if (name == "EvalFile") {
+
+        // The weights are replaced under the search
+        wait_search(searchInfo);
+        if (NNUE::load(value)) {
+            TT::clear(Search::thread_count());
+            std::cout << "info string Loaded network " << NNUE::network_name() << std::endl;
+        } else {
+            std::cout << "info string Failed to load network " << value
+                      << ", keeping " << NNUE::network_name() << std::endl;
+        }
+
+    }
+    else if (name == "TablebasePath") {
+
+        // The old tables are unmapped under any running probe, and stored
+        // scores may predate the tables
+        wait_search(searchInfo);
+        const std::size_t loaded = Tablebase::init(value == "<empty>" ? "" : value);
+        TT::clear(Search::thread_count());
+        std::cout << "info string Loaded " << loaded << " tablebases, probing up to "
+                  << Tablebase::probe_limit() << " pieces" << std::endl;
 
     }
+    else if (name == "TablebaseProbeLimit" && !value.empty()) {
+
+        wait_search(searchInfo);
+        Tablebase::set_probe_limit(std::stoi(value));
+        TT::clear(Search::thread_count());
+        std::cout << "info string Probing tablebases up to " << Tablebase::probe_limit() << " pieces" << std::endl;
+
+    }
+}
+
+// bench [depth]: fixed depth searches from a clear TT, for comparing node
+// counts and speed between builds. Leaves the start position set
+void bench(Position &pos, std::istringstream &is, Search::SearchInfo &searchInfo) {
+
+    DepthSize depth = 8;
+    is >> depth;
+
+    TT::clear(Search::thread_count());
+    NodesSize nodes = 0;
+    NodesSize qsearchNodes = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (const std::string &fen : BENCH_FENS) {
+        pos.set_FEN(fen);
+        std::istringstream go("depth " + std::to_string(depth));
+        go_info(pos, go, searchInfo);
+        Search::start_search(pos, searchInfo);
+        Search::wait_search();
+        nodes += searchInfo.nodes;
+        qsearchNodes += searchInfo.qsearchNodes;
+    }
+
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "info string bench nodes " << nodes
+              << " qnodes " << qsearchNodes
+              << " time " << ms
+              << " nps " << nodes * 1000 / std::max<long long>(ms, 1) << std::endl;
+
+    pos.set_FEN(START_FEN);
+}
+
+void wait_search(Search::SearchInfo &searchInfo) {
+
+    searchInfo.stop = true;
+    Search::wait_search();
+
+}
+
+// save_hash [path] / load_hash [path]; the path defaults to the Hash File option
+void hash_file_command(const std::string &command, std::istringstream &is) {
+
+    std::string path;
+    std::getline(is >> std::ws, path);
+    if (path.empty())
+        path = hashFile;
+
+    if (path.empty()) {
+        std::cout << "info string No Hash File set" << std::endl;
+        return;
+    }
+
+    if (command == "save_hash") {
+        if (TT::save(path))
+            std::cout << "info string Hash saved to " << path << std::endl;
+        else
+            std::cout << "info string Could not save Hash to " << path << std::endl;
+    }
+    else {
+        if (TT::load(path, Search::thread_count()))
+            std::cout << "info string Hash loaded from " << path
+                      << " (" << TT::current_size_mb() << " MB)" << std::endl;
+        else
+            std::cout << "info string Could not load Hash from " << path << std::endl;
+    }
+
+}
+
+void print_hash_memory() {
+
+    std::cout << "info string Hash allocated with " << Memory::page_mode_name(TT::page_mode())
+              << (TT::numa_interleaved() ? ", interleaved over NUMA nodes" : "") << std::endl;
+
 }
 
 }
@@ -0,0 +1,89 @@
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "bitbase.h"
+#include "evaluate.h"
+#include "position.h"
+#include "helpers/test_helpers.h"
+
+using namespace Akerbeltz;
+using namespace TestHelpers;
+
+namespace {
+
+class BitbaseTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        init_engine_once();
+        init_evaluate_once();
+    }
+
+    static bool wins(const std::string& fen) {
+        Position position;
+        position.set_FEN(fen);
+        return Bitbase::probe_kpk(position);
+    }
+};
+
+}  // namespace
+
+TEST_F(BitbaseTest, FitsInThirtyTwoKilobytes) {
+    EXPECT_LE(Bitbase::KPK_SIZE / 8, 32u * 1024);
+}
+
+TEST_F(BitbaseTest, KnownResults) {
+    // King on the sixth in front of the pawn: won whoever moves
+    EXPECT_TRUE(wins("4k3/8/4K3/4P3/8/8/8/8 w - - 0 1"));
+    EXPECT_TRUE(wins("4k3/8/4K3/4P3/8/8/8/8 b - - 0 1"));
+
+    // King one square in front of the pawn: the opposition decides
+    EXPECT_FALSE(wins("8/4k3/8/4K3/4P3/8/8/8 w - - 0 1"));
+    EXPECT_TRUE(wins("8/4k3/8/4K3/4P3/8/8/8 b - - 0 1"));
+
+    // Pawn on the sixth, king behind it: drawn with either side to move
+    EXPECT_FALSE(wins("4k3/8/4P3/4K3/8/8/8/8 w - - 0 1"));
+    EXPECT_FALSE(wins("4k3/8/4P3/4K3/8/8/8/8 b - - 0 1"));
+
+    // Defending king in front of a rook pawn
+    EXPECT_FALSE(wins("k7/8/8/8/8/8/P7/7K w - - 0 1"));
+
+    // Outside the square of the pawn
+    EXPECT_TRUE(wins("8/8/8/8/8/k7/7P/7K b - - 0 1"));
+    EXPECT_FALSE(wins("8/8/8/8/8/5k2/7P/K7 b - - 0 1"));
+
+    // Undefended pawn next to the king to move
+    EXPECT_FALSE(wins("8/8/8/8/8/8/3kP3/7K b - - 0 1"));
+}
+
+TEST_F(BitbaseTest, ColourAndFileMirrorsAgree) {
+    const char* fens[][2] = {
+        {"8/4k3/8/4K3/4P3/8/8/8 w - - 0 1", "8/8/8/4p3/4k3/8/4K3/8 b - - 0 1"},
+        {"8/4k3/8/4K3/4P3/8/8/8 b - - 0 1", "8/8/8/4p3/4k3/8/4K3/8 w - - 0 1"},
+        {"8/8/8/8/8/k7/7P/7K b - - 0 1",    "8/8/8/8/8/7k/P7/K7 b - - 0 1"},
+        {"2k5/8/1K6/1P6/8/8/8/8 w - - 0 1", "5k2/8/6K1/6P1/8/8/8/8 w - - 0 1"},
+    };
+
+    for (const auto& pair : fens)
+        EXPECT_EQ(wins(pair[0]), wins(pair[1])) << pair[0];
+}
+
+TEST_F(BitbaseTest, GenerationDoesNotDependOnThreadCount) {
+    Bitbase::init(1);
+    const std::size_t serialWins = Bitbase::kpk_wins();
+    Bitbase::init(3);
+    EXPECT_EQ(Bitbase::kpk_wins(), serialWins);
+    EXPECT_GT(serialWins, Bitbase::KPK_SIZE / 4);
+}
+
+TEST_F(BitbaseTest, DrawnKpkIsAMaterialDraw) {
+    Position drawn;
+    drawn.set_FEN("8/4k3/8/4K3/4P3/8/8/8 w - - 0 1");
+    EXPECT_TRUE(Evaluate::material_draw(drawn));
+    EXPECT_EQ(Evaluate::evaluate(drawn), 0);
+
+    Position won;
+    won.set_FEN("8/4k3/8/4K3/4P3/8/8/8 b - - 0 1");
+    EXPECT_FALSE(Evaluate::material_draw(won));
+    EXPECT_LT(Evaluate::evaluate(won), -400);   // Black to move, white wins
+}
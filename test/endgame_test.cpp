@@ -0,0 +1,112 @@
+#include <cstdlib>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "endgame.h"
+#include "evaluate.h"
+#include "position.h"
+#include "helpers/test_helpers.h"
+
+using namespace Akerbeltz;
+using namespace TestHelpers;
+
+namespace {
+
+class EndgameTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        init_engine_once();
+        init_evaluate_once();
+    }
+
+    static Evaluate::Score eval(const std::string& fen) {
+        Position position;
+        position.set_FEN(fen);
+        return Evaluate::evaluate(position);
+    }
+};
+
+}  // namespace
+
+TEST_F(EndgameTest, RegistryMatchesBothColours) {
+    Position white;
+    white.set_FEN("8/8/8/4k3/8/8/8/2B1KN2 w - - 0 1");
+    EXPECT_EQ(white.get_material_key(), Endgame::material_key("KBNK", WHITE));
+
+    const Endgame::Entry* entry = Endgame::find(white);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_NE(entry->eval, nullptr);
+    EXPECT_EQ(entry->strongSide, WHITE);
+
+    Position black;
+    black.set_FEN("2b1kn2/8/8/8/4K3/8/8/8 b - - 0 1");
+    EXPECT_EQ(black.get_material_key(), Endgame::material_key("KBNK", BLACK));
+    ASSERT_NE(Endgame::find(black), nullptr);
+    EXPECT_EQ(Endgame::find(black)->strongSide, BLACK);
+
+    // Same-side perspective: both are equally good for the side to move
+    EXPECT_EQ(Evaluate::evaluate(white), Evaluate::evaluate(black));
+
+    // KQKR has its own evaluator, not the bare-king one
+    Position kqkr;
+    kqkr.set_FEN("3rk3/8/8/8/8/8/8/3QK3 b - - 0 1");
+    EXPECT_EQ(kqkr.get_material_key(), Endgame::material_key("KQKR", WHITE));
+    ASSERT_NE(Endgame::find(kqkr), nullptr);
+    EXPECT_EQ(Endgame::find(kqkr)->strongSide, WHITE);
+    Position kqk;
+    kqk.set_FEN("4k3/8/8/8/8/8/8/3QK3 b - - 0 1");
+    ASSERT_NE(Endgame::find(kqk), nullptr);
+    EXPECT_NE(Endgame::find(kqkr)->eval, Endgame::find(kqk)->eval);
+
+    Position middlegame;
+    middlegame.set_FEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    EXPECT_EQ(Endgame::find(middlegame), nullptr);
+}
+
+TEST_F(EndgameTest, KqkrRookIsBetterNextToItsKing) {
+    // Black to move; the rook guards its king or sits across the board
+    const auto together  = eval("8/8/3rk3/8/8/8/8/3QK3 b - - 0 1");
+    const auto separated = eval("r7/8/4k3/8/8/8/8/3QK3 b - - 0 1");
+    EXPECT_LT(together, 0);
+    EXPECT_GT(together, separated);
+}
+
+TEST_F(EndgameTest, BareKingIsDrivenToTheEdge) {
+    // KRK: not registered, caught by the generic mating-force rule
+    const auto center = eval("8/8/8/3k4/8/8/8/R3K3 w - - 0 1");
+    const auto edge   = eval("3k4/8/8/8/8/8/8/R3K3 w - - 0 1");
+    EXPECT_GT(center, 300);
+    EXPECT_GT(edge, center);
+
+    // Kings close together score better
+    EXPECT_GT(eval("3k4/8/3K4/8/8/8/8/R7 w - - 0 1"), edge);
+}
+
+TEST_F(EndgameTest, KbnkPrefersTheBishopsCorner) {
+    // Dark-squared bishop (c1): mate in a1 or h8
+    const auto rightCorner = eval("8/8/8/8/8/1K6/8/k1B2N2 w - - 0 1");
+    const auto wrongCorner = eval("k7/8/1K6/8/8/8/8/2B2N2 w - - 0 1");
+    EXPECT_GT(rightCorner, wrongCorner);
+}
+
+TEST_F(EndgameTest, DrawishEndingsScoreLow) {
+    // Rook against minor: far less than the exchange
+    EXPECT_LT(std::abs(eval("4k3/8/8/3b4/8/8/8/R3K3 w - - 0 1")), 150);
+    EXPECT_LT(std::abs(eval("4k3/8/8/3n4/8/8/8/R3K3 w - - 0 1")), 250);
+
+    // Opposite-coloured bishops with an extra pawn
+    Position position;
+    position.set_FEN("2b1k3/8/8/3P4/8/8/4P3/2B1K3 w - - 0 1");
+    const auto classical = Evaluate::calc_score(position);
+    const auto scaled = Evaluate::evaluate(position);
+    EXPECT_GT(classical, 0);
+    EXPECT_LT(scaled, classical);
+    EXPECT_GT(scaled, 0);
+}
+
+TEST_F(EndgameTest, MaterialDrawsEvaluateToZero) {
+    EXPECT_EQ(eval("4k3/8/8/8/8/8/8/4K3 w - - 0 1"), 0);
+    EXPECT_EQ(eval("4k3/8/8/8/8/8/8/4KN2 b - - 0 1"), 0);
+    EXPECT_EQ(eval("4k3/8/8/8/8/8/8/3NKN2 w - - 0 1"), 0);
+}
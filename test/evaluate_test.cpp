@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <cctype>
+#include <cstdlib>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -7,6 +8,7 @@
 #include <gtest/gtest.h>
 
 #include "evaluate.h"
+#include "movegen.h"
 #include "position.h"
 #include "helpers/test_helpers.h"
 
@@ -221,4 +223,184 @@ TEST_F(EvaluateTest, EndgameKingCentralizationIsPreferred) {
     EXPECT_GT(central_score, corner_score);
 }
 
+TEST_F(EvaluateTest, PassedPawnIsRewarded) {
+    // Same material and pawn squares up to the black pawn's file
+    Position passed;
+    passed.set_FEN("4k3/p7/8/3P4/8/8/8/4K3 w - - 0 1");
+
+    Position covered;
+    covered.set_FEN("4k3/4p3/8/3P4/8/8/8/4K3 w - - 0 1");
+
+    EXPECT_GT(Evaluate::calc_score(passed), Evaluate::calc_score(covered));
+}
+
+TEST_F(EvaluateTest, PawnHashHitsWhenOnlyPiecesMove) {
+    Position position;
+    position.set_FEN("4k3/pp3ppp/8/3p4/3P4/8/PP3PPP/4K1N1 w - - 0 1");
+    const Evaluate::EvalStats before = Evaluate::thread_stats();
+
+    Evaluate::calc_score(position);
+    ASSERT_TRUE(position.do_move(make_quiet_move(SQ64_G1, SQ64_F3, SpecialMove::NO_SPECIAL)));
+    Evaluate::calc_score(position);
+
+    const Evaluate::EvalStats& after = Evaluate::thread_stats();
+    EXPECT_EQ(after.pawnProbes, before.pawnProbes + 2);
+    EXPECT_GE(after.pawnHits, before.pawnHits + 1);
+}
+
+TEST_F(EvaluateTest, EvalCacheMatchesCalcScoreAndHitsOnRepeat) {
+    Position position;
+    position.set_FEN("r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3");
+    const Evaluate::EvalStats before = Evaluate::thread_stats();
+
+    const Evaluate::Score first = Evaluate::evaluate(position);
+    const Evaluate::Score second = Evaluate::evaluate(position);
+
+    EXPECT_EQ(first, Evaluate::calc_score(position));
+    EXPECT_EQ(second, first);
+    const Evaluate::EvalStats& after = Evaluate::thread_stats();
+    EXPECT_EQ(after.evalProbes, before.evalProbes + 2);
+    EXPECT_GE(after.evalHits, before.evalHits + 1);
+}
+
+TEST_F(EvaluateTest, EstimateIsCalcScoreWithoutPawnStructure) {
+    Position position;
+    position.set_FEN("r3k3/8/8/8/8/8/8/R2QK3 b - - 0 1");
+    EXPECT_EQ(Evaluate::estimate(position), Evaluate::calc_score(position));
+
+    // Pawns add only their structure terms, within the bounds even for eight
+    // passed pawns on the seventh
+    for (const char* fen : {"4k3/pp3ppp/8/3p4/3P4/8/PP3PPP/4K1N1 w - - 0 1",
+                            "4k3/PPPPPPPP/8/8/8/8/8/4K3 w - - 0 1",
+                            "4k3/PPPPPPPP/8/8/8/8/8/4K3 b - - 0 1",
+                            "4k3/8/8/8/8/8/pppppppp/4K3 w - - 0 1",
+                            "4k3/p7/p7/p7/p7/8/8/4K3 b - - 0 1"}) {
+        position.set_FEN(fen);
+        Evaluate::Score low, high;
+        Evaluate::estimate_bounds(position, low, high);
+        const Evaluate::Score lazy = Evaluate::estimate(position);
+        EXPECT_LE(lazy + low, Evaluate::calc_score(position)) << fen;
+        EXPECT_GE(lazy + high, Evaluate::calc_score(position)) << fen;
+    }
+}
+
+TEST_F(EvaluateTest, LazyEvaluateFallsBackInsideWindow) {
+    Position position;
+    position.set_FEN("rnb1kbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    const Evaluate::EvalStats before = Evaluate::thread_stats();
+    const Evaluate::Score full = Evaluate::evaluate(position);
+    bool exact = false;
+
+    // A queen up: the estimate alone fails high on a window around zero...
+    const Evaluate::Score bound = Evaluate::lazy_evaluate(position, -50, 50, exact);
+    EXPECT_FALSE(exact);
+    EXPECT_GE(bound, 50);
+    EXPECT_LE(bound, full);
+
+    // ...and low from the other side
+    position.set_FEN("rnb1kbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR b KQkq - 0 1");
+    EXPECT_LE(Evaluate::lazy_evaluate(position, -50, 50, exact), -50);
+    EXPECT_FALSE(exact);
+
+    // Near the window only the full evaluation decides
+    position.set_FEN("rnb1kbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    EXPECT_EQ(Evaluate::lazy_evaluate(position, full - 1, full + 1, exact), full);
+    EXPECT_TRUE(exact);
+
+    const Evaluate::EvalStats& after = Evaluate::thread_stats();
+    EXPECT_EQ(after.lazyProbes, before.lazyProbes + 3);
+    EXPECT_EQ(after.lazyHits, before.lazyHits + 2);
+}
+
+TEST_F(EvaluateTest, TuneTraceReproducesCalcScore) {
+    Position position;
+    std::vector<Evaluate::TuneTerm> terms;
+
+    for (const char* fen : {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+                            "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 4 4",
+                            "8/pp3k2/8/2PPP3/8/8/5K2/8 w - - 0 1",
+                            "4k3/1p1p1p2/8/1P6/1P4P1/8/6P1/4K3 b - - 0 1"}) {
+        position.set_FEN(fen);
+        Evaluate::tune_trace(position, terms);
+
+        Evaluate::PackedScore sum = 0;
+        for (const Evaluate::TuneTerm &term : terms) {
+            ASSERT_NE(term.count, 0);
+            sum += term.count * Evaluate::tune_parameter(term.param);
+        }
+        const Evaluate::Score white = Evaluate::taper(sum, position.game_phase_weight());
+        EXPECT_EQ(position.get_side_to_move() == WHITE ? white : -white, Evaluate::calc_score(position)) << fen;
+    }
+}
+
+TEST_F(EvaluateTest, PsqtAccumulatorsMatchRecomputationThroughSearchTree) {
+    Position position;
+    position.set_FEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    ASSERT_TRUE(Evaluate::psqt_matches(position));
+
+    // Every legal move and reply, including castling, captures, promotions
+    MoveGen::MoveList moves;
+    MoveGen::generate_pseudo_moves(position, moves);
+    for (int i = 0; i < moves.size; ++i) {
+        if (!position.do_move(moves.moves[i])) continue;
+        EXPECT_TRUE(Evaluate::psqt_matches(position));
+
+        MoveGen::MoveList replies;
+        MoveGen::generate_pseudo_moves(position, replies);
+        for (int j = 0; j < replies.size; ++j) {
+            if (!position.do_move(replies.moves[j])) continue;
+            EXPECT_TRUE(Evaluate::psqt_matches(position));
+            position.undo_move();
+        }
+        position.undo_move();
+    }
+
+    position.do_null_move();
+    EXPECT_TRUE(Evaluate::psqt_matches(position));
+    position.undo_null_move();
+    EXPECT_TRUE(Evaluate::psqt_matches(position));
+}
+
+TEST_F(EvaluateTest, PackedScoresKeepBothHalvesThroughArithmetic) {
+    using Evaluate::make_score;
+    const Evaluate::PackedScore a = make_score(-35, 120);
+    const Evaluate::PackedScore b = make_score(50, -300);
+
+    EXPECT_EQ(Evaluate::mg_value(a), -35);
+    EXPECT_EQ(Evaluate::eg_value(a), 120);
+    EXPECT_EQ(Evaluate::mg_value(a + b), 15);
+    EXPECT_EQ(Evaluate::eg_value(a + b), -180);
+    EXPECT_EQ(Evaluate::mg_value(a - b), -85);
+    EXPECT_EQ(Evaluate::eg_value(a - b), 420);
+    EXPECT_EQ(-a, make_score(35, -120));
+}
+
+TEST_F(EvaluateTest, PsqtBlackMirrorsWhite) {
+    for (int pt = PAWN; pt <= KING; ++pt)
+        for (int s = 0; s < SQ64_SIZE; ++s)
+            EXPECT_EQ(Evaluate::PSQT[make_piece(BLACK, PieceType(pt))][s],
+                      -Evaluate::PSQT[make_piece(WHITE, PieceType(pt))][s ^ 56]);
+
+    for (int s = 0; s < SQ64_SIZE; ++s)
+        EXPECT_EQ(Evaluate::PSQT[NO_PIECE][s], 0);
+}
+
+TEST_F(EvaluateTest, TaperBlendsByPhaseAndRoundsLikeLround) {
+    const Evaluate::PackedScore score = Evaluate::make_score(100, -20);
+    EXPECT_EQ(Evaluate::taper(score, Evaluate::MAX_PHASE_PIECE_WEIGHT), 100);
+    EXPECT_EQ(Evaluate::taper(score, 30), 100);
+    EXPECT_EQ(Evaluate::taper(score, 0), -20);
+    EXPECT_EQ(Evaluate::taper(score, 12), 40);
+    // (1 * 12 + 0 * 12) / 24 = 0.5 rounds away from zero in both signs
+    EXPECT_EQ(Evaluate::taper(Evaluate::make_score(1, 0), 12), 1);
+    EXPECT_EQ(Evaluate::taper(Evaluate::make_score(-1, 0), 12), -1);
+}
+
+TEST_F(EvaluateTest, CentipawnsScaleByTaperedPawnValue) {
+    EXPECT_EQ(Evaluate::to_centipawns(82, Evaluate::MAX_PHASE_PIECE_WEIGHT), 100);
+    EXPECT_EQ(Evaluate::to_centipawns(94, 0), 100);
+    EXPECT_EQ(Evaluate::to_centipawns(-47, 0), -50);
+    EXPECT_EQ(Evaluate::to_centipawns(0, 10), 0);
+}
+
 }  // namespace
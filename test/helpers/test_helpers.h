@@ -5,7 +5,9 @@
 #include <mutex>
 
 #include "attacks.h"
+#include "bitbase.h"
 #include "bitboards.h"
+#include "endgame.h"
 #include "evaluate.h"
 #include "position.h"
 
@@ -34,7 +36,10 @@ inline void init_engine_once() {
 
 inline void init_evaluate_once() {
     static std::once_flag once;
-    std::call_once(once, [] { Evaluate::init(); });
+    std::call_once(once, [] {
+        Endgame::init();
+        Bitbase::init();
+    });
 }
 
 }  // namespace
@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -27,6 +29,43 @@ NodesSize perft(Position& position, DepthSize depth) {
     return nodes;
 }
 
+NodesSize legal_perft(Position& position, DepthSize depth) {
+    if (depth == 0) return 1;
+    MoveGen::MoveList moveList;
+    MoveGen::generate_legal(position, moveList);
+    NodesSize nodes = 0;
+    for (int i = 0; i < moveList.size; ++i) {
+        EXPECT_TRUE(position.do_move(moveList.moves[i])) << algebraic_move(moveList.moves[i]);
+        nodes += legal_perft(position, depth - 1);
+        position.undo_move();
+    }
+    return nodes;
+}
+
+// Legal moves must be exactly the pseudo-legal moves do_move accepts, with the same encoding
+void compare_generators(Position& position, DepthSize depth) {
+    MoveGen::MoveList pseudo, legal;
+    MoveGen::generate_pseudo_moves(position, pseudo);
+    MoveGen::generate_legal(position, legal);
+
+    std::vector<Move> expected, actual(legal.moves, legal.moves + legal.size);
+    for (int i = 0; i < pseudo.size; ++i) {
+        if (!position.do_move(pseudo.moves[i])) continue;
+        position.undo_move();
+        expected.push_back(pseudo.moves[i]);
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+    ASSERT_EQ(actual, expected) << position.get_FEN();
+
+    if (depth == 0) return;
+    for (Move move : expected) {
+        position.do_move(move);
+        compare_generators(position, depth - 1);
+        position.undo_move();
+    }
+}
+
 std::vector<std::string> moves_to_algebraic(const MoveGen::MoveList& moveList) {
     std::vector<std::string> result;
     result.reserve(moveList.size);
@@ -82,4 +121,56 @@ TEST_F(MoveGenPerftTest, GeneratesCastlingMovesWhenLegal) {
     EXPECT_TRUE(contains_move(moves, "e1c1"));
 }
 
+TEST_F(MoveGenPerftTest, LegalGeneratorMatchesFilteredPseudoMoves) {
+    Position position;
+    for (const char* fen : {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+                            "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+                            "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8"}) {
+        position.set_FEN(fen);
+        compare_generators(position, 2);
+    }
+}
+
+TEST_F(MoveGenPerftTest, LegalGeneratorEvasionsAndPins) {
+    Position position;
+    // Pinned en passant capturer, double check and a pinned rook that may slide along the pin
+    for (const auto& [fen, count] : std::vector<std::pair<std::string, int>>{
+             {"8/8/8/KPp4r/8/8/8/4k3 w - c6 0 1", 4},
+             {"4k3/8/8/8/8/5n2/8/4K2r w - - 0 1", 2},
+             {"4k3/4r3/8/8/8/8/4R3/4K3 w - - 0 1", 9}}) {
+        position.set_FEN(fen);
+        MoveGen::MoveList moveList;
+        MoveGen::generate_legal(position, moveList);
+        EXPECT_EQ(moveList.size, count) << fen;
+    }
+}
+
+// Every depth of the suite that stays small enough for a unit test
+TEST_F(MoveGenPerftTest, LegalGeneratorPassesPerftSuite) {
+    std::ifstream suite(AKERBELTZ_SOURCE_DIR "/scripts/utils/perftsuite.epd");
+    ASSERT_TRUE(suite.is_open());
+
+    Position position;
+    std::string line;
+    int checked = 0;
+    while (std::getline(suite, line)) {
+        std::stringstream fields(line);
+        std::string fen, field;
+        std::getline(fields, fen, ';');
+        position.set_FEN(fen);
+        while (std::getline(fields, field, ';')) {
+            DepthSize depth = std::stoi(field.substr(1));
+            NodesSize expected = std::stoull(field.substr(field.find(' ') + 1));
+            if (expected > 200000) break;
+            ASSERT_EQ(legal_perft(position, depth), expected) << fen << " depth " << depth;
+            if (depth <= 2) {
+                ASSERT_EQ(perft(position, depth), expected) << fen << " depth " << depth;
+            }
+            ++checked;
+        }
+    }
+    EXPECT_GT(checked, 300);
+}
+
 }  // namespace
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "movegen.h"
+#include "movepicker.h"
+#include "position.h"
+#include "helpers/test_helpers.h"
+
+using namespace Akerbeltz;
+using namespace TestHelpers;
+
+namespace {
+
+class MovePickerTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        init_engine_once();
+    }
+
+    static inline MoveScore history[PIECE_SIZE][SQ64_SIZE] = {};
+};
+
+const std::vector<std::string> FENS = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b KQkq - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 b kq - 0 1",
+    "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+    "rnbqkbnr/pppp1ppp/8/8/3PpP2/8/PPP1P1PP/RNBQKBNR b KQkq d3 0 3",
+    "r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1",
+};
+
+std::vector<std::string> generated_moves(const Position& position) {
+    MoveGen::MoveList moveList;
+    MoveGen::generate_pseudo_moves(position, moveList);
+    std::vector<std::string> moves;
+    for (int i = 0; i < moveList.size; ++i)
+        moves.push_back(algebraic_move(moveList.moves[i]));
+    std::sort(moves.begin(), moves.end());
+    return moves;
+}
+
+std::vector<Move> picked_moves(const Position& position, Move ttMove, Move killer0, Move killer1,
+                               const MoveScore (&history)[PIECE_SIZE][SQ64_SIZE]) {
+    MovePicker picker(position, ttMove, killer0, killer1, history);
+    std::vector<Move> moves;
+    for (Move move = picker.next_move(); move != NOMOVE; move = picker.next_move())
+        moves.push_back(move);
+    return moves;
+}
+
+}  // namespace
+
+TEST_F(MovePickerTest, PseudoLegalityMatchesGenerator) {
+    constexpr SpecialMove SPECIALS[] = {NO_SPECIAL, ENPASSANT, PAWN_START, CASTLE,
+                                        PROMOTION_KNIGHT, PROMOTION_BISHOP, PROMOTION_ROOK, PROMOTION_QUEEN};
+    Position position;
+
+    for (const std::string& fen : FENS) {
+        position.set_FEN(fen);
+        MoveGen::MoveList moveList;
+        MoveGen::generate_pseudo_moves(position, moveList);
+
+        for (Square64 from = SQ64_A1; from < SQ64_SIZE; ++from)
+            for (Square64 to = SQ64_A1; to < SQ64_SIZE; ++to)
+                for (SpecialMove special : SPECIALS) {
+                    const Move move = make_quiet_move(from, to, special);
+                    const bool generated = std::any_of(moveList.moves, moveList.moves + moveList.size,
+                                                       [&](Move m) { return equal_move(m, move); });
+                    ASSERT_EQ(position.is_pseudo_legal(move), generated) << fen << " " << algebraic_move(move)
+                                                                         << " special " << special;
+                }
+    }
+}
+
+TEST_F(MovePickerTest, YieldsEveryGeneratedMoveOnce) {
+    Position position;
+
+    for (const std::string& fen : FENS) {
+        position.set_FEN(fen);
+        const std::vector<std::string> expected = generated_moves(position);
+
+        // Any generated move as TT move, plus killers from elsewhere
+        for (const Move ttMove : {NOMOVE, make_quiet_move(SQ64_E2, SQ64_E4, PAWN_START), make_quiet_move(SQ64_E1, SQ64_G1, CASTLE)}) {
+            const std::vector<Move> picked = picked_moves(position, ttMove, make_quiet_move(SQ64_G1, SQ64_F3, NO_SPECIAL),
+                                                          make_quiet_move(SQ64_A7, SQ64_A6, NO_SPECIAL), history);
+            std::vector<std::string> moves;
+            for (Move move : picked)
+                moves.push_back(algebraic_move(move));
+            std::sort(moves.begin(), moves.end());
+            EXPECT_EQ(moves, expected) << fen;
+
+            // Moves come out as the generator encodes them
+            for (Move move : picked)
+                EXPECT_EQ(is_capture(move), position.get_mailbox_piece(move_to(move)) != NO_PIECE
+                                            || move_special(move) == ENPASSANT) << fen << " " << algebraic_move(move);
+        }
+    }
+}
+
+TEST_F(MovePickerTest, StagesComeInOrder) {
+    Position position;
+    position.set_FEN("4k3/8/4p3/3p1n2/4P3/8/8/3QK3 w - - 0 1");
+
+    // The last killer is a capture here, so the capture stages try it
+    const std::vector<Move> picked = picked_moves(position, make_quiet_move(SQ64_D1, SQ64_D2, NO_SPECIAL),
+                                                  make_quiet_move(SQ64_E1, SQ64_E2, NO_SPECIAL),
+                                                  make_quiet_move(SQ64_E4, SQ64_D5, NO_SPECIAL), history);
+    ASSERT_GE(picked.size(), 5u);
+
+    EXPECT_EQ(algebraic_move(picked[0]), "d1d2");   // TT move
+    EXPECT_EQ(algebraic_move(picked[1]), "e4f5");   // Pawn takes knight
+    EXPECT_EQ(algebraic_move(picked[2]), "e4d5");   // Pawn takes pawn
+    EXPECT_EQ(algebraic_move(picked[3]), "e1e2");   // Killer
+    EXPECT_EQ(algebraic_move(picked.back()), "d1d5");   // Queen takes a defended pawn
+    EXPECT_FALSE(is_capture(picked[3]));
+    EXPECT_TRUE(is_capture(picked[1]));
+}
+
+TEST_F(MovePickerTest, IgnoresMovesFromOtherPositions) {
+    Position position;
+    position.set_FEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+    // A black move, a blocked slider and a castle without rights
+    for (const Move stale : {make_quiet_move(SQ64_E7, SQ64_E5, PAWN_START), make_quiet_move(SQ64_F1, SQ64_C4, NO_SPECIAL),
+                             make_quiet_move(SQ64_E1, SQ64_G1, CASTLE)}) {
+        EXPECT_FALSE(position.is_pseudo_legal(stale));
+        const std::vector<Move> picked = picked_moves(position, stale, stale, NOMOVE, history);
+        EXPECT_EQ(picked.size(), 20u);
+    }
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "nnue.h"
+#include "nnue_kernels.h"
+
+using namespace Akerbeltz;
+using namespace Akerbeltz::NNUE;
+
+namespace {
+
+class NNUEKernelsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::mt19937 rng(2024);
+        // Full int16 range so sums wrap, and values around the clip bounds
+        std::uniform_int_distribution<int> wide(INT16_MIN, INT16_MAX);
+        std::uniform_int_distribution<int> near(-200, 300);
+        std::uniform_int_distribution<int> byte(INT8_MIN, INT8_MAX);
+        for (int i = 0; i < HIDDEN; ++i) {
+            accumulator[i] = int16_t(wide(rng));
+            addRow[i]      = int16_t(wide(rng));
+            subRow[i]      = int16_t(wide(rng));
+            activations[i] = int16_t(i % 3 ? near(rng) : wide(rng));
+            weights[i]     = int8_t(byte(rng));
+        }
+    }
+
+    void TearDown() override { set_simd(detected_simd()); }
+
+    // Offset by one element so unaligned access is covered too
+    alignas(64) int16_t accumulator[HIDDEN + 1];
+    alignas(64) int16_t addRow[HIDDEN];
+    alignas(64) int16_t subRow[HIDDEN];
+    alignas(64) int16_t activations[HIDDEN];
+    alignas(64) int8_t  weights[HIDDEN];
+};
+
+void expect_same(const int16_t* a, const int16_t* b, const char* level) {
+    EXPECT_EQ(std::memcmp(a, b, HIDDEN * sizeof(int16_t)), 0) << level;
+}
+
+}  // namespace
+
+TEST_F(NNUEKernelsTest, AccumulatorUpdatesMatchScalar) {
+    const Kernels &scalar = kernels_for(SIMD_SCALAR);
+
+    for (int level = SIMD_SSE41; level <= detected_simd(); ++level) {
+        const Kernels &simd = kernels_for(SimdLevel(level));
+        const char* name = simd_name(SimdLevel(level));
+
+        for (int offset = 0; offset < 2; ++offset) {
+            int16_t expected[HIDDEN], actual[HIDDEN + 1];
+
+            std::memcpy(expected, accumulator + offset, sizeof(expected));
+            std::memcpy(actual + offset, accumulator + offset, sizeof(expected));
+            scalar.add(expected, addRow);
+            simd.add(actual + offset, addRow);
+            expect_same(expected, actual + offset, name);
+
+            scalar.sub(expected, subRow);
+            simd.sub(actual + offset, subRow);
+            expect_same(expected, actual + offset, name);
+
+            scalar.add_sub(expected, addRow, subRow);
+            simd.add_sub(actual + offset, addRow, subRow);
+            expect_same(expected, actual + offset, name);
+        }
+    }
+}
+
+TEST_F(NNUEKernelsTest, ClippedDotMatchesScalar) {
+    const Kernels &scalar = kernels_for(SIMD_SCALAR);
+
+    int32_t reference = 0;
+    for (int i = 0; i < HIDDEN; ++i)
+        reference += std::min<int>(std::max<int>(activations[i], 0), QA) * weights[i];
+    EXPECT_EQ(scalar.crelu_dot(activations, weights), reference);
+
+    for (int level = SIMD_SSE41; level <= detected_simd(); ++level)
+        EXPECT_EQ(kernels_for(SimdLevel(level)).crelu_dot(activations, weights), reference)
+            << simd_name(SimdLevel(level));
+
+    // Every value clipped high with the largest weights
+    int16_t high[HIDDEN];
+    int8_t  top[HIDDEN];
+    for (int i = 0; i < HIDDEN; ++i) { high[i] = INT16_MAX; top[i] = INT8_MIN; }
+    for (int level = SIMD_SCALAR; level <= detected_simd(); ++level)
+        EXPECT_EQ(kernels_for(SimdLevel(level)).crelu_dot(high, top), QA * INT8_MIN * HIDDEN);
+}
+
+TEST_F(NNUEKernelsTest, SelectionClampsToDetectedLevel) {
+    set_simd(SIMD_AVX512);
+    EXPECT_EQ(simd(), detected_simd());
+    set_simd(SIMD_SCALAR);
+    EXPECT_EQ(simd(), SIMD_SCALAR);
+    EXPECT_EQ(kernels.crelu_dot, kernels_for(SIMD_SCALAR).crelu_dot);
+}
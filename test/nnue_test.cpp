@@ -0,0 +1,244 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "evaluate.h"
+#include "movegen.h"
+#include "nnue.h"
+#include "nnue_kernels.h"
+#include "position.h"
+#include "helpers/test_helpers.h"
+
+using namespace Akerbeltz;
+using namespace TestHelpers;
+
+namespace {
+
+class NNUETest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        init_engine_once();
+        init_evaluate_once();
+        NNUE::init();
+    }
+
+    // Every test leaves the default network, disabled
+    void TearDown() override {
+        ASSERT_TRUE(NNUE::load(NNUE::DEFAULT_NET_NAME));
+        NNUE::set_enabled(false);
+    }
+};
+
+std::string temp_path(const char* name) {
+    const char* dir = std::getenv("TMPDIR");
+    return std::string(dir ? dir : "/tmp") + "/" + name;
+}
+
+template<typename T>
+void write_random(std::ofstream &file, std::mt19937 &rng, std::size_t count, int lo, int hi) {
+    std::uniform_int_distribution<int> dist(lo, hi);
+    for (std::size_t i = 0; i < count; ++i) {
+        const T value = T(dist(rng));
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+}
+
+// A network file with small random weights in the EvalFile layout
+void write_random_network(const std::string &path) {
+    std::mt19937 rng(12345);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    const char magic[8] = {'A', 'K', 'B', 'Z', 'N', 'N', 'U', 'E'};
+    const uint32_t dims[4] = {1, NNUE::INPUTS, NNUE::HIDDEN, NNUE::PSQT_BUCKETS};
+    file.write(magic, sizeof(magic));
+    file.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+
+    write_random<int16_t>(file, rng, NNUE::HIDDEN, -32, 32);
+    write_random<int16_t>(file, rng, std::size_t(NNUE::INPUTS) * NNUE::HIDDEN, -64, 64);
+    write_random<int32_t>(file, rng, std::size_t(NNUE::INPUTS) * NNUE::PSQT_BUCKETS, -500, 500);
+    write_random<int32_t>(file, rng, 1, -1000, 1000);
+    write_random<int8_t>(file, rng, 2 * NNUE::HIDDEN, -64, 64);
+}
+
+bool same_accumulator(const NNUE::Accumulator &a, const NNUE::Accumulator &b) {
+    return std::memcmp(a.values, b.values, sizeof(a.values)) == 0
+        && std::memcmp(a.psqt, b.psqt, sizeof(a.psqt)) == 0;
+}
+
+// Walks every legal line to depth and compares the incremental
+// accumulator with one rebuilt from the board
+int check_tree(Position &position, int depth) {
+    NNUE::Accumulator fresh;
+    NNUE::refresh(position, fresh);
+    EXPECT_TRUE(same_accumulator(position.accumulator(), fresh)) << position.get_FEN();
+
+    if (depth == 0) return 1;
+
+    int nodes = 0;
+    MoveGen::MoveList moveList;
+    MoveGen::generate_pseudo_moves(position, moveList);
+    for (int i = 0; i < moveList.size; ++i) {
+        if (!position.do_move(moveList.moves[i])) continue;
+        nodes += check_tree(position, depth - 1);
+        position.undo_move();
+    }
+    return nodes;
+}
+
+Evaluate::Score classical_psqt(const Position &position) {
+    const Evaluate::Score white = Evaluate::taper(position.psqt(), position.game_phase_weight());
+    return position.get_side_to_move() == WHITE ? white : -white;
+}
+
+}  // namespace
+
+TEST_F(NNUETest, SavedNetworkLoadsBack) {
+    const std::string randomPath = temp_path("akerbeltz_nnue_random.bin");
+    const std::string savedPath  = temp_path("akerbeltz_nnue_saved.bin");
+    write_random_network(randomPath);
+
+    ASSERT_TRUE(NNUE::load(randomPath));
+    EXPECT_EQ(NNUE::network_name(), randomPath);
+    ASSERT_TRUE(NNUE::save(savedPath));
+
+    std::ifstream a(randomPath, std::ios::binary), b(savedPath, std::ios::binary);
+    const std::string original((std::istreambuf_iterator<char>(a)), std::istreambuf_iterator<char>());
+    const std::string saved((std::istreambuf_iterator<char>(b)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(original, saved);
+
+    std::remove(randomPath.c_str());
+    std::remove(savedPath.c_str());
+}
+
+TEST_F(NNUETest, IncrementalAccumulatorMatchesRefresh) {
+    const std::string path = temp_path("akerbeltz_nnue_tree.bin");
+    write_random_network(path);
+    ASSERT_TRUE(NNUE::load(path));
+    NNUE::set_enabled(true);
+
+    // Castling both ways, en passant, promotions with and without capture
+    const char* fens[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    };
+
+    for (const char* fen : fens) {
+        Position position;
+        position.set_FEN(fen);
+        EXPECT_GT(check_tree(position, 3), 0);
+    }
+
+    // A null move keeps the parent accumulator
+    Position position;
+    position.set_FEN(fens[0]);
+    position.do_null_move();
+    EXPECT_GT(check_tree(position, 2), 1);
+    position.undo_null_move();
+
+    std::remove(path.c_str());
+}
+
+TEST_F(NNUETest, DefaultNetworkFollowsClassicalTables) {
+    NNUE::set_enabled(true);
+
+    const char* fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b KQkq - 0 1",
+        "8/5k2/8/3P4/8/8/5K2/8 w - - 0 1",
+        "6k1/5ppp/8/8/8/8/5PPP/3R2K1 b - - 0 1",
+    };
+
+    for (const char* fen : fens) {
+        Position position;
+        position.set_FEN(fen);
+        const Evaluate::Score classical = classical_psqt(position);
+        const Evaluate::Score network   = NNUE::evaluate(position);
+        // Only the game phase is approximated (per piece-count bucket)
+        EXPECT_NEAR(network, classical, 25 + std::abs(classical) / 10) << fen;
+    }
+
+    Position start;
+    start.set_FEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    EXPECT_EQ(NNUE::evaluate(start), 0);
+}
+
+TEST_F(NNUETest, AccumulatorsAllocatedOnlyForTheNetwork) {
+    Position position;
+    position.set_FEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    EXPECT_FALSE(position.has_accumulators());
+
+    // Copies of a classical position stay small
+    Position copy;
+    copy = position;
+    EXPECT_FALSE(copy.has_accumulators());
+
+    NNUE::set_enabled(true);
+    position.set_FEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    EXPECT_TRUE(position.has_accumulators());
+    NNUE::Accumulator fresh;
+    NNUE::refresh(position, fresh);
+    EXPECT_TRUE(same_accumulator(position.accumulator(), fresh));
+
+    position.release_accumulators();
+    EXPECT_FALSE(position.has_accumulators());
+}
+
+TEST_F(NNUETest, FailedLoadKeepsNetwork) {
+    const std::string path = temp_path("akerbeltz_nnue_bad.bin");
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << "not a network";
+    }
+
+    Position position;
+    position.set_FEN("r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4");
+    // NNUE is off here, so set_FEN left the accumulator unbuilt
+    position.refresh_accumulator();
+    const Evaluate::Score before = NNUE::evaluate(position);
+
+    EXPECT_FALSE(NNUE::load(path));
+    EXPECT_FALSE(NNUE::load(temp_path("akerbeltz_nnue_missing.bin")));
+    EXPECT_EQ(NNUE::network_name(), NNUE::DEFAULT_NET_NAME);
+    EXPECT_EQ(NNUE::evaluate(position), before);
+
+    std::remove(path.c_str());
+}
+
+TEST_F(NNUETest, EvaluationIdenticalAcrossSimdLevels) {
+    const std::string path = temp_path("akerbeltz_nnue_simd.bin");
+    write_random_network(path);
+    ASSERT_TRUE(NNUE::load(path));
+    NNUE::set_enabled(true);
+
+    const char* fens[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R b KQ - 1 8",
+    };
+
+    for (const char* fen : fens) {
+        NNUE::set_simd(NNUE::SIMD_SCALAR);
+        Position position;
+        position.set_FEN(fen);
+        const Evaluate::Score reference = NNUE::evaluate(position);
+
+        for (int level = NNUE::SIMD_SSE41; level <= NNUE::detected_simd(); ++level) {
+            NNUE::set_simd(NNUE::SimdLevel(level));
+            position.refresh_accumulator();
+            EXPECT_EQ(NNUE::evaluate(position), reference) << fen << " " << NNUE::simd_name(NNUE::SimdLevel(level));
+        }
+    }
+
+    NNUE::set_simd(NNUE::detected_simd());
+    std::remove(path.c_str());
+}
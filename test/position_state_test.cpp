@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include "bitboards.h"
+#include "movegen.h"
 #include "move.h"
 #include "position.h"
 #include "helpers/test_helpers.h"
@@ -30,6 +31,71 @@ TEST_F(PositionStateTest, FenRoundTripInitialPosition) {
     EXPECT_EQ(position.get_moves_counter(), 1);
 }
 
+TEST_F(PositionStateTest, PawnKeyTracksOnlyPawnsThroughMovesAndUndo) {
+    Position position;
+    position.set_FEN("4k3/1P6/8/3p4/4P3/8/8/R3K2N w Q - 0 1");
+    const Key startPawnKey = position.get_pawn_key();
+
+    const auto fresh_pawn_key = [](const Position& pos) {
+        Position copy;
+        copy.set_FEN(pos.get_FEN());
+        return copy.get_pawn_key();
+    };
+
+    // Piece moves and castling leave the pawn key alone
+    ASSERT_TRUE(position.do_move(make_quiet_move(SQ64_H1, SQ64_G3, SpecialMove::NO_SPECIAL)));
+    EXPECT_EQ(position.get_pawn_key(), startPawnKey);
+    ASSERT_TRUE(position.do_move(make_quiet_move(SQ64_E8, SQ64_F7, SpecialMove::NO_SPECIAL)));
+    ASSERT_TRUE(position.do_move(make_quiet_move(SQ64_E1, SQ64_C1, SpecialMove::CASTLE)));
+    EXPECT_EQ(position.get_pawn_key(), startPawnKey);
+
+    // Pawn capture, then promotion
+    ASSERT_TRUE(position.do_move(make_capture_move(SQ64_D5, SQ64_E4, SpecialMove::NO_SPECIAL, B_PAWN, W_PAWN)));
+    EXPECT_NE(position.get_pawn_key(), startPawnKey);
+    EXPECT_EQ(position.get_pawn_key(), fresh_pawn_key(position));
+    ASSERT_TRUE(position.do_move(make_quiet_move(SQ64_B7, SQ64_B8, SpecialMove::PROMOTION_QUEEN)));
+    EXPECT_EQ(position.get_pawn_key(), fresh_pawn_key(position));
+
+    for (int i = 0; i < 5; ++i) position.undo_move();
+    EXPECT_EQ(position.get_pawn_key(), startPawnKey);
+}
+
+TEST_F(PositionStateTest, MaterialKeyDependsOnPieceCountsOnly) {
+    Position position;
+    position.set_FEN("4k3/1P6/8/3p4/4P3/8/8/R3K2N w Q - 0 1");
+    const Key startMaterialKey = position.get_material_key();
+
+    const auto fresh_material_key = [](const Position& pos) {
+        Position copy;
+        copy.set_FEN(pos.get_FEN());
+        return copy.get_material_key();
+    };
+
+    // Quiet moves and castling keep the counts
+    ASSERT_TRUE(position.do_move(make_quiet_move(SQ64_H1, SQ64_G3, SpecialMove::NO_SPECIAL)));
+    ASSERT_TRUE(position.do_move(make_quiet_move(SQ64_E8, SQ64_F7, SpecialMove::NO_SPECIAL)));
+    ASSERT_TRUE(position.do_move(make_quiet_move(SQ64_E1, SQ64_C1, SpecialMove::CASTLE)));
+    EXPECT_EQ(position.get_material_key(), startMaterialKey);
+
+    ASSERT_TRUE(position.do_move(make_capture_move(SQ64_D5, SQ64_E4, SpecialMove::NO_SPECIAL, B_PAWN, W_PAWN)));
+    EXPECT_NE(position.get_material_key(), startMaterialKey);
+    EXPECT_EQ(position.get_material_key(), fresh_material_key(position));
+    ASSERT_TRUE(position.do_move(make_quiet_move(SQ64_B7, SQ64_B8, SpecialMove::PROMOTION_QUEEN)));
+    EXPECT_EQ(position.get_material_key(), fresh_material_key(position));
+
+    for (int i = 0; i < 5; ++i) position.undo_move();
+    EXPECT_EQ(position.get_material_key(), startMaterialKey);
+
+    // Same counts on other squares share the key
+    Position other;
+    other.set_FEN("8/1P3k2/8/3p4/8/2P5/6N1/R5K1 b - - 3 20");
+    EXPECT_EQ(other.get_material_key(), startMaterialKey);
+
+    // From the pieces alone, in any order
+    const Piece pieces[] = {W_PAWN, B_KING, W_ROOK, B_PAWN, W_KING, W_KNIGHT, W_PAWN};
+    EXPECT_EQ(Position::material_key(pieces, 7), startMaterialKey);
+}
+
 TEST_F(PositionStateTest, DoUndoQuietMoveRestoresState) {
     Position position;
     position.set_FEN(START_FEN);
@@ -151,4 +217,75 @@ TEST_F(PositionStateTest, NullMoveTogglesSideAndClearsEnPassant) {
     EXPECT_EQ(position.get_FEN(), fen);
 }
 
+TEST_F(PositionStateTest, CheckersAndPinnedPieces) {
+    Position position;
+    // The b4 bishop checks and the e8 rook pins the e2 knight
+    position.set_FEN("4r1k1/8/8/8/1b6/8/4N3/4K3 w - - 0 1");
+    EXPECT_EQ(position.checkers(), Bitboards::set_pieces(SQ64_B4));
+    EXPECT_EQ(position.pinned(), Bitboards::set_pieces(SQ64_E2));
+
+    // Two own blockers on the line: nothing is pinned
+    position.set_FEN("4r1k1/8/8/8/8/4P3/4N3/4K3 w - - 0 1");
+    EXPECT_EQ(position.checkers(), ZERO);
+    EXPECT_EQ(position.pinned(), ZERO);
+
+    // Once the knight leaves, the pawn is the only blocker left
+    ASSERT_TRUE(position.do_move(make_quiet_move(SQ64_E2, SQ64_C3, NO_SPECIAL)));
+    position.do_null_move();
+    EXPECT_EQ(position.pinned(), Bitboards::set_pieces(SQ64_E3));
+    position.undo_null_move();
+    position.undo_move();
+    EXPECT_EQ(position.pinned(), ZERO);
+}
+
+TEST_F(PositionStateTest, StaticExchangeEvaluation) {
+    Position position;
+
+    // Rook takes a pawn defended by a rook, with a second rook behind it
+    position.set_FEN("4r1k1/8/8/4p3/8/8/4R3/4R1K1 w - - 0 1");
+    const Move rookTakes = make_capture_move(SQ64_E2, SQ64_E5, NO_SPECIAL, W_ROOK, B_PAWN);
+    EXPECT_TRUE(position.see(rookTakes, Evaluate::SEE_VALUE[PAWN]));
+    EXPECT_FALSE(position.see(rookTakes, Evaluate::SEE_VALUE[PAWN] + 1));
+
+    // Without the x-ray the rook is lost for a pawn
+    position.set_FEN("4r1k1/8/8/4p3/8/8/4R3/6K1 w - - 0 1");
+    EXPECT_FALSE(position.see(rookTakes, 0));
+    EXPECT_TRUE(position.see(rookTakes, Evaluate::SEE_VALUE[PAWN] - Evaluate::SEE_VALUE[ROOK]));
+
+    // The king only recaptures on an undefended square
+    position.set_FEN("8/8/8/3k4/4p3/8/8/4R1K1 w - - 0 1");
+    const Move rookTakesKingSide = make_capture_move(SQ64_E1, SQ64_E4, NO_SPECIAL, W_ROOK, B_PAWN);
+    EXPECT_FALSE(position.see(rookTakesKingSide, 0));
+    position.set_FEN("8/8/8/3k4/4p3/8/6B1/4R1K1 w - - 0 1");
+    EXPECT_TRUE(position.see(rookTakesKingSide, Evaluate::SEE_VALUE[PAWN]));
+
+    // Pawn takes a defended knight; queen takes a pawn defended by a pawn
+    position.set_FEN("4k3/8/4p3/3n4/4P3/8/8/3QK3 w - - 0 1");
+    EXPECT_TRUE(position.see(make_capture_move(SQ64_E4, SQ64_D5, NO_SPECIAL, W_PAWN, B_KNIGHT),
+                             Evaluate::SEE_VALUE[KNIGHT] - Evaluate::SEE_VALUE[PAWN]));
+    position.set_FEN("4k3/8/4p3/3p4/8/8/8/3QK3 w - - 0 1");
+    EXPECT_FALSE(position.see(make_capture_move(SQ64_D1, SQ64_D5, NO_SPECIAL, W_QUEEN, B_PAWN), 0));
+}
+
+TEST_F(PositionStateTest, CheckInfoMatchesFreshPositionAfterMoves) {
+    Position position, fresh;
+    for (const char* fen : {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+                            "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8"}) {
+        position.set_FEN(fen);
+        MoveGen::MoveList moveList;
+        MoveGen::generate_pseudo_moves(position, moveList);
+        for (int i = 0; i < moveList.size; ++i) {
+            if (!position.do_move(moveList.moves[i])) continue;
+            fresh.set_FEN(position.get_FEN());
+            EXPECT_EQ(position.checkers(), fresh.checkers()) << position.get_FEN();
+            EXPECT_EQ(position.pinned(), fresh.pinned()) << position.get_FEN();
+            position.undo_move();
+        }
+        fresh.set_FEN(fen);
+        EXPECT_EQ(position.checkers(), fresh.checkers());
+        EXPECT_EQ(position.pinned(), fresh.pinned());
+    }
+}
+
 }  // namespace
@@ -266,6 +266,73 @@ TEST_F(SearchTest, MateInTwoSelectsFromAcceptableMoves) {
     EXPECT_NE(std::find(mate2.begin(), mate2.end(), bestmove), mate2.end());
 }
 
+TEST_F(SearchTest, AspirationWindowWidensToMateScore) {
+    // Depth 5 scores the extra rook, depth 6 finds the mate: the window
+    // around the rook score has to fail high until the mate fits
+    const std::string output = run_search_output("6k1/8/8/6K1/8/8/8/R7 w - - 0 1", 6);
+    const auto score_at = [&](int depth) {
+        const std::string key = "info depth " + std::to_string(depth) + " score cp ";
+        const std::size_t pos = output.find(key);
+        return pos == std::string::npos ? 0 : std::stoi(output.substr(pos + key.size()));
+    };
+    EXPECT_GT(score_at(5), 500);
+    EXPECT_LT(score_at(5), 2000);
+    EXPECT_GT(score_at(6), 30000);
+}
+
+TEST_F(SearchTest, LazySmpHelpersAgreeOnMateInOne) {
+    Search::set_threads(4);
+    const std::string bestmove =
+        run_search_bestmove("7k/8/5KQ1/8/8/8/8/8 w - - 0 1", 4);
+    Search::set_threads(Search::DEFAULT_THREADS);
+    ASSERT_FALSE(bestmove.empty());
+    EXPECT_EQ(bestmove, "g6g7");
+}
+
+TEST_F(SearchTest, LazySmpBestmoveIsLegal) {
+    const std::string fen = "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3";
+    Search::set_threads(3);
+    const std::string bestmove = run_search_bestmove(fen, 4);
+    Search::set_threads(Search::DEFAULT_THREADS);
+    EXPECT_TRUE(bestmove_is_legal(fen, bestmove));
+}
+
+TEST_F(SearchTest, ReportsEvalCacheHitRatesAfterSearch) {
+    const std::string output = run_search_output("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4);
+    const auto stats = output.find("info string pawn hash hits");
+    ASSERT_NE(stats, std::string::npos);
+    EXPECT_NE(output.find("eval cache hits", stats), std::string::npos);
+    EXPECT_LT(stats, output.find("bestmove"));
+}
+
+TEST_F(SearchTest, QsearchLeavesStoreStaticEvalsInTT) {
+    // Stand pat and fail-low leaves store their eval too, so a repeated
+    // search takes its leaf evals from the TT
+    const std::string fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    run_search_output(fen, 4);
+    const std::string output = run_search_output(fen, 4);
+
+    const auto stats = output.find("info string pawn hash hits");
+    ASSERT_NE(stats, std::string::npos);
+    std::istringstream line(output.substr(stats));
+    std::string token;
+    long long ttEvals = -1;
+    while (line >> token && token != "bestmove")
+        if (token == "evals") line >> ttEvals;
+    EXPECT_GT(ttEvals, 0) << output;
+    EXPECT_NE(output.find("eval cache hits 0.0% (0/0)"), std::string::npos) << output;
+}
+
+TEST_F(SearchTest, DeadMaterialCutsSubtrees) {
+    // Every reply leaves K+N vs K: the root's children return a draw at once
+    const std::string output = run_search_output("4k3/8/8/8/8/8/8/4KN2 w - - 0 1", 8);
+    EXPECT_NE(output.find("info depth 8 score cp 0 "), std::string::npos);
+
+    const auto nodesAt = output.rfind(" nodes ");
+    ASSERT_NE(nodesAt, std::string::npos);
+    EXPECT_LE(std::stoull(output.substr(nodesAt + 7)), 8u);
+}
+
 TEST_F(SearchTest, IterativeDeepeningReportsSequentialDepths) {
     const std::string fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
     const std::string output = run_search_output(fen, 3);
@@ -0,0 +1,251 @@
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "bitbase.h"
+#include "move.h"
+#include "position.h"
+#include "search.h"
+#include "tablebase.h"
+#include "helpers/test_helpers.h"
+
+using namespace Akerbeltz;
+using namespace TestHelpers;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+class TablebaseTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        init_engine_once();
+        init_evaluate_once();
+        fs::remove_all(root());
+    }
+
+    // Search must not see tables left by these tests
+    static void TearDownTestSuite() {
+        Tablebase::init("");
+        fs::remove_all(root());
+    }
+
+    static fs::path root() { return fs::temp_directory_path() / "akerbeltz_tablebase_test"; }
+
+    static std::string directory(const std::string& name = "tables") { return (root() / name).string(); }
+
+    static void generate(const std::string& code) {
+        testing::internal::CaptureStdout();
+        const bool generated = Tablebase::generate(code, directory());
+        testing::internal::GetCapturedStdout();
+        ASSERT_TRUE(generated) << code;
+    }
+
+    static Tablebase::ProbeResult probe(const std::string& fen) {
+        Position position;
+        position.set_FEN(fen);
+        return Tablebase::probe(position);
+    }
+};
+
+std::string read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+// FEN of a king and pawn against a king
+std::string kpk_fen(Square64 whiteKing, Square64 pawn, Square64 blackKing, Color stm) {
+    char board[SQ64_SIZE];
+    std::fill(board, board + SQ64_SIZE, '1');
+    board[whiteKing] = 'K';
+    board[pawn]      = 'P';
+    board[blackKing] = 'k';
+
+    std::string fen;
+    for (int rank = RANK_8; rank >= RANK_1; --rank) {
+        fen.append(board + rank * 8, 8);
+        if (rank != RANK_1) fen += '/';
+    }
+    return fen + (stm == WHITE ? " w - - 0 1" : " b - - 0 1");
+}
+
+}  // namespace
+
+TEST_F(TablebaseTest, CanonicalCodes) {
+    EXPECT_EQ(Tablebase::canonical_code("kpk"), "KPK");
+    EXPECT_EQ(Tablebase::canonical_code("KKQ"), "KQK");
+    EXPECT_EQ(Tablebase::canonical_code("KRKQ"), "KQKR");
+    EXPECT_EQ(Tablebase::canonical_code("KPRKR"), "KRPKR");
+    EXPECT_EQ(Tablebase::canonical_code("KK"), "");
+    EXPECT_EQ(Tablebase::canonical_code("KQRBKN"), "");
+    EXPECT_EQ(Tablebase::canonical_code("KXK"), "");
+}
+
+TEST_F(TablebaseTest, KnownResults) {
+    generate("KQK");
+    generate("KRK");
+
+    const Tablebase::ProbeResult mated = probe("k7/1Q6/1K6/8/8/8/8/8 b - - 0 1");
+    EXPECT_EQ(mated.wdl, Tablebase::WDL_LOSS);
+    EXPECT_EQ(mated.dtz, 0);
+
+    EXPECT_EQ(probe("k7/2Q5/1K6/8/8/8/8/8 b - - 0 1").wdl, Tablebase::WDL_DRAW);   // Stalemate
+    EXPECT_EQ(probe("8/8/8/8/8/8/1Q6/k6K b - - 0 1").wdl, Tablebase::WDL_DRAW);    // Kxb2
+
+    const Tablebase::ProbeResult mateInOne = probe("k7/8/1K6/8/8/8/8/7R w - - 0 1");
+    EXPECT_EQ(mateInOne.wdl, Tablebase::WDL_WIN);
+    EXPECT_EQ(mateInOne.dtz, 1);
+
+    // Black side is stronger: the colours are swapped to probe
+    const Tablebase::ProbeResult flipped = probe("7r/8/8/8/8/1k6/8/K7 b - - 0 1");
+    EXPECT_EQ(flipped.wdl, Tablebase::WDL_WIN);
+    EXPECT_EQ(flipped.dtz, 1);
+
+    // Castling rights are not in the tables
+    EXPECT_EQ(probe("8/8/8/8/8/2k5/8/R3K3 w Q - 0 1").wdl, Tablebase::WDL_NONE);
+}
+
+TEST_F(TablebaseTest, KpkAgreesWithBitbase) {
+    generate("KPK");
+
+    Position position;
+    int compared = 0;
+    for (int stm = WHITE; stm <= BLACK; ++stm)
+        for (Square64 pawn = SQ64_A2; pawn <= SQ64_H7; ++pawn)
+            for (Square64 whiteKing = SQ64_A1; whiteKing < SQ64_SIZE; ++whiteKing)
+                for (Square64 blackKing = SQ64_A1; blackKing < SQ64_SIZE; ++blackKing) {
+                    if (whiteKing == pawn || blackKing == pawn || square_distance(whiteKing, blackKing) <= 1
+                     || (stm == WHITE && (Attacks::pawnAttacks[WHITE][pawn] & (ONE << blackKing))))
+                        continue;
+
+                    position.set_FEN(kpk_fen(whiteKing, pawn, blackKing, Color(stm)));
+                    const Tablebase::WDL expected = !Bitbase::probe_kpk(position) ? Tablebase::WDL_DRAW
+                                                  : stm == WHITE ? Tablebase::WDL_WIN : Tablebase::WDL_LOSS;
+                    ASSERT_EQ(Tablebase::probe_wdl(position), expected) << position.get_FEN();
+                    ASSERT_EQ(Tablebase::probe(position).wdl, expected) << position.get_FEN();   // Also decodes DTZ
+                    ++compared;
+                }
+    EXPECT_GT(compared, 300000);
+}
+
+TEST_F(TablebaseTest, PlayingDtzMovesMates) {
+    generate("KRK");
+
+    Position position;
+    position.set_FEN("8/8/8/3k4/8/8/8/R3K3 w - - 0 1");
+    Tablebase::ProbeResult result = Tablebase::probe(position);
+    ASSERT_EQ(result.wdl, Tablebase::WDL_WIN);
+
+    // Every move of both sides brings the mate exactly one ply closer
+    const int plies = result.dtz;
+    for (int ply = 0; ply < plies; ++ply) {
+        Tablebase::ProbeResult before;
+        const Move move = Tablebase::root_move(position, before);
+        ASSERT_NE(move, NOMOVE);
+        ASSERT_TRUE(position.do_move(move));
+        result = Tablebase::probe(position);
+        EXPECT_EQ(result.dtz, before.dtz - 1) << position.get_FEN();
+        EXPECT_EQ(result.wdl, before.wdl == Tablebase::WDL_WIN ? Tablebase::WDL_LOSS : Tablebase::WDL_WIN);
+    }
+
+    EXPECT_EQ(result.wdl, Tablebase::WDL_LOSS);
+    EXPECT_EQ(result.dtz, 0);
+}
+
+TEST_F(TablebaseTest, FilesDoNotDependOnThreadCount) {
+    for (const auto& [name, threads] : {std::pair<const char*, std::size_t>{"one", 1}, {"three", 3}}) {
+        Tablebase::init("");
+        testing::internal::CaptureStdout();
+        ASSERT_TRUE(Tablebase::generate("KQK", directory(name), threads));
+        testing::internal::GetCapturedStdout();
+    }
+
+    const std::string one = read_file(directory("one") + "/KQK" + Tablebase::FILE_EXTENSION);
+    EXPECT_FALSE(one.empty());
+    EXPECT_EQ(one, read_file(directory("three") + "/KQK" + Tablebase::FILE_EXTENSION));
+
+    // Reloaded from disk
+    EXPECT_EQ(Tablebase::init(directory("one")), 1u);
+    EXPECT_EQ(Tablebase::probe_limit(), 3);
+    EXPECT_EQ(probe("k7/1Q6/1K6/8/8/8/8/8 b - - 0 1").wdl, Tablebase::WDL_LOSS);
+}
+
+TEST_F(TablebaseTest, SearchScoresTablebaseWins) {
+    generate("KRK");
+
+    Position position;
+    position.set_FEN("k7/8/1K6/8/8/8/6r1/6R1 w - - 0 1");
+
+    Search::SearchInfo info{};
+    info.depth = 1;
+    info.stop.store(false);
+    info.timeManager.allocate_budget({});
+
+    // Rxg2 leads into a won KRK: a score no evaluation reaches
+    testing::internal::CaptureStdout();
+    Search::search(position, info);
+    const std::string output = testing::internal::GetCapturedStdout();
+
+    std::istringstream lines(output);
+    std::string token;
+    int cp = 0;
+    while (lines >> token)
+        if (token == "cp") lines >> cp;
+    EXPECT_GT(cp, 10000) << output;
+    EXPECT_NE(output.find("bestmove g1g2"), std::string::npos) << output;
+}
+
+TEST_F(TablebaseTest, DoublePushIsProbedWithoutEnPassantSquare) {
+    generate("KPK");
+
+    // No black pawn can take on h3
+    const Tablebase::ProbeResult pushed = probe("8/8/8/8/7P/8/5k2/7K b - h3 0 1");
+    const Tablebase::ProbeResult cleared = probe("8/8/8/8/7P/8/5k2/7K b - - 0 1");
+    ASSERT_NE(pushed.wdl, Tablebase::WDL_NONE);
+    EXPECT_EQ(pushed.wdl, cleared.wdl);
+    EXPECT_EQ(pushed.dtz, cleared.dtz);
+
+    // h2-h4 is ranked with the other moves
+    Position position;
+    position.set_FEN("8/8/8/8/8/8/5k1P/7K w - - 0 1");
+    Tablebase::ProbeResult result;
+    EXPECT_NE(Tablebase::root_move(position, result), NOMOVE);
+}
+
+TEST_F(TablebaseTest, TableMoveWaitsForSearchWithoutClock) {
+    generate("KRK");
+
+    const std::string fen = "8/8/8/3k4/8/8/8/R3K3 w - - 0 1";
+    Position position;
+    position.set_FEN(fen);
+    Tablebase::ProbeResult result;
+    const std::string tbMove = algebraic_move(Tablebase::root_move(position, result));
+    ASSERT_NE(tbMove, algebraic_move(NOMOVE));
+
+    const auto run = [&](const TimeManager::BudgetParams& params) {
+        position.set_FEN(fen);
+        Search::SearchInfo info{};
+        info.depth = 2;
+        info.stop.store(false);
+        info.timeManager.allocate_budget(params);
+        testing::internal::CaptureStdout();
+        Search::search(position, info);
+        return testing::internal::GetCapturedStdout();
+    };
+
+    // Without a clock the requested depth is searched, then the table move played
+    const std::string unlimited = run({});
+    EXPECT_NE(unlimited.find("info depth 2 "), std::string::npos) << unlimited;
+    EXPECT_NE(unlimited.find("bestmove " + tbMove), std::string::npos) << unlimited;
+
+    // On the clock the table move is played at once
+    TimeManager::BudgetParams params;
+    params.moveTimeMs = TimeManager::Ms(1000);
+    const std::string timed = run(params);
+    EXPECT_EQ(timed.find("info depth 1 "), std::string::npos) << timed;
+    EXPECT_NE(timed.find("bestmove " + tbMove), std::string::npos) << timed;
+}
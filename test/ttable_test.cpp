@@ -1,6 +1,12 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include "helpers/test_helpers.h"
+#include "movegen.h"
 #include "position.h"
 #include "ttable.h"
 
@@ -9,14 +15,26 @@ using namespace TestHelpers;
 
 namespace {
 
-std::size_t entry_count_for_mb(std::size_t size_mb) {
-    const std::size_t bytes = size_mb * 1024ULL * 1024ULL;
-    const std::size_t count = bytes / sizeof(TT::Entry);
-    return count ? count : 1;
+std::vector<Key> keys_for_same_bucket(Key seed, std::size_t count) {
+    std::vector<Key> keys{seed};
+    const std::size_t bucket = TT::bucket_index(seed);
+    Key key = seed;
+    while (keys.size() < count) {
+        key = key * 6364136223846793005ULL + 1442695040888963407ULL;
+        if (TT::bucket_index(key) != bucket) continue;
+        // Keys must also differ in the bits kept by the entry's key check
+        const bool distinct = std::none_of(keys.begin(), keys.end(), [key](Key k) {
+            return uint16_t(k) == uint16_t(key);
+        });
+        if (distinct) keys.push_back(key);
+    }
+    return keys;
 }
 
 class TTableTest : public ::testing::Test {
 protected:
+    static void SetUpTestSuite() { init_engine_once(); }
+
     void SetUp() override {
         TT::resize(4);
         TT::clear();
@@ -28,6 +46,111 @@ TEST_F(TTableTest, ResizeClampsToMinimum) {
     EXPECT_EQ(TT::current_size_mb(), TT::MIN_TT_MB);
 }
 
+TEST_F(TTableTest, ResizeAllocatesPageAlignedZeroedTable) {
+    TT::store(0x12345678ULL, 5, 42, TT::FLAG_EXACT, NOMOVE);
+    TT::resize(8, 2);
+
+    EXPECT_NE(TT::page_mode(), Memory::PAGES_NONE);
+    EXPECT_EQ(TT::bucket_count(), 8U * 1024 * 1024 / 32);
+    TT::Entry entry{};
+    EXPECT_FALSE(TT::probe(0x12345678ULL, entry));
+}
+
+TEST_F(TTableTest, BucketIndexCoversNonPowerOfTwoSizes) {
+    TT::resize(5);
+    const std::size_t buckets = TT::bucket_count();
+    EXPECT_EQ(TT::bucket_index(0), 0U);
+    EXPECT_EQ(TT::bucket_index(~Key(0)), buckets - 1);
+
+    std::vector<int> quarters(4, 0);
+    Key key = 1;
+    for (int i = 0; i < 4000; ++i) {
+        key = key * 6364136223846793005ULL + 1442695040888963407ULL;
+        const std::size_t idx = TT::bucket_index(key);
+        ASSERT_LT(idx, buckets);
+        ++quarters[idx * 4 / buckets];
+    }
+    for (int count : quarters)
+        EXPECT_GT(count, 800);
+}
+
+TEST_F(TTableTest, PositionKeysSpreadOverWholeTable) {
+    Position pos;
+    pos.set_FEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    const std::size_t buckets = TT::bucket_count();
+    std::vector<int> quarters(4, 0);
+
+    MoveGen::MoveList moves;
+    MoveGen::generate_pseudo_moves(pos, moves);
+    for (int i = 0; i < moves.size; ++i) {
+        if (!pos.do_move(moves.moves[i])) continue;
+        MoveGen::MoveList replies;
+        MoveGen::generate_pseudo_moves(pos, replies);
+        for (int j = 0; j < replies.size; ++j) {
+            if (!pos.do_move(replies.moves[j])) continue;
+            ++quarters[TT::bucket_index(pos.get_key()) * 4 / buckets];
+            pos.undo_move();
+        }
+        pos.undo_move();
+    }
+
+    for (int count : quarters)
+        EXPECT_GT(count, 50);
+}
+
+TEST_F(TTableTest, PrefetchLeavesTableUnchanged) {
+    const Key key = 0x12345678ULL;
+    TT::store(key, 5, 42, TT::FLAG_EXACT, NOMOVE);
+    TT::prefetch(key);
+    TT::prefetch(~key);
+
+    TT::Entry entry{};
+    ASSERT_TRUE(TT::probe(key, entry));
+    EXPECT_EQ(entry.score, 42);
+}
+
+TEST_F(TTableTest, SaveAndLoadRestoresEntriesSizeAndGeneration) {
+    const std::string path = (std::filesystem::temp_directory_path() / "akerbeltz_tt_roundtrip.hash").string();
+    const Move move = make_quiet_move(SQ64_E2, SQ64_E4, SpecialMove::PAWN_START);
+    TT::new_search();
+    TT::store(0x12345678ULL, 7, -33, TT::FLAG_LOWERBOUND, move, 15);
+    const uint8_t generation = TT::generation();
+    ASSERT_TRUE(TT::save(path));
+
+    TT::resize(16);
+    ASSERT_TRUE(TT::load(path, 3));
+    std::filesystem::remove(path);
+
+    EXPECT_EQ(TT::current_size_mb(), 4U);
+    EXPECT_EQ(TT::generation(), generation);
+    TT::Entry entry{};
+    ASSERT_TRUE(TT::probe(0x12345678ULL, entry));
+    EXPECT_EQ(entry.depth, 7);
+    EXPECT_EQ(entry.score, -33);
+    EXPECT_EQ(entry.eval, 15);
+    EXPECT_EQ(entry.flag, TT::FLAG_LOWERBOUND);
+    EXPECT_EQ(entry.move, raw_move(move));
+}
+
+TEST_F(TTableTest, LoadRejectsForeignOrTruncatedFiles) {
+    const std::string path = (std::filesystem::temp_directory_path() / "akerbeltz_tt_bad.hash").string();
+    TT::store(0xABCDEFULL, 3, 9, TT::FLAG_EXACT, NOMOVE);
+
+    std::ofstream(path, std::ios::binary) << "not a hash file";
+    EXPECT_FALSE(TT::load(path));
+
+    ASSERT_TRUE(TT::save(path));
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 32);
+    EXPECT_FALSE(TT::load(path));
+    std::filesystem::remove(path);
+
+    EXPECT_FALSE(TT::load(path));
+
+    // The table in use is kept when a file is rejected
+    TT::Entry entry{};
+    EXPECT_TRUE(TT::probe(0xABCDEFULL, entry));
+}
+
 TEST_F(TTableTest, StoreAndProbeRoundTrip) {
     const Key key = 0x12345678ULL;
     const Move move = set_heuristic_score(make_quiet_move(SQ64_A2, SQ64_A3, SpecialMove::NO_SPECIAL), PV_SCORE);
@@ -51,21 +174,134 @@ TEST_F(TTableTest, ClearRemovesEntries) {
     EXPECT_FALSE(TT::probe(key, entry));
 }
 
+TEST_F(TTableTest, ThreadedClearRemovesEntriesInEveryChunk) {
+    const std::size_t buckets = TT::bucket_count();
+    Key first = 1;
+    while (TT::bucket_index(first) >= buckets / 4) ++first;
+    Key last = first;
+    while (TT::bucket_index(last) < buckets - buckets / 4) last = last * 6364136223846793005ULL + 1442695040888963407ULL;
+    TT::store(first, 3, 1, TT::FLAG_EXACT, NOMOVE);
+    TT::store(last, 3, 2, TT::FLAG_EXACT, NOMOVE);
+
+    TT::clear(4);
+
+    TT::Entry entry{};
+    EXPECT_FALSE(TT::probe(first, entry));
+    EXPECT_FALSE(TT::probe(last, entry));
+}
+
+TEST_F(TTableTest, BucketHoldsSeveralCollidingKeys) {
+    const auto keys = keys_for_same_bucket(0x1000ULL, TT::BUCKET_ENTRIES);
+
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        TT::store(keys[i], DepthSize(i + 1), TT::Score(i), TT::FLAG_EXACT, NOMOVE);
+
+    TT::Entry entry{};
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_TRUE(TT::probe(keys[i], entry));
+        EXPECT_EQ(entry.depth, i + 1);
+        EXPECT_EQ(entry.score, TT::Score(i));
+    }
+}
+
 TEST_F(TTableTest, CollisionReplacementRespectsDepth) {
-    const std::size_t entries = entry_count_for_mb(TT::current_size_mb());
-    const Key key1 = 0x1000ULL;
-    const Key key2 = key1 + entries;
+    const auto keys = keys_for_same_bucket(0x1000ULL, TT::BUCKET_ENTRIES + 1);
+
+    for (std::size_t i = 0; i < TT::BUCKET_ENTRIES; ++i)
+        TT::store(keys[i], DepthSize(10 + i), 0, TT::FLAG_EXACT, NOMOVE);
 
-    TT::store(key1, 5, 10, TT::FLAG_EXACT, NOMOVE);
-    TT::store(key2, 3, 20, TT::FLAG_EXACT, NOMOVE);
+    // The full bucket evicts its shallowest entry
+    TT::store(keys.back(), 3, 20, TT::FLAG_EXACT, NOMOVE);
 
     TT::Entry entry{};
-    EXPECT_TRUE(TT::probe(key1, entry));
-    EXPECT_FALSE(TT::probe(key2, entry));
+    EXPECT_TRUE(TT::probe(keys.back(), entry));
+    EXPECT_FALSE(TT::probe(keys[0], entry));
+    for (std::size_t i = 1; i < TT::BUCKET_ENTRIES; ++i)
+        EXPECT_TRUE(TT::probe(keys[i], entry));
+}
+
+TEST_F(TTableTest, OlderGenerationsAreReplacedFirst) {
+    const auto keys = keys_for_same_bucket(0x2000ULL, TT::BUCKET_ENTRIES + 1);
+
+    TT::store(keys[0], 12, 0, TT::FLAG_EXACT, NOMOVE);
+    TT::new_search();
+    for (std::size_t i = 1; i < TT::BUCKET_ENTRIES; ++i)
+        TT::store(keys[i], 8, 0, TT::FLAG_EXACT, NOMOVE);
 
-    TT::store(key2, 6, 30, TT::FLAG_EXACT, NOMOVE);
-    EXPECT_TRUE(TT::probe(key2, entry));
-    EXPECT_FALSE(TT::probe(key1, entry));
+    TT::store(keys.back(), 8, 0, TT::FLAG_EXACT, NOMOVE);
+
+    TT::Entry entry{};
+    EXPECT_FALSE(TT::probe(keys[0], entry));
+    EXPECT_TRUE(TT::probe(keys.back(), entry));
+    EXPECT_EQ(entry.age, TT::generation());
+}
+
+TEST_F(TTableTest, StoreWithoutMoveKeepsPreviousMove) {
+    const Key key = 0x55AA55ULL;
+    const Move move = make_quiet_move(SQ64_B1, SQ64_C3, SpecialMove::NO_SPECIAL);
+    TT::store(key, 2, 5, TT::FLAG_LOWERBOUND, move);
+    TT::store(key, 4, -5, TT::FLAG_UPPERBOUND, NOMOVE);
+
+    TT::Entry entry{};
+    ASSERT_TRUE(TT::probe(key, entry));
+    EXPECT_EQ(entry.depth, 4);
+    EXPECT_EQ(entry.score, -5);
+    EXPECT_EQ(entry.move, raw_move(move));
+}
+
+TEST_F(TTableTest, StaticEvalRoundTripsAndDefaultsToNoEval) {
+    const Key key = 0x1234000056780000ULL;
+    TT::store(key, 3, 11, TT::FLAG_LOWERBOUND, NOMOVE, -250);
+
+    TT::Entry entry{};
+    ASSERT_TRUE(TT::probe(key, entry));
+    EXPECT_EQ(entry.eval, -250);
+
+    const Key other = 0x4321000087650000ULL;
+    TT::store(other, 3, 11, TT::FLAG_LOWERBOUND, NOMOVE);
+    ASSERT_TRUE(TT::probe(other, entry));
+    EXPECT_EQ(entry.eval, TT::NO_EVAL);
+}
+
+TEST_F(TTableTest, ShallowStoreFillsInMissingEval) {
+    const Key key = 0x2468000013570000ULL;
+    const Move move = make_quiet_move(SQ64_G1, SQ64_F3, SpecialMove::NO_SPECIAL);
+    TT::store(key, 6, 30, TT::FLAG_LOWERBOUND, move);
+    TT::store(key, 0, 10, TT::FLAG_UPPERBOUND, NOMOVE, 42);
+
+    // The deeper result stays, with the eval added
+    TT::Entry entry{};
+    ASSERT_TRUE(TT::probe(key, entry));
+    EXPECT_EQ(entry.depth, 6);
+    EXPECT_EQ(entry.score, 30);
+    EXPECT_EQ(entry.flag, TT::FLAG_LOWERBOUND);
+    EXPECT_EQ(entry.move, raw_move(move));
+    EXPECT_EQ(entry.eval, 42);
+
+    // An eval already there is not replaced
+    TT::store(key, 0, 10, TT::FLAG_UPPERBOUND, NOMOVE, -7);
+    ASSERT_TRUE(TT::probe(key, entry));
+    EXPECT_EQ(entry.eval, 42);
+}
+
+TEST_F(TTableTest, CaptureMoveComesBackWithoutPieceFields) {
+    const Key key = 0x9999000011110000ULL;
+    const Move capture = make_capture_move(SQ64_E4, SQ64_D5, SpecialMove::NO_SPECIAL, W_PAWN, B_PAWN);
+    TT::store(key, 2, 0, TT::FLAG_EXACT, capture);
+
+    TT::Entry entry{};
+    ASSERT_TRUE(TT::probe(key, entry));
+    EXPECT_TRUE(equal_move(entry.move, capture));
+    EXPECT_EQ(captured_piece(entry.move), NO_PIECE);
+}
+
+TEST_F(TTableTest, NegativeAndMateScoresRoundTrip) {
+    const Key key = 0x777ULL;
+    TT::store(key, 1, -Evaluate::CHECKMATE_SCORE + 3, TT::FLAG_EXACT, NOMOVE);
+
+    TT::Entry entry{};
+    ASSERT_TRUE(TT::probe(key, entry));
+    EXPECT_EQ(entry.score, -Evaluate::CHECKMATE_SCORE + 3);
 }
 
 TEST_F(TTableTest, LoadPvLineUsesStoredMovesAndRestoresPosition) {
@@ -81,4 +81,24 @@ TEST(MoveEncodingTest, RawMoveIgnoresHeuristicScore) {
     EXPECT_EQ(raw_move(base), raw_move(scored));
 }
 
+TEST(MoveEncodingTest, PackedMoveRoundTripsSpecialMoves) {
+    const Move moves[] = {
+        make_quiet_move(SQ64_G1, SQ64_F3, SpecialMove::NO_SPECIAL),
+        make_quiet_move(SQ64_E2, SQ64_E4, SpecialMove::PAWN_START),
+        make_quiet_move(SQ64_E8, SQ64_C8, SpecialMove::CASTLE),
+        make_enpassant_move(SQ64_E5, SQ64_D6),
+        make_quiet_move(SQ64_A7, SQ64_A8, SpecialMove::PROMOTION_KNIGHT),
+        make_quiet_move(SQ64_H2, SQ64_H1, SpecialMove::PROMOTION_QUEEN),
+        make_capture_move(SQ64_B7, SQ64_C8, SpecialMove::PROMOTION_ROOK, W_PAWN, B_BISHOP),
+        make_capture_move(SQ64_G2, SQ64_F1, SpecialMove::PROMOTION_BISHOP, B_PAWN, W_ROOK),
+    };
+    for (Move move : moves) {
+        const Move unpacked = unpack_move(pack_move(move));
+        EXPECT_TRUE(equal_move(unpacked, move)) << algebraic_move(move);
+        EXPECT_EQ(move_special(unpacked), move_special(move));
+        EXPECT_EQ(promoted_piece(unpacked), promoted_piece(move));
+    }
+    EXPECT_EQ(unpack_move(pack_move(NOMOVE)), NOMOVE);
+}
+
 }  // namespace
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <cctype>
+#include <filesystem>
 #include <optional>
 #include <sstream>
 #include <string>
@@ -9,6 +10,7 @@
 
 #include "movegen.h"
 #include "position.h"
+#include "search.h"
 #include "ttable.h"
 #include "uci.h"
 #include "helpers/test_helpers.h"
@@ -126,6 +128,34 @@ TEST_F(UciIntegrationTest, SetoptionHashResizesTT) {
     EXPECT_EQ(TT::current_size_mb(), 16U);
 }
 
+TEST_F(UciIntegrationTest, SetoptionHashReportsPageMode) {
+    const std::string output = run_uci_session(
+        "uci\nsetoption name Hash value 8\nsetoption name NUMA Interleave value true\n"
+        "setoption name NUMA Interleave value false\nquit\n");
+    EXPECT_NE(output.find("option name NUMA Interleave type check"), std::string::npos);
+    EXPECT_NE(output.find("info string Hash allocated with"), std::string::npos);
+    EXPECT_EQ(TT::current_size_mb(), 8U);
+    EXPECT_FALSE(TT::numa_interleaved());
+}
+
+TEST_F(UciIntegrationTest, SaveHashAndLoadHashUseHashFile) {
+    const std::string path = (std::filesystem::temp_directory_path() / "akerbeltz uci.hash").string();
+    TT::resize(4);
+    TT::store(0x12345678ULL, 5, 42, TT::FLAG_EXACT, NOMOVE);
+
+    const std::string output = run_uci_session(
+        "uci\nsave_hash\nsetoption name Hash File value " + path + "\nsave_hash\n"
+        "setoption name Clear Hash\nload_hash\nquit\n");
+    std::filesystem::remove(path);
+
+    EXPECT_NE(output.find("option name Hash File type string"), std::string::npos);
+    EXPECT_NE(output.find("info string No Hash File set"), std::string::npos);
+    EXPECT_NE(output.find("info string Hash saved to " + path), std::string::npos);
+    EXPECT_NE(output.find("info string Hash loaded from " + path + " (4 MB)"), std::string::npos);
+    TT::Entry entry{};
+    EXPECT_TRUE(TT::probe(0x12345678ULL, entry));
+}
+
 TEST_F(UciIntegrationTest, SetoptionHashClampsToMin) {
     TT::resize(64);
     const std::string output = run_uci_session("setoption name Hash value 1\nquit\n");
@@ -133,6 +163,37 @@ TEST_F(UciIntegrationTest, SetoptionHashClampsToMin) {
     EXPECT_EQ(TT::current_size_mb(), 4U);
 }
 
+TEST_F(UciIntegrationTest, SetoptionThreadsClampsAndReports) {
+    const std::string output = run_uci_session(
+        "uci\nsetoption name Threads value 0\nsetoption name Threads value 2\nquit\n");
+    EXPECT_NE(output.find("option name Threads"), std::string::npos);
+    EXPECT_NE(output.find("info string Threads set to 1"), std::string::npos);
+    EXPECT_NE(output.find("info string Threads set to 2"), std::string::npos);
+    EXPECT_EQ(Search::thread_count(), 2U);
+    Search::set_threads(Search::DEFAULT_THREADS);
+}
+
+TEST_F(UciIntegrationTest, HashSurvivesGoAndIsClearedOnNewGame) {
+    const Key key = 0xC0FFEEULL;
+    TT::store(key, 40, 7, TT::FLAG_EXACT, NOMOVE);
+
+    run_uci_session("position startpos\ngo depth 2\nisready\nquit\n");
+    TT::Entry entry{};
+    EXPECT_TRUE(TT::probe(key, entry));
+
+    run_uci_session("ucinewgame\nquit\n");
+    EXPECT_FALSE(TT::probe(key, entry));
+}
+
+TEST_F(UciIntegrationTest, SetoptionClearHashEmptiesTT) {
+    const Key key = 0xBEEFULL;
+    TT::store(key, 4, 1, TT::FLAG_EXACT, NOMOVE);
+    const std::string output = run_uci_session("setoption name Clear Hash\nquit\n");
+    EXPECT_NE(output.find("info string Hash cleared"), std::string::npos);
+    TT::Entry entry{};
+    EXPECT_FALSE(TT::probe(key, entry));
+}
+
 TEST_F(UciIntegrationTest, PositionStartposWithoutMoves) {
     const std::string output = run_uci_session("position startpos\nd\nquit\n");
     EXPECT_NE(output.find(fen_line(kStartFen)), std::string::npos);
@@ -229,4 +290,42 @@ TEST_F(UciIntegrationTest, GoPerftReportsTotalNodes) {
     EXPECT_NE(output.find("total nodes size: 20"), std::string::npos);
 }
 
+TEST_F(UciIntegrationTest, SearchThreadKeepsEvalCachesBetweenGoCommands) {
+    // With the TT cleared, a repeated go finds the evaluations of the first
+    // in the thread's eval cache, bar the few that index collisions evicted
+    const std::string output = run_uci_session(
+        "position fen r2qk2r/pp1b1ppp/2n1pn2/2bp4/3P4/2PBPN2/PP1N1PPP/R2QK2R w KQkq - 0 9\n"
+        "setoption name Clear Hash\ngo depth 2\n"
+        "go depth 2\nsetoption name Clear Hash\ngo depth 2\nquit\n");
+
+    // The second go only waits for the first to finish
+    const std::string key = "eval cache hits ";
+    std::size_t last = output.find(key);
+    for (int search = 1; search < 3; ++search) {
+        ASSERT_NE(last, std::string::npos);
+        last = output.find(key, last + 1);
+    }
+    ASSERT_NE(last, std::string::npos);
+
+    std::istringstream stats(output.substr(output.find('(', last) + 1));
+    long hits = 0, probes = 0;
+    char slash = 0;
+    stats >> hits >> slash >> probes;
+    EXPECT_GT(probes, 0);
+    EXPECT_GE(hits * 10, probes * 9);
+}
+
+TEST_F(UciIntegrationTest, BenchIsDeterministicAndRestoresStartpos) {
+    const std::string first  = run_uci_session("bench 3\nd\nquit\n");
+    const std::string second = run_uci_session("bench 3\nquit\n");
+
+    const auto bench_nodes = [](const std::string& output) {
+        const std::size_t pos = output.find("info string bench nodes ");
+        return pos == std::string::npos ? std::string{} : output.substr(pos, output.find(" time", pos) - pos);
+    };
+    ASSERT_FALSE(bench_nodes(first).empty());
+    EXPECT_EQ(bench_nodes(first), bench_nodes(second));
+    EXPECT_NE(first.find(fen_line(kStartFen)), std::string::npos);
+}
+
 }  // namespace
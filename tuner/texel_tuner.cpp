@@ -0,0 +1,437 @@
+// Texel tuner for the classical evaluation.
+//
+// Fits the parameters of Evaluate::calc_score() (material + PST, tempo and
+// pawn structure, see Evaluate::TuneParam) to game results: it minimises
+// the mean squared error between sigmoid(K * eval) and the result with Adam
+// over the whole dataset, split across all cores, and prints the tuned
+// tables as C++ to paste into evaluate.cpp.
+//
+// Dataset: one position per line, a FEN followed by the game result as
+// 1-0 / 0-1 / 1/2-1/2 (quotes and ';' allowed, as in EPD c9 opcodes) or as
+// 1.0 / 0.5 / 0.0 (brackets allowed). The file is streamed in batches and
+// each position is kept only as its packed features, about 60 bytes.
+//
+// Usage: Akerbeltz-<version>-tuner <dataset> [--epochs N] [--lr X] [--k X]
+//                                  [--threads N] [--out file]
+
+#include "attacks.h"
+#include "evaluate.h"
+#include "parallel.h"
+#include "position.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Akerbeltz;
+using Evaluate::TUNE_SIZE;
+
+namespace {
+
+constexpr std::size_t BATCH_LINES = 1 << 18;
+constexpr double      PHASE_MAX   = Evaluate::MAX_PHASE_PIECE_WEIGHT;
+
+// Feature: parameter in the low 10 bits, signed count in the high 6
+using PackedTerm = uint16_t;
+static_assert(TUNE_SIZE <= 1 << 10);
+
+constexpr PackedTerm pack_term(Evaluate::TuneTerm term) {
+    return PackedTerm(uint16_t(term.count) << 10 | term.param);
+}
+constexpr int term_param(PackedTerm term) { return term & 1023; }
+constexpr int term_count(PackedTerm term) { return int16_t(term) >> 10; }
+
+struct Dataset {
+    std::vector<PackedTerm> terms;
+    std::vector<uint64_t>   offsets{0};   // Terms of sample i: [offsets[i], offsets[i + 1])
+    std::vector<uint8_t>    phases;       // Midgame weight, 0 to MAX_PHASE_PIECE_WEIGHT
+    std::vector<uint8_t>    results;      // Half points for white: 0, 1 or 2
+
+    std::size_t size() const { return phases.size(); }
+};
+
+// Mid- and endgame halves of every parameter side by side, so each feature
+// updates both with one two-lane operation
+using Weights = std::vector<double>;
+
+struct Options {
+    std::string dataset;
+    std::string out;
+    int         epochs  = 300;
+    double      lr      = 1.0;
+    double      k       = 0.0;   // 0: fitted to the dataset
+    std::size_t threads = 0;
+};
+
+// ---------- Loading ----------
+
+// Piece placement with 8 ranks of 8 squares and one king each
+bool valid_placement(const std::string &placement) {
+    int ranks = 1, squares = 0, whiteKings = 0, blackKings = 0;
+    for (char c : placement) {
+        if (c == '/') {
+            if (squares != 8) return false;
+            ++ranks;
+            squares = 0;
+        }
+        else if (c >= '1' && c <= '8') squares += c - '0';
+        else if (std::strchr("PNBRQKpnbrqk", c)) {
+            ++squares;
+            whiteKings += c == 'K';
+            blackKings += c == 'k';
+        }
+        else return false;
+    }
+    return ranks == 8 && squares == 8 && whiteKings == 1 && blackKings == 1;
+}
+
+// Half points for white from a result token, -1 when it is none
+int parse_result(std::string token) {
+    token.erase(std::remove_if(token.begin(), token.end(),
+                               [](char c) { return c == '"' || c == ';' || c == '[' || c == ']'; }),
+                token.end());
+    if (token == "1-0" || token == "1.0")     return 2;
+    if (token == "1/2-1/2" || token == "0.5") return 1;
+    if (token == "0-1" || token == "0.0")     return 0;
+    return -1;
+}
+
+bool is_number(const std::string &token) {
+    return !token.empty() && std::all_of(token.begin(), token.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+// FEN and result of a dataset line; false when malformed
+bool parse_line(const std::string &line, std::string &fen, int &result) {
+
+    std::istringstream iss(line);
+    std::vector<std::string> tokens;
+    for (std::string token; iss >> token;)
+        tokens.push_back(token);
+
+    if (tokens.size() < 5 || !valid_placement(tokens[0]) || (tokens[1] != "w" && tokens[1] != "b"))
+        return false;
+
+    fen = tokens[0] + " " + tokens[1] + " " + tokens[2] + " " + tokens[3];
+    std::size_t next = 4;
+    if (tokens.size() > 6 && is_number(tokens[4]) && is_number(tokens[5])) {
+        fen += " " + tokens[4] + " " + tokens[5];
+        next = 6;
+    }
+    else
+        fen += " 0 1";
+
+    // The last result-like token wins: EPD lines may carry other opcodes
+    result = -1;
+    for (std::size_t i = next; i < tokens.size(); ++i)
+        if (const int r = parse_result(tokens[i]); r >= 0)
+            result = r;
+    return result >= 0;
+}
+
+struct ParsedLine {
+    std::vector<PackedTerm> terms;
+    uint8_t phase;
+    uint8_t result;
+    bool    valid;
+};
+
+// Streams the file in batches, each parsed on all threads and appended in
+// file order
+std::size_t load(const Options &options, std::size_t threads, Dataset &data) {
+
+    std::ifstream file(options.dataset);
+    if (!file) {
+        std::fprintf(stderr, "cannot open %s\n", options.dataset.c_str());
+        std::exit(1);
+    }
+
+    std::vector<std::string> lines;
+    std::vector<ParsedLine> parsed;
+    std::size_t skipped = 0;
+
+    while (file) {
+        lines.clear();
+        for (std::string line; lines.size() < BATCH_LINES && std::getline(file, line);)
+            lines.push_back(std::move(line));
+        parsed.resize(lines.size());
+
+        Parallel::for_each_slice(lines.size(), threads, [&](std::size_t begin, std::size_t end) {
+            if (begin == end)
+                return std::size_t(0);
+
+            Position position;
+            std::vector<Evaluate::TuneTerm> terms;
+            std::string fen;
+            for (std::size_t i = begin; i < end; ++i) {
+                ParsedLine &out = parsed[i];
+                int result;
+                out.valid = parse_line(lines[i], fen, result);
+                if (!out.valid)
+                    continue;
+
+                position.set_FEN(fen);
+                Evaluate::tune_trace(position, terms);
+                out.terms.clear();
+                for (const Evaluate::TuneTerm &term : terms)
+                    out.terms.push_back(pack_term(term));
+                out.phase  = uint8_t(std::min(position.game_phase_weight(), Evaluate::MAX_PHASE_PIECE_WEIGHT));
+                out.result = uint8_t(result);
+            }
+            return std::size_t(0);
+        });
+
+        for (std::size_t i = 0; i < lines.size(); ++i) {
+            const ParsedLine &p = parsed[i];
+            if (!p.valid) {
+                skipped += !lines[i].empty();
+                continue;
+            }
+            data.terms.insert(data.terms.end(), p.terms.begin(), p.terms.end());
+            data.offsets.push_back(data.terms.size());
+            data.phases.push_back(p.phase);
+            data.results.push_back(p.result);
+        }
+    }
+
+    data.terms.shrink_to_fit();
+    return skipped;
+}
+
+// ---------- Error and gradient ----------
+
+double sigmoid(double k, double score) { return 1.0 / (1.0 + std::exp(-k * score)); }
+
+// Mean squared error over the dataset, summed on all threads. With a
+// gradient, also adds the gradient of that error with respect to each weight.
+double error(const Dataset &data, const Weights &weights, double k, std::size_t threads, Weights* gradient) {
+
+    std::mutex merge;
+    double total = 0.0;
+
+    Parallel::for_each_slice(data.size(), threads, [&](std::size_t begin, std::size_t end) {
+        Weights local(gradient ? weights.size() : 0, 0.0);
+        double sliceError = 0.0;
+
+        for (std::size_t i = begin; i < end; ++i) {
+            const double mgShare = data.phases[i] / PHASE_MAX;
+            double mg = 0.0, eg = 0.0;
+            for (uint64_t t = data.offsets[i]; t < data.offsets[i + 1]; ++t) {
+                const double* w = &weights[2 * term_param(data.terms[t])];
+                const int count = term_count(data.terms[t]);
+                mg += count * w[0];
+                eg += count * w[1];
+            }
+
+            const double s = sigmoid(k, mg * mgShare + eg * (1.0 - mgShare));
+            const double diff = s - data.results[i] / 2.0;
+            sliceError += diff * diff;
+
+            if (gradient) {
+                const double d = 2.0 * diff * s * (1.0 - s) * k;
+                const double dmg = d * mgShare, deg = d * (1.0 - mgShare);
+                for (uint64_t t = data.offsets[i]; t < data.offsets[i + 1]; ++t) {
+                    double* g = &local[2 * term_param(data.terms[t])];
+                    const int count = term_count(data.terms[t]);
+                    g[0] += count * dmg;
+                    g[1] += count * deg;
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(merge);
+        total += sliceError;
+        if (gradient)
+            for (std::size_t j = 0; j < local.size(); ++j)
+                (*gradient)[j] += local[j];
+        return std::size_t(0);
+    });
+
+    const double n = double(std::max<std::size_t>(data.size(), 1));
+    if (gradient)
+        for (double &g : *gradient)
+            g /= n;
+    return total / n;
+}
+
+// Golden-section search for the K that best maps the current eval to results
+double fit_k(const Dataset &data, const Weights &weights, std::size_t threads) {
+    const double ratio = (std::sqrt(5.0) - 1.0) / 2.0;
+    double lo = 0.0005, hi = 0.05;
+    for (int i = 0; i < 40; ++i) {
+        const double a = hi - ratio * (hi - lo), b = lo + ratio * (hi - lo);
+        if (error(data, weights, a, threads, nullptr) < error(data, weights, b, threads, nullptr))
+            hi = b;
+        else
+            lo = a;
+    }
+    return (lo + hi) / 2.0;
+}
+
+// Full-batch Adam
+void tune(const Dataset &data, Weights &weights, const Options &options, double k, std::size_t threads) {
+
+    constexpr double BETA1 = 0.9, BETA2 = 0.999, EPSILON = 1e-8;
+    Weights m(weights.size(), 0.0), v(weights.size(), 0.0), gradient(weights.size());
+
+    for (int epoch = 1; epoch <= options.epochs; ++epoch) {
+        std::fill(gradient.begin(), gradient.end(), 0.0);
+        const double e = error(data, weights, k, threads, &gradient);
+
+        const double c1 = 1.0 - std::pow(BETA1, epoch), c2 = 1.0 - std::pow(BETA2, epoch);
+        for (std::size_t j = 0; j < weights.size(); ++j) {
+            m[j] = BETA1 * m[j] + (1.0 - BETA1) * gradient[j];
+            v[j] = BETA2 * v[j] + (1.0 - BETA2) * gradient[j] * gradient[j];
+            weights[j] -= options.lr * (m[j] / c1) / (std::sqrt(v[j] / c2) + EPSILON);
+        }
+
+        if (epoch == 1 || epoch % 10 == 0 || epoch == options.epochs)
+            std::fprintf(stderr, "epoch %4d error %.8f\n", epoch, e);
+    }
+}
+
+// ---------- Output ----------
+
+int rounded(double value) { return int(std::lround(value)); }
+
+// Combined value of a piece on a square, one half
+double weight(const Weights &weights, int pieceType, int square, int half) {
+    return weights[2 * (Evaluate::TUNE_PSQT + (pieceType - PAWN) * SQ64_SIZE + square) + half];
+}
+
+std::string packed(const Weights &weights, int param) {
+    char buffer[64];
+    std::snprintf(buffer, sizeof buffer, "make_score(%d, %d)", rounded(weights[2 * param]), rounded(weights[2 * param + 1]));
+    return buffer;
+}
+
+// Tables in the layout of evaluate.cpp: the material of each piece is its
+// average value over the squares it can stand on, the PST the rest
+std::string emit(const Weights &weights) {
+
+    static const char* NAMES[PIECETYPE_SIZE] = {"", "PAWN", "KNIGHT", "BISHOP", "ROOK", "QUEEN", "KING"};
+    // Kings are not tuned as material: both are always on the board
+    constexpr Evaluate::Score KING_VALUE = 20000;
+
+    std::ostringstream out;
+    int material[2][PIECETYPE_SIZE] = {};
+
+    for (int pt = PAWN; pt < KING; ++pt)
+        for (int half = 0; half < 2; ++half) {
+            const int first = pt == PAWN ? SQ64_A2 : SQ64_A1, last = pt == PAWN ? SQ64_H7 : SQ64_H8;
+            double sum = 0.0;
+            for (int s = first; s <= last; ++s)
+                sum += weight(weights, pt, s, half);
+            material[half][pt] = rounded(sum / (last - first + 1));
+        }
+
+    for (int half = 0; half < 2; ++half) {
+        out << "constexpr Score " << (half ? "EG" : "MG") << "_PIECE_SCORES[PieceType::PIECETYPE_SIZE] = {0";
+        for (int pt = PAWN; pt < KING; ++pt)
+            out << ", " << material[half][pt];
+        out << ", " << KING_VALUE << "};\n";
+    }
+
+    for (int half = 0; half < 2; ++half) {
+        out << "\n// " << (half ? "End" : "Middle") << " Game PSQT\n";
+        for (int pt = PAWN; pt <= KING; ++pt) {
+            out << "static constexpr Score " << (half ? "EG_" : "MG_") << NAMES[pt] << "_TABLE[SQ64_SIZE] = {\n";
+            for (int rank = RANK_1; rank <= RANK_8; ++rank) {
+                out << "   ";
+                for (int file = FILE_A; file <= FILE_H; ++file) {
+                    const int s = rank * 8 + file;
+                    const bool empty = pt == PAWN && (rank == RANK_1 || rank == RANK_8);
+                    char buffer[16];
+                    std::snprintf(buffer, sizeof buffer, " %3d,",
+                                  empty ? 0 : rounded(weight(weights, pt, s, half)) - material[half][pt]);
+                    out << buffer;
+                }
+                out << "\n";
+            }
+            out << "};\n\n";
+        }
+    }
+
+    out << "constexpr PackedScore TEMPO_BONUS = " << packed(weights, Evaluate::TUNE_TEMPO) << ";\n\n"
+        << "constexpr PackedScore DOUBLED_PAWN  = " << packed(weights, Evaluate::TUNE_DOUBLED) << ";\n"
+        << "constexpr PackedScore ISOLATED_PAWN = " << packed(weights, Evaluate::TUNE_ISOLATED) << ";\n\n"
+        << "constexpr PackedScore PASSED_PAWN[RANK_SIZE] = {\n   ";
+    for (int rank = RANK_1; rank <= RANK_8; ++rank) {
+        // Passed pawns never stand on their first or last rank
+        const bool unused = rank == RANK_1 || rank == RANK_8;
+        out << " " << (unused ? std::string("make_score(0, 0)") : packed(weights, Evaluate::TUNE_PASSED + rank))
+            << (rank < RANK_8 ? "," : "") << (rank == RANK_4 ? "\n   " : "");
+    }
+    out << "\n};\n";
+
+    return out.str();
+}
+
+Options parse_options(int argc, char* argv[]) {
+
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if      (arg == "--epochs"  && hasValue) options.epochs  = std::atoi(argv[++i]);
+        else if (arg == "--lr"      && hasValue) options.lr      = std::atof(argv[++i]);
+        else if (arg == "--k"       && hasValue) options.k       = std::atof(argv[++i]);
+        else if (arg == "--threads" && hasValue) options.threads = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--out"     && hasValue) options.out     = argv[++i];
+        else if (options.dataset.empty() && arg.rfind("--", 0) != 0) options.dataset = arg;
+        else {
+            std::fprintf(stderr, "unknown argument %s\n", arg.c_str());
+            std::exit(1);
+        }
+    }
+
+    if (options.dataset.empty()) {
+        std::fprintf(stderr, "usage: %s <dataset> [--epochs N] [--lr X] [--k X] [--threads N] [--out file]\n", argv[0]);
+        std::exit(1);
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+
+    const Options options = parse_options(argc, argv);
+    const std::size_t threads = Parallel::resolve_threads(options.threads);
+
+    Attacks::init();
+    Position::init();
+
+    Dataset data;
+    const std::size_t skipped = load(options, threads, data);
+    std::fprintf(stderr, "%zu positions, %zu lines skipped, %.1f MB of features\n", data.size(), skipped,
+                 (data.terms.size() * sizeof(PackedTerm) + data.size() * (sizeof(uint64_t) + 2)) / 1048576.0);
+    if (!data.size())
+        return 1;
+
+    Weights weights(2 * TUNE_SIZE);
+    for (int param = 0; param < TUNE_SIZE; ++param) {
+        weights[2 * param]     = Evaluate::mg_value(Evaluate::tune_parameter(param));
+        weights[2 * param + 1] = Evaluate::eg_value(Evaluate::tune_parameter(param));
+    }
+
+    const double k = options.k > 0.0 ? options.k : fit_k(data, weights, threads);
+    std::fprintf(stderr, "K %.6f, initial error %.8f\n", k, error(data, weights, k, threads, nullptr));
+
+    tune(data, weights, options, k, threads);
+
+    const std::string source = emit(weights);
+    if (options.out.empty())
+        std::fputs(source.c_str(), stdout);
+    else
+        std::ofstream(options.out) << source;
+
+    return 0;
+}